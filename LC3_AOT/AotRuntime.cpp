@@ -0,0 +1,103 @@
+#include "AotRuntime.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "../MyLC3/ExternalUtilities.h"
+#include "../MyLC3/Keyboard.h"
+#include "../MyLC3/Timer.h"
+
+AotBlock (*AotRuntime::blockTable[MEM_MAX])() = {};
+uint64_t AotRuntime::interpretedCount = 0;
+
+void AotRuntime::Run()
+{
+    AotBlock block = Find(CPU::cores[0].reg[CPU::R_PC]);
+
+    while (CPU::cores[0].shouldBeRunning)
+    {
+        if (block.run)
+        {
+            block = block.run();
+        }
+        else
+        {
+            ++interpretedCount;
+            CPU::cores[0].ProcessWord();
+            block = Find(CPU::cores[0].reg[CPU::R_PC]);
+        }
+
+        // Blocks end at control transfers, which is where the interpreter polls too
+        if (CPU::interruptPending[0].load(std::memory_order_relaxed))
+        {
+            CPU::cores[0].ServiceInterrupts();
+            block = Find(CPU::cores[0].reg[CPU::R_PC]);
+        }
+    }
+}
+
+int AotRuntime::Main(int argc, char* argv[], const AotProgram& program)
+{
+    bool interpretOnly = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "-interpret")
+        {
+            interpretOnly = true;
+            continue;
+        }
+
+        std::cout << "Usage: " << argv[0] << " [-interpret]\n"
+            << "  Runs " << program.source << " translated ahead of time.\n"
+            << "  -interpret   run the same image on the CPU interpreter instead, for comparison."
+            << '\n';
+        return 1;
+    }
+
+    for (size_t i = 0; i < program.segmentCount; ++i)
+    {
+        const AotSegment& segment = program.segments[i];
+        std::copy(segment.words, segment.words + segment.size, CPU::memory + segment.origin);
+    }
+
+    for (size_t i = 0; i < program.blockCount; ++i)
+        blockTable[program.blocks[i].address] = program.blocks[i].run;
+
+    ExternalUtilities EUtils;
+
+    EUtils.Init();
+
+    Keyboard::Start();
+
+    CPU::cores[0].SetValueInRegister(CPU::R_PC, program.entry);
+    CPU::cores[0].SetConditionFlags(CPU::FL_ZRO);
+    CPU::cores[0].shouldBeRunning = true;
+
+    std::cout << "Executing " << program.source << " at " << program.entry << (interpretOnly ? " on the interpreter" : " translated")
+        << " (" << program.blockCount << " blocks)" << "\n-----------------------------" << '\n';
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (interpretOnly)
+        CPU::cores[0].Run();
+    else
+        Run();
+
+    Timer::Shutdown();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    std::cout << "\n-----------------------------\n" << "Execution terminated at "
+        << CPU::cores[0].GetValueInReg(CPU::R_PC) << '\n';
+
+    std::cout << "Executed " << CPU::cores[0].instructionCount << " instructions in " << elapsed.count() << " s ("
+        << (elapsed.count() > 0 ? CPU::cores[0].instructionCount / elapsed.count() / 1e6 : 0) << " MIPS)" << '\n';
+
+    if (!interpretOnly)
+        std::cout << interpretedCount << " of them on the interpreter" << '\n';
+
+    EUtils.CleanUp();
+
+    return 0;
+}
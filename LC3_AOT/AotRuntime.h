@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "../MyLC3/CPU.h"
+
+// Runtime linked into the programs LC3_AOT generates. It is not part of the translator itself.
+//
+// Every translated basic block is a function that runs the block on the CPU's registers and memory
+// and returns the block to run next. Static targets are returned directly. Computed targets (JMP,
+// RET, JSRR, traps) go through a 64K table of block entry points. Anything the translation does not
+// cover, such as device accesses, RTI or code that was never discovered, is handed to the CPU
+// interpreter, which runs until the PC lands on a translated block again.
+struct AotBlock
+{
+    AotBlock (*run)();
+};
+
+struct AotSegment
+{
+    uint16_t origin;
+    uint16_t size;
+    const uint16_t* words;
+};
+
+struct AotEntry
+{
+    uint16_t address;
+    AotBlock (*run)();
+};
+
+struct AotProgram
+{
+    const char* source;
+    uint16_t entry;
+    const AotSegment* segments;
+    size_t segmentCount;
+    const AotEntry* blocks;
+    size_t blockCount;
+};
+
+class AotRuntime
+{
+public:
+    // main of a generated program. Loads the image, runs it natively and prints the same summary as MyLC3.
+    static int Main(int argc, char* argv[], const AotProgram& program);
+
+    static AotBlock Find(uint16_t address)
+    {
+        return { blockTable[address] };
+    }
+
+    // Leaves a block towards a known block after executed instructions
+    static AotBlock Jump(uint16_t address, uint32_t executed, AotBlock (*target)())
+    {
+        CPU::cores[0].reg[CPU::R_PC] = address;
+        CPU::cores[0].instructionCount += executed;
+        return { target };
+    }
+
+    // Leaves a block towards a computed target
+    static AotBlock Dispatch(uint16_t address, uint32_t executed)
+    {
+        CPU::cores[0].reg[CPU::R_PC] = address;
+        CPU::cores[0].instructionCount += executed;
+        return Find(address);
+    }
+
+    // Leaves a block before the instruction at address, which the interpreter executes instead
+    static AotBlock Interpret(uint16_t address, uint32_t executed)
+    {
+        CPU::cores[0].reg[CPU::R_PC] = address;
+        CPU::cores[0].instructionCount += executed;
+        return { nullptr };
+    }
+
+    // Runs a trap through the CPU, natively or through the OS vector table, and continues wherever it returns
+    static AotBlock Trap(uint16_t instruction, uint16_t next, uint32_t executed)
+    {
+        CPU::cores[0].reg[CPU::R_PC] = next;
+        CPU::cores[0].instructionCount += executed;
+        CPU::cores[0].Trap(instruction);
+        return Find(CPU::cores[0].reg[CPU::R_PC]);
+    }
+
+    // Loop shared by the translated blocks and the interpreter
+    static void Run();
+
+    static uint64_t interpretedCount;
+
+private:
+    static AotBlock (*blockTable[MEM_MAX])();
+};
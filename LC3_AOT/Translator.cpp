@@ -0,0 +1,289 @@
+#include "Translator.h"
+#include "../MyLC3/CPU.h"
+#include "../MyLC3/ControlFlowGraph.h"
+#include "../MyLC3/ObjectFormat.h"
+#include <cstdio>
+
+static std::string Hex(uint16_t value)
+{
+    char text[8];
+    std::snprintf(text, sizeof(text), "0x%04X", value);
+    return text;
+}
+
+static std::string BlockName(uint16_t address)
+{
+    char text[16];
+    std::snprintf(text, sizeof(text), "Block_%04X", address);
+    return text;
+}
+
+static std::string Signed(int16_t value)
+{
+    return value < 0 ? " - " + std::to_string(-value) : " + " + std::to_string(value);
+}
+
+static const char* opcodeNames[16] = { "BR", "ADD", "LD", "ST", "JSR", "AND", "LDR", "STR", "RTI", "NOT", "LDI", "STI", "JMP", "RES", "LEA", "TRAP" };
+
+// Condition on the last result under which a BR with these n/z/p bits is taken. The result is a
+// 16-bit value or CPU::NO_CONDITION_CODES, which takes no branch.
+static const char* branchConditions[8] = { "false", "lastResult - 1 < 0x7FFF", "lastResult == 0",
+    "lastResult < 0x8000", "lastResult - 0x8000 < 0x8000", "lastResult - 1 < 0xFFFF",
+    "lastResult == 0 || lastResult - 0x8000 < 0x8000", "lastResult != CPU::NO_CONDITION_CODES" };
+
+// Leaves the block towards a static target, through the block table if no block starts there
+static std::string JumpTo(uint16_t target, const std::string& executed, const std::vector<bool>& blockStart)
+{
+    if (!blockStart[target])
+        return "return AotRuntime::Dispatch(" + Hex(target) + ", " + executed + ");";
+
+    return "return AotRuntime::Jump(" + Hex(target) + ", " + executed + ", " + BlockName(target) + ");";
+}
+
+static uint16_t Offset(uint16_t instruction, int bitCount)
+{
+    return CPU::ExtendSign(instruction & ((1 << bitCount) - 1), bitCount);
+}
+
+// Loads and stores with a fixed device address, and instructions the translation leaves alone
+static bool AlwaysInterpreted(const uint16_t* memory, uint16_t address)
+{
+    uint16_t instruction = memory[address];
+    uint16_t target = address + 1 + Offset(instruction, 9);
+
+    switch (instruction >> 12)
+    {
+    case CPU::OP_LD:
+    case CPU::OP_ST:
+    case CPU::OP_LDI:
+    case CPU::OP_STI:
+        return target >= CPU::MR_KBSR;
+    case CPU::OP_RTI:
+    case CPU::OP_RES:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Translator::EmitInstruction(std::string& out, const uint16_t* memory, uint16_t address, uint32_t executed,
+    bool endsBlock, const std::vector<bool>& blockStart, TranslationStats& stats)
+{
+    uint16_t instruction = memory[address];
+    uint16_t next = address + 1;
+    std::string d = std::to_string((instruction >> 9) & 0x7);
+    std::string s = std::to_string((instruction >> 6) & 0x7);
+    std::string flags = " lastResult = reg[" + d + "];\n";
+    std::string leave = "return AotRuntime::Interpret(" + Hex(address) + ", " + std::to_string(executed) + ");";
+    std::string done = std::to_string(executed + 1);
+
+    out += "    // " + Hex(address) + ": " + Hex(instruction) + " " + opcodeNames[instruction >> 12] + "\n";
+
+    if (AlwaysInterpreted(memory, address))
+    {
+        ++stats.interpreted;
+        out += "    " + leave + "\n";
+        return;
+    }
+
+    switch (instruction >> 12)
+    {
+    case CPU::OP_ADD:
+    case CPU::OP_AND:
+    {
+        bool add = (instruction >> 12) == CPU::OP_ADD;
+        std::string operand;
+
+        if ((instruction >> 5) & 1)
+            operand = add ? Signed(static_cast<int16_t>(Offset(instruction, 5))) : " & " + Hex(Offset(instruction, 5));
+        else
+            operand = (add ? " + reg[" : " & reg[") + std::to_string(instruction & 0x7) + "]";
+
+        out += "    reg[" + d + "] = reg[" + s + "]" + operand + ";" + flags;
+        break;
+    }
+    case CPU::OP_NOT:
+        out += "    reg[" + d + "] = ~reg[" + s + "];" + flags;
+        break;
+    case CPU::OP_LEA:
+        out += "    reg[" + d + "] = " + Hex(next + Offset(instruction, 9)) + ";" + flags;
+        break;
+    case CPU::OP_LD:
+        out += "    reg[" + d + "] = memory[" + Hex(next + Offset(instruction, 9)) + "];" + flags;
+        break;
+    case CPU::OP_ST:
+        out += "    memory[" + Hex(next + Offset(instruction, 9)) + "] = reg[" + d + "];\n";
+        break;
+    case CPU::OP_LDI:
+    case CPU::OP_LDR:
+    case CPU::OP_STI:
+    case CPU::OP_STR:
+    {
+        // Device registers have side effects, so their accesses go to the interpreter
+        uint16_t op = instruction >> 12;
+        bool indirect = op == CPU::OP_LDI || op == CPU::OP_STI;
+        std::string address = indirect ? "memory[" + Hex(next + Offset(instruction, 9)) + "]" : "reg[" + s + "]" + Signed(static_cast<int16_t>(Offset(instruction, 6)));
+
+        out += "    {\n        uint16_t address = " + address + ";\n        if (address >= CPU::MR_KBSR)\n            " + leave + "\n";
+
+        if (op == CPU::OP_LDI || op == CPU::OP_LDR)
+            out += "        reg[" + d + "] = memory[address];" + flags.substr(0, flags.size() - 1) + "\n";
+        else
+            out += "        memory[address] = reg[" + d + "];\n";
+
+        out += "    }\n";
+        break;
+    }
+    case CPU::OP_BR:
+    {
+        uint16_t condition = (instruction >> 9) & 0x7;
+        uint16_t target = next + Offset(instruction, 9);
+        std::string jump = JumpTo(target, done, blockStart);
+
+        if (condition == 0x7)
+        {
+            out += "    " + jump + "\n";
+            return;
+        }
+
+        if (condition)
+            out += "    if (" + std::string(branchConditions[condition]) + ")\n        " + jump + "\n";
+        break;
+    }
+    case CPU::OP_JMP:
+        ++stats.computedJumps;
+        out += "    return AotRuntime::Dispatch(reg[" + s + "], " + done + ");\n";
+        return;
+    case CPU::OP_JSR:
+    {
+        if ((instruction >> 11) & 1)
+        {
+            uint16_t target = next + Offset(instruction, 11);
+            out += "    reg[7] = " + Hex(next) + ";\n    " + JumpTo(target, done, blockStart) + "\n";
+        }
+        else
+        {
+            ++stats.computedJumps;
+            out += "    {\n        uint16_t target = reg[" + s + "];\n        reg[7] = " + Hex(next) + ";\n        return AotRuntime::Dispatch(target, " + done + ");\n    }\n";
+        }
+        return;
+    }
+    case CPU::OP_TRAP:
+        out += "    return AotRuntime::Trap(" + Hex(instruction) + ", " + Hex(next) + ", " + done + ");\n";
+        return;
+    default:
+        break;
+    }
+
+    if (endsBlock)
+        out += "    " + JumpTo(next, done, blockStart) + "\n";
+}
+
+void Translator::EmitImage(std::string& out, const uint16_t* memory)
+{
+    enum { GAP = 16, MAX_SEGMENT = 0x8000 };
+    std::vector<std::pair<uint16_t, uint32_t>> segments;
+
+    // Memory starts zeroed, so runs of non-zero words reproduce the loaded image exactly
+    for (uint32_t address = 0; address < MEM_MAX; ++address)
+    {
+        if (!memory[address])
+            continue;
+
+        if (segments.empty() || address - (segments.back().first + segments.back().second) >= GAP || segments.back().second >= MAX_SEGMENT)
+            segments.push_back({ static_cast<uint16_t>(address), 0 });
+
+        segments.back().second = address + 1 - segments.back().first;
+    }
+
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        out += "static const uint16_t segment" + std::to_string(i) + "[] =\n{";
+
+        for (uint32_t offset = 0; offset < segments[i].second; ++offset)
+            out += (offset % 12 ? " " : "\n    ") + Hex(memory[segments[i].first + offset]) + ",";
+
+        out += "\n};\n\n";
+    }
+
+    out += "static const AotSegment segments[] =\n{\n";
+    for (size_t i = 0; i < segments.size(); ++i)
+        out += "    { " + Hex(segments[i].first) + ", " + std::to_string(segments[i].second) + ", segment" + std::to_string(i) + " },\n";
+    if (segments.empty())
+        out += "    { 0, 0, nullptr },\n";
+    out += "};\n\n";
+}
+
+std::string Translator::Translate(const uint16_t* memory, const ControlFlowGraph& graph, uint16_t entry,
+    const ObjectImage& debugInfo, const std::string& sourceName, TranslationStats& stats)
+{
+    std::vector<bool> blockStart(MEM_MAX);
+    std::vector<uint16_t> blocks;
+
+    for (uint32_t address = 0; address < MEM_MAX; ++address)
+    {
+        bool resumes = address && graph.GetKind(static_cast<uint16_t>(address)) == ControlFlowGraph::WK_CODE
+            && graph.GetKind(static_cast<uint16_t>(address - 1)) == ControlFlowGraph::WK_CODE && AlwaysInterpreted(memory, static_cast<uint16_t>(address - 1));
+
+        if (graph.IsBlockStart(static_cast<uint16_t>(address)) || resumes)
+        {
+            blockStart[address] = true;
+            blocks.push_back(static_cast<uint16_t>(address));
+        }
+    }
+
+    stats = TranslationStats();
+    stats.blocks = blocks.size();
+
+    std::string out = "// Generated by LC3_AOT from " + sourceName + ".\n"
+        "// Build it together with LC3_AOT/AotRuntime.cpp and the MyLC3 sources except main.cpp.\n"
+        "#include \"AotRuntime.h\"\n\n"
+        "[[maybe_unused]] static uint16_t* const reg = CPU::cores[0].reg;\n"
+        "[[maybe_unused]] static uint16_t* const memory = CPU::memory;\n"
+        "[[maybe_unused]] static uint32_t& lastResult = CPU::cores[0].lastResult;\n\n";
+
+    for (uint16_t address : blocks)
+        out += "static AotBlock " + BlockName(address) + "();\n";
+    out += "\n";
+
+    for (uint16_t address : blocks)
+    {
+        std::string label = ObjectFormat::Locate(debugInfo, address);
+        out += "static AotBlock " + BlockName(address) + "()" + (label.empty() ? "" : " // " + label) + "\n{\n";
+
+        // A block runs until an instruction that leaves it or the start of the next block
+        uint32_t executed = 0;
+        for (uint16_t pc = address; ; ++pc, ++executed)
+        {
+            uint16_t next = pc + 1;
+            bool endsBlock = ControlFlowGraph::EndsBlock(memory[pc]) || AlwaysInterpreted(memory, pc) || blockStart[next]
+                || graph.GetKind(next) != ControlFlowGraph::WK_CODE || next >= CPU::MR_KBSR;
+
+            ++stats.instructions;
+            EmitInstruction(out, memory, pc, executed, endsBlock, blockStart, stats);
+
+            if (endsBlock)
+                break;
+        }
+
+        out += "}\n\n";
+    }
+
+    EmitImage(out, memory);
+
+    out += "static const AotEntry blocks[] =\n{\n";
+    for (uint16_t address : blocks)
+        out += "    { " + Hex(address) + ", " + BlockName(address) + " },\n";
+    out += "};\n\n";
+
+    std::string quotedName;
+    for (char letter : sourceName)
+        quotedName += letter == '\\' || letter == '"' ? std::string("\\") + letter : std::string(1, letter);
+
+    out += "int main(int argc, char* argv[])\n{\n"
+        "    AotProgram program = { \"" + quotedName + "\", " + Hex(entry) + ", segments, sizeof(segments) / sizeof(segments[0]),\n"
+        "        blocks, sizeof(blocks) / sizeof(blocks[0]) };\n\n"
+        "    return AotRuntime::Main(argc, argv, program);\n}\n";
+
+    return out;
+}
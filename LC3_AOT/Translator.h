@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ControlFlowGraph;
+struct ObjectImage;
+
+struct TranslationStats
+{
+    size_t blocks = 0;
+    size_t instructions = 0;
+    size_t computedJumps = 0;
+    size_t interpreted = 0;
+};
+
+// Turns a loaded image into C++ source for a native program built on LC3_AOT/AotRuntime.
+//
+// The blocks come from ControlFlowGraph. Each one is split again after instructions that always go
+// to the interpreter, so translation resumes right after them. Words the analysis did not reach as
+// code are only emitted as part of the image and run on the interpreter if they are ever executed.
+//
+// Translated code assumes it is not modified at run time. Programs that store into their own code
+// have to run on the interpreter.
+class Translator
+{
+public:
+    // memory holds the whole 64K address space as LoadFileInto left it and graph has been analyzed on
+    // it. debugInfo may be empty and is only used for comments.
+    static std::string Translate(const uint16_t* memory, const ControlFlowGraph& graph, uint16_t entry,
+        const ObjectImage& debugInfo, const std::string& sourceName, TranslationStats& stats);
+
+private:
+    static void EmitInstruction(std::string& out, const uint16_t* memory, uint16_t address, uint32_t executed,
+        bool endsBlock, const std::vector<bool>& blockStart, TranslationStats& stats);
+
+    static void EmitImage(std::string& out, const uint16_t* memory);
+};
@@ -0,0 +1,123 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../MyLC3/CPU.h"
+#include "../MyLC3/ControlFlowGraph.h"
+#include "../MyLC3/ObjectFormat.h"
+#include "../MyLC3/Utilities.h"
+#include "Translator.h"
+
+void PrintUsage(const char* executableName)
+{
+	std::cout << "Usage: " << executableName << " path swap_endianness options\n"
+		<< "  Translates an assembled image into C++ source for a native program.\n"
+		<< "  path:             raw image or v2 object file, as loaded by MyLC3.\n"
+		<< "  swap_endianness:  whether to swap byte order of raw images. Acceptable values are TRUE or FALSE. Default is TRUE.\n"
+		<< "  options:\n"
+		<< "    -out=file       where to write the source, default is path with a .cpp extension.\n"
+		<< "    -cfg            print the recovered functions, blocks and code/data map instead of translating.\n"
+		<< "  Build the output with LC3_AOT/AotRuntime.cpp and the MyLC3 sources except main.cpp, with LC3_AOT\n"
+		<< "  on the include path."
+		<< '\n';
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> arguments;
+	std::string outputPath;
+	bool printGraph = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+
+		if (argument[0] != '-')
+		{
+			arguments.push_back(argument);
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 5)) == "-OUT=")
+		{
+			outputPath = argument.substr(5);
+		}
+		else if (Utilities::ToUpperCase(argument) == "-CFG")
+		{
+			printGraph = true;
+		}
+		else
+		{
+			std::cout << "Unrecognized argument: " << argument << '\n' << '\n';
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (arguments.empty() || arguments.size() > 2)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	bool swapEndianness = true;
+	if (arguments.size() == 2)
+	{
+		if (Utilities::ToUpperCase(arguments[1]) == "FALSE")
+			swapEndianness = false;
+		else if (Utilities::ToUpperCase(arguments[1]) != "TRUE")
+		{
+			std::cout << "Unrecognized argument: " << arguments[1] << '\n' << '\n';
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::string inputPath = arguments[0];
+	if (outputPath.empty())
+	{
+		size_t extension = inputPath.find_last_of('.');
+		if (extension == std::string::npos || inputPath.find_first_of("/\\", extension) != std::string::npos)
+			extension = inputPath.size();
+
+		outputPath = inputPath.substr(0, extension) + ".cpp";
+	}
+
+	std::vector<uint16_t> memory(MEM_MAX);
+	uint16_t entry = Utilities::LoadFileInto(inputPath, memory.data(), MEM_MAX, swapEndianness);
+
+	ObjectImage debugInfo;
+	Utilities::LoadDebugInfo(inputPath, debugInfo);
+
+	size_t separator = inputPath.find_last_of("/\\");
+	std::string sourceName = separator == std::string::npos ? inputPath : inputPath.substr(separator + 1);
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	ControlFlowGraph graph;
+	graph.Analyze(memory.data(), entry);
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+
+	if (printGraph)
+	{
+		std::cout << "Analyzed in " << elapsed.count() << " ms" << '\n';
+		graph.Print(std::cout, debugInfo);
+		return 0;
+	}
+
+	TranslationStats stats;
+	std::string source = Translator::Translate(memory.data(), graph, entry, debugInfo, sourceName, stats);
+
+	std::ofstream output(outputPath, std::ios::trunc);
+	output << source;
+	if (!output.good())
+	{
+		std::cout << "Could not write " << outputPath << '\n';
+		return 1;
+	}
+
+	std::cout << "Translated " << stats.instructions << " instructions in " << stats.blocks << " blocks from " << entry << " into " << outputPath << '\n'
+		<< stats.computedJumps << " computed jumps go through the block table, " << stats.interpreted << " instructions are left to the interpreter" << '\n';
+
+	return 0;
+}
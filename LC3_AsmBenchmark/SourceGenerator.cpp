@@ -0,0 +1,56 @@
+#include "SourceGenerator.h"
+
+namespace
+{
+	uint32_t NextRandom( uint32_t &state )
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	const char *words[] = { "alpha", "beta", "gamma", "delta", "label", "value", "loop", "chunk", "string", "fill" };
+}
+
+std::string SourceGenerator::Generate( size_t lineCount, uint32_t seed )
+{
+	std::string source;
+	source.reserve( lineCount * 24 );
+	source += ".ORIG x3000\n";
+
+	size_t lines = 1;
+	uint32_t state = seed;
+
+	for ( size_t chunk = 0; lines < lineCount; ++chunk )
+	{
+		std::string name = "C" + std::to_string( chunk );
+
+		source += name + "_TOP   LD R1, " + name + "_N        ; loop count\n";
+		source += name + "_LOOP  ADD R2, R2, R1\n";
+		source += "        AND R3, R2, #15\n";
+		source += "        LEA R0, " + name + "_MSG\n";
+		source += "        ADD R1, R1, #-1\n";
+		source += "        BRp " + name + "_LOOP\n";
+		source += "        ST R2, " + name + "_TAB\n";
+		source += "        BRnzp " + name + "_NEXT\n";
+		lines += 8;
+
+		std::string message;
+		for ( uint32_t i = 0, count = 1 + NextRandom( state ) % 4; i < count; ++i )
+			message += std::string( i ? " " : "" ) + words[NextRandom( state ) % 10];
+
+		source += name + "_MSG   .STRINGZ \"" + message + "\"\n";
+		source += name + "_N     .FILL #" + std::to_string( 1 + NextRandom( state ) % 8 ) + "\n";
+		source += name + "_TAB   .FILL x" + std::to_string( 1000 + NextRandom( state ) % 9000 ) + "\n";
+		source += "        .FILL " + name + "_TOP\n";
+		lines += 4;
+
+		for ( uint32_t i = 0, count = NextRandom( state ) % 3; i < count; ++i, ++lines )
+			source += "        .FILL #" + std::to_string( NextRandom( state ) % 1000 ) + "\n";
+
+		source += name + "_NEXT  NOT R4, R3\n";
+		++lines;
+	}
+
+	source += "        HALT\n.END\n";
+	return source;
+}
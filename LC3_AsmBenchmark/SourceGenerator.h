@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Generates synthetic LC-3 assembly for stressing the assembler. The program is a chain of small
+// chunks, each with several labels, a loop, a .STRINGZ and a few .FILLs (one of them a label), so
+// every stage of the pipeline has work to do. All references stay within their chunk, so programs
+// that fit in the address space assemble without errors.
+class SourceGenerator
+{
+public:
+	// Returns at least lineCount lines of source, the same for the same seed
+	static std::string Generate( size_t lineCount, uint32_t seed );
+};
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../LC3_Assembly/Assembler.h"
+#include "SourceGenerator.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// Swallows the assembler's progress output so the console does not end up in the numbers
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow( int c ) override
+	{
+		return c;
+	}
+
+	std::streamsize xsputn( const char *, std::streamsize count ) override
+	{
+		return count;
+	}
+};
+
+enum STAGE
+{
+	ST_READ = 0,
+	ST_TOKENIZE,
+	ST_MACROS,
+	ST_LABELS,
+	ST_ENCODE,
+	ST_COUNT
+};
+
+const char *stageNames[ST_COUNT] = { "read", "tokenize", "macros", "labels", "encode" };
+
+struct StageResult
+{
+	double seconds[ST_COUNT] = {};
+	size_t words = 0;
+	size_t errors = 0;
+	bool loaded = false;
+};
+
+double PeakResidentMegabytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if ( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+		return 0;
+
+	return counters.PeakWorkingSetSize / 1048576.0;
+#else
+	rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+// Runs the same stages as LC3_Assembly's main on one file, timing each of them
+StageResult AssembleFile( const std::string &path )
+{
+	StageResult result;
+	std::vector<std::string> fileAsLines;
+
+	// Every run reads the file itself instead of reusing the stripped copy of the previous one
+	Assembler::Reset();
+	Assembler::ClearFileCache();
+
+	NullBuffer nullBuffer;
+	std::streambuf *consoleBuffer = std::cout.rdbuf( &nullBuffer );
+
+	auto stageStart = std::chrono::steady_clock::now();
+	auto endStage = [&]( STAGE stage )
+	{
+		auto now = std::chrono::steady_clock::now();
+		result.seconds[stage] += std::chrono::duration<double>( now - stageStart ).count();
+		stageStart = now;
+	};
+
+	result.loaded = Assembler::ReadFileAsLines( path, fileAsLines );
+	endStage( ST_READ );
+
+	if ( result.loaded && !fileAsLines.empty() )
+	{
+		Assembler::HandleENDMacro( fileAsLines );
+		Assembler::HandleORIGMacro( fileAsLines );
+		endStage( ST_MACROS );
+
+		std::vector<std::vector<std::string>> tokenizedInput = Assembler::GetTokenizedInputStrings( fileAsLines );
+		endStage( ST_TOKENIZE );
+
+		Assembler::HandleFILLMacros( tokenizedInput );
+		Assembler::HandleTRAPCodeMacroReplacement( tokenizedInput );
+		Assembler::HandleSTRINGZMacros( tokenizedInput );
+		endStage( ST_MACROS );
+
+		uint16_t startLocation = Assembler::ConvertStringIfNumber( tokenizedInput[0][1] );
+		Assembler::ResolveAndReplaceLabels( tokenizedInput, startLocation );
+		endStage( ST_LABELS );
+
+		result.words = Assembler::AssembleIntoBinary( tokenizedInput ).size();
+		endStage( ST_ENCODE );
+	}
+
+	std::cout.rdbuf( consoleBuffer );
+
+	result.errors = Assembler::GetErrorCount();
+
+	return result;
+}
+
+bool ParseSizes( const std::string &text, std::vector<size_t> &sizes )
+{
+	std::stringstream stream( text );
+	std::string item;
+
+	while ( std::getline( stream, item, ',' ) )
+	{
+		try
+		{
+			size_t used = 0;
+			sizes.push_back( std::stoull( item, &used ) );
+			if ( used != item.size() || sizes.back() == 0 )
+				return false;
+		}
+		catch ( const std::exception & )
+		{
+			return false;
+		}
+	}
+
+	return !sizes.empty();
+}
+
+void PrintUsage( const char *executableName )
+{
+	std::cout << "Usage: " << executableName << " [options]\n"
+		<< "  Generates synthetic assembly and times each stage of the LC3_Assembly pipeline on it.\n"
+		<< "  -lines n[,n...]   source sizes in lines, default 10000,100000. Sizes run smallest first.\n"
+		<< "  -file path        time an existing source file instead of generated ones.\n"
+		<< "  -save path        keep the generated source of the last size at path.\n"
+		<< "  -seed n           seed for the generator, default 1.\n"
+		<< "  Programs over 65536 words do not fit the LC-3 address space. They still measure throughput,\n"
+		<< "  but their label offsets wrap and the output is not meaningful."
+		<< '\n';
+}
+
+int main( int argc, char *argv[] )
+{
+	std::vector<size_t> sizes;
+	std::string inputPath;
+	std::string savePath;
+	uint32_t seed = 1;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		std::string argument = argv[i];
+		std::string value = i + 1 < argc ? argv[i + 1] : "";
+		bool valid = !value.empty();
+
+		if ( valid && argument == "-lines" )
+			valid = ParseSizes( value, sizes );
+		else if ( valid && argument == "-file" )
+			inputPath = value;
+		else if ( valid && argument == "-save" )
+			savePath = value;
+		else if ( valid && argument == "-seed" )
+			seed = static_cast<uint32_t>( std::stoul( value ) );
+		else
+			valid = false;
+
+		if ( !valid )
+		{
+			PrintUsage( argv[0] );
+			return 1;
+		}
+		++i;
+	}
+
+	if ( sizes.empty() )
+		sizes = { 10000, 100000 };
+
+	// Peak RSS only grows, so it is only attributable to a size when sizes go up
+	std::sort( sizes.begin(), sizes.end() );
+	if ( !inputPath.empty() )
+		sizes = { 0 };
+
+	std::cout << std::left << std::setw( 10 ) << "lines" << std::right << std::setw( 10 ) << "words";
+	for ( const char *name : stageNames )
+		std::cout << std::setw( 11 ) << name;
+	std::cout << std::setw( 11 ) << "total" << std::setw( 13 ) << "lines/s" << std::setw( 11 ) << "peak MB" << std::setw( 8 ) << "errors" << '\n';
+	std::cout << std::string( 10 + 10 + 11 * ( ST_COUNT + 1 ) + 13 + 11 + 8, '-' ) << '\n';
+
+	for ( size_t size : sizes )
+	{
+		std::string path = inputPath.empty() ? ( savePath.empty() ? "asmbench.asm" : savePath ) : inputPath;
+		size_t lines = size;
+
+		if ( inputPath.empty() )
+		{
+			std::string source = SourceGenerator::Generate( size, seed );
+			std::ofstream output( path, std::ios::trunc );
+			output << source;
+			if ( !output.good() )
+			{
+				std::cout << "Could not write " << path << '\n';
+				return 1;
+			}
+		}
+
+		StageResult result = AssembleFile( path );
+
+		if ( !inputPath.empty() )
+		{
+			std::ifstream input( path );
+			lines = std::count( std::istreambuf_iterator<char>( input ), std::istreambuf_iterator<char>(), '\n' );
+		}
+		else if ( savePath.empty() )
+		{
+			std::remove( path.c_str() );
+		}
+
+		if ( !result.loaded )
+		{
+			std::cout << "Could not read " << path << '\n';
+			return 1;
+		}
+
+		double total = 0;
+		for ( double seconds : result.seconds )
+			total += seconds;
+
+		std::cout << std::left << std::setw( 10 ) << lines << std::right << std::setw( 10 ) << result.words << std::fixed << std::setprecision( 3 );
+		for ( double seconds : result.seconds )
+			std::cout << std::setw( 10 ) << seconds << "s";
+		std::cout << std::setw( 10 ) << total << "s" << std::setw( 13 ) << std::setprecision( 0 ) << ( total > 0 ? lines / total : 0 )
+			<< std::setw( 11 ) << std::setprecision( 1 ) << PeakResidentMegabytes() << std::setw( 8 ) << result.errors << '\n';
+	}
+
+	return 0;
+}
@@ -1,8 +1,20 @@
+#include <filesystem>
+#include <fstream>
+#include <regex>
 #include "Assembler.h"
 #include "Utilities.h"
 
+// Deepest chain of .INCLUDEs and macro expansions, which also stops a macro that expands itself
+static const size_t MAX_NESTING = 64;
 
 std::vector<std::string> Assembler::_errors;
+std::map<std::string, uint16_t> Assembler::_labelAddresses;
+std::vector<uint16_t> Assembler::_sourceLines;
+std::vector<uint16_t> Assembler::_sourceFileIndices;
+std::vector<std::string> Assembler::_sourceFiles;
+std::map<std::string, Assembler::StrippedFile> Assembler::_fileCache;
+std::map<std::string, std::shared_ptr<const Assembler::Macro>> Assembler::_macros;
+size_t Assembler::_expansionCount = 0;
 
 void RunAssemblyProcess( std::vector<std::string> &fileAsLines )
 {
@@ -12,6 +24,362 @@ void RunAssemblyProcess( std::vector<std::string> &fileAsLines )
 	std::vector<std::vector<std::string>> tokenizedInput = Assembler::GetTokenizedInputStrings( fileAsLines );
 }
 
+void Assembler::Reset()
+{
+	_errors.clear();
+	_labelAddresses.clear();
+	_sourceLines.clear();
+	_sourceFileIndices.clear();
+	_sourceFiles.clear();
+	_macros.clear();
+}
+
+bool Assembler::ReadFileAsLines( const std::string &path, std::vector<std::string> &fileAsLines )
+{
+	const StrippedFile *file = LoadStrippedFile( path );
+	if ( file == nullptr )
+		return false;
+
+	fileAsLines.clear();
+	_sourceLines.clear();
+	_sourceFileIndices.clear();
+	_sourceFiles = { path };
+	_macros.clear();
+	_expansionCount = 0;
+
+	std::vector<std::string> includeStack = { file->path };
+	ExpandLines( *file, 0, fileAsLines, includeStack );
+
+	return true;
+}
+
+void Assembler::ClearFileCache()
+{
+	_fileCache.clear();
+}
+
+const Assembler::StrippedFile *Assembler::LoadStrippedFile( const std::string &path )
+{
+	if ( path.empty() )
+		return nullptr;
+
+	std::string key = std::filesystem::absolute( path ).lexically_normal().string();
+
+	auto cached = _fileCache.find( key );
+	if ( cached != _fileCache.end() )
+		return &cached->second;
+
+	std::ifstream input( path, std::ios::in );
+	if ( !input.is_open() )
+		return nullptr;
+
+	StrippedFile file;
+	file.path = key;
+
+	std::string currentLine;
+	std::regex nonBlankLinePattern( "(\\w+)", std::regex_constants::ECMAScript );
+	uint16_t lineNumber = 0;
+
+	while ( std::getline( input, currentLine ) )
+	{
+		++lineNumber;
+		Assembler::RemoveCommentsFromLine( currentLine );
+
+		std::smatch sm;
+		if ( std::regex_search( currentLine, sm, nonBlankLinePattern ) )
+		{
+			file.lines.push_back( currentLine );
+			file.lineNumbers.push_back( lineNumber );
+		}
+	}
+
+	SplitFile( file );
+
+	return &_fileCache.emplace( key, std::move( file ) ).first->second;
+}
+
+void Assembler::SplitFile( StrippedFile &file )
+{
+	file.words.clear();
+	file.definitions.clear();
+
+	for ( const std::string &line : file.lines )
+		file.words.push_back( SplitWords( line ) );
+
+	for ( size_t i = 0; i < file.lines.size(); ++i )
+	{
+		const std::vector<std::string> &words = file.words[i];
+		if ( words.empty() || Utilities::ToUpperCase( words[0] ) != ".MACRO" )
+			continue;
+
+		auto macro = std::make_shared<Macro>();
+		macro->parameters.assign( words.begin() + std::min<size_t>( 2, words.size() ), words.end() );
+
+		size_t end = i + 1;
+		for ( ; end < file.lines.size(); ++end )
+		{
+			if ( !file.words[end].empty() && Utilities::ToUpperCase( file.words[end][0] ) == ".ENDM" )
+				break;
+
+			macro->body.push_back( file.lines[end] );
+		}
+
+		bool complete = words.size() >= 2 && end < file.lines.size();
+		file.definitions[i] = { end, complete ? std::move( macro ) : nullptr };
+		i = end;
+	}
+}
+
+void Assembler::ExpandLines( const StrippedFile &file, uint16_t fileIndex, std::vector<std::string> &fileAsLines, std::vector<std::string> &includeStack )
+{
+	const std::vector<std::string> &lines = file.lines;
+	const std::vector<uint16_t> &lineNumbers = file.lineNumbers;
+
+	for ( size_t i = 0; i < lines.size(); ++i )
+	{
+		const std::vector<std::string> &words = file.words[i];
+		if ( words.empty() )
+			continue;
+
+		std::string firstWord = Utilities::ToUpperCase( words[0] );
+		auto location = [&]() { return _sourceFiles[fileIndex] + " line " + std::to_string( lineNumbers[i] ); };
+
+		if ( firstWord == ".INCLUDE" )
+		{
+			if ( words.size() < 2 )
+			{
+				_errors.push_back( ".INCLUDE without a file in " + location() );
+				continue;
+			}
+
+			std::string name = words[1];
+			name.erase( std::remove( name.begin(), name.end(), '"' ), name.end() );
+
+			// Relative to the file that includes it
+			std::string includePath = ( std::filesystem::path( _sourceFiles[fileIndex] ).parent_path() / name ).string();
+			const StrippedFile *included = LoadStrippedFile( includePath );
+
+			if ( included == nullptr )
+				_errors.push_back( "Could not read " + includePath + " included in " + location() );
+			else if ( std::find( includeStack.begin(), includeStack.end(), included->path ) != includeStack.end() )
+				_errors.push_back( "Circular .INCLUDE of " + includePath + " in " + location() );
+			else if ( includeStack.size() >= MAX_NESTING )
+				_errors.push_back( ".INCLUDE nested too deeply in " + location() );
+			else
+			{
+				auto known = std::find( _sourceFiles.begin(), _sourceFiles.end(), includePath );
+				uint16_t includedIndex = static_cast<uint16_t>( known - _sourceFiles.begin() );
+				if ( known == _sourceFiles.end() )
+					_sourceFiles.push_back( includePath );
+
+				includeStack.push_back( included->path );
+				ExpandLines( *included, includedIndex, fileAsLines, includeStack );
+				includeStack.pop_back();
+			}
+			continue;
+		}
+
+		// Only the assembled file itself may set the origin or end the program. From an included file or a
+		// macro, .END would cut off the rest of the file around it and .ORIG would land mid-program.
+		if ( ( firstWord == ".ORIG" || firstWord == ".END" ) && includeStack.size() > 1 )
+		{
+			_errors.push_back( firstWord + " is only allowed in the assembled file, found in " + location() );
+			continue;
+		}
+
+		if ( firstWord == ".MACRO" )
+		{
+			// Parsed along with the file, a cached library only registers its definitions
+			const MacroDefinition &definition = file.definitions.at( i );
+
+			if ( words.size() < 2 )
+				_errors.push_back( ".MACRO without a name in " + location() );
+			else if ( definition.end == lines.size() )
+				_errors.push_back( ".MACRO " + words[1] + " has no .ENDM, defined in " + location() );
+			else
+				_macros[Utilities::ToUpperCase( words[1] )] = definition.macro;
+
+			i = definition.end;
+			continue;
+		}
+
+		if ( firstWord == ".ENDM" )
+		{
+			_errors.push_back( ".ENDM without .MACRO in " + location() );
+			continue;
+		}
+
+		// A macro is used like an instruction, optionally after a label. After an opcode the name is an operand, e.g. BRnzp NAME.
+		size_t nameIndex = words.size();
+		if ( _macros.find( firstWord ) != _macros.end() )
+			nameIndex = 0;
+		else if ( words.size() > 1 && !IsInstructionWord( firstWord ) && _macros.find( Utilities::ToUpperCase( words[1] ) ) != _macros.end() )
+			nameIndex = 1;
+
+		if ( nameIndex < words.size() )
+		{
+			if ( nameIndex == 1 )
+			{
+				// On a row of its own the label names the first word of the expansion
+				fileAsLines.push_back( words[0] );
+				_sourceLines.push_back( lineNumbers[i] );
+				_sourceFileIndices.push_back( fileIndex );
+			}
+
+			std::vector<std::string> arguments( words.begin() + nameIndex + 1, words.end() );
+			ExpandMacro( Utilities::ToUpperCase( words[nameIndex] ), arguments, lineNumbers[i], fileIndex, fileAsLines, includeStack );
+			continue;
+		}
+
+		fileAsLines.push_back( lines[i] );
+		_sourceLines.push_back( lineNumbers[i] );
+		_sourceFileIndices.push_back( fileIndex );
+	}
+}
+
+void Assembler::ExpandMacro( const std::string &name, const std::vector<std::string> &arguments, uint16_t lineNumber, uint16_t fileIndex,
+							 std::vector<std::string> &fileAsLines, std::vector<std::string> &includeStack )
+{
+	// Held on to, the body may redefine the macro
+	std::shared_ptr<const Macro> definition = _macros[name];
+	const Macro &macro = *definition;
+	std::string location = _sourceFiles[fileIndex] + " line " + std::to_string( lineNumber );
+
+	if ( arguments.size() != macro.parameters.size() )
+	{
+		_errors.push_back( "Macro " + name + " takes " + std::to_string( macro.parameters.size() ) + " arguments but got "
+						   + std::to_string( arguments.size() ) + " in " + location );
+		return;
+	}
+
+	if ( includeStack.size() >= MAX_NESTING )
+	{
+		_errors.push_back( "Macro " + name + " nested too deeply in " + location );
+		return;
+	}
+
+	std::string uniqueNumber = std::to_string( ++_expansionCount );
+	StrippedFile expansion;
+
+	for ( const std::string &line : macro.body )
+	{
+		std::string expandedLine;
+
+		for ( size_t c = 0; c < line.size(); ++c )
+		{
+			if ( line[c] == '\\' && c + 1 < line.size() )
+			{
+				if ( line[c + 1] == '@' )
+				{
+					expandedLine += uniqueNumber;
+					++c;
+					continue;
+				}
+
+				// The longest parameter name that follows, so \value is not taken for \v
+				size_t match = macro.parameters.size();
+				for ( size_t p = 0; p < macro.parameters.size(); ++p )
+				{
+					const std::string &parameter = macro.parameters[p];
+					if ( line.compare( c + 1, parameter.size(), parameter ) == 0
+						 && ( match == macro.parameters.size() || parameter.size() > macro.parameters[match].size() ) )
+						match = p;
+				}
+
+				if ( match < macro.parameters.size() )
+				{
+					expandedLine += arguments[match];
+					c += macro.parameters[match].size();
+					continue;
+				}
+			}
+
+			expandedLine += line[c];
+		}
+
+		expansion.lines.push_back( expandedLine );
+	}
+
+	// Every row of the expansion maps back to the line that used the macro
+	expansion.lineNumbers.assign( expansion.lines.size(), lineNumber );
+	SplitFile( expansion );
+
+	includeStack.push_back( "macro " + name );
+	ExpandLines( expansion, fileIndex, fileAsLines, includeStack );
+	includeStack.pop_back();
+}
+
+std::vector<std::string> Assembler::SplitWords( const std::string &line )
+{
+	std::vector<std::string> words;
+	std::string word;
+
+	for ( char c : line )
+	{
+		if ( c == ' ' || c == ',' || c == '\t' || c == '\r' )
+		{
+			if ( !word.empty() )
+				words.push_back( word );
+			word.clear();
+		}
+		else
+			word += c;
+	}
+
+	if ( !word.empty() )
+		words.push_back( word );
+
+	return words;
+}
+
+bool Assembler::IsInstructionWord( const std::string &upperCaseWord )
+{
+	static const std::vector<std::string> instructionWords = { "ADD", "AND", "JMP", "RET", "JSR", "JSRR", "LD", "LDI", "LDR", "LEA", "NOT", "ST", "STI", "STR",
+	"TRAP", "RTI", "BR", "BRP", "BRN", "BRZ", "BRZP", "BRNP", "BRNZ", "BRNZP", "LIT", "GETC", "OUT", "PUTS", "IN", "PUTSP", "HALT" };
+
+	// Pseudo-ops all start with a dot, labels never do
+	return ( !upperCaseWord.empty() && upperCaseWord[0] == '.' )
+		|| std::find( instructionWords.begin(), instructionWords.end(), upperCaseWord ) != instructionWords.end();
+}
+
+const std::map<std::string, uint16_t> &Assembler::GetLabelAddresses()
+{
+	return _labelAddresses;
+}
+
+const std::vector<uint16_t> &Assembler::GetSourceLines()
+{
+	return _sourceLines;
+}
+
+const std::vector<uint16_t> &Assembler::GetSourceFileIndices()
+{
+	return _sourceFileIndices;
+}
+
+const std::vector<std::string> &Assembler::GetSourceFiles()
+{
+	return _sourceFiles;
+}
+
+void Assembler::EraseSourceLines( size_t first, size_t last )
+{
+	if ( first <= last && last <= _sourceLines.size() )
+	{
+		_sourceLines.erase( _sourceLines.begin() + first, _sourceLines.begin() + last );
+		_sourceFileIndices.erase( _sourceFileIndices.begin() + first, _sourceFileIndices.begin() + last );
+	}
+}
+
+void Assembler::DuplicateSourceLine( size_t index, size_t count )
+{
+	if ( index < _sourceLines.size() )
+	{
+		_sourceLines.insert( _sourceLines.begin() + index, count, _sourceLines[index] );
+		_sourceFileIndices.insert( _sourceFileIndices.begin() + index, count, _sourceFileIndices[index] );
+	}
+}
+
 //Assumes all labels have been converted to 16 bit offsets in decimal form without pound sign
 std::vector<uint16_t> Assembler::AssembleIntoBinary( const std::vector<std::vector<std::string>> &inputTokens1 )
 {
@@ -129,6 +497,11 @@ void Assembler::ResolveAndReplaceLabels( std::vector<std::vector<std::string>> &
 
 	std::map<std::string, uint16_t> labelIndexPairs = Assembler::BuildLabelAddressMap( inputTokens, Assembler::_errors );
 
+	// Row 0 holds the origin, so the word of row i lives at startLocation + i - 1
+	_labelAddresses.clear();
+	for ( const auto &labelIndexPair : labelIndexPairs )
+		_labelAddresses[labelIndexPair.first] = static_cast<uint16_t>( startLocation + labelIndexPair.second - 1 );
+
 	Assembler::ReplaceLabelsWithOffsets( inputTokens, opCodesRequiringLabelChecks, labelIndexPairs, startLocation );
 
 }
@@ -289,6 +662,7 @@ void Assembler::HandleSTRINGZMacros( std::vector<std::vector<std::string>> &toke
 				}
 
 				newInstructions.push_back( std::vector<std::string>{"LIT", "0"} ); // Add null terminator
+				DuplicateSourceLine( i, newInstructions.size() - 1 );
 				tokeninzedInput.erase( tokeninzedInput.begin() + i ); // Remove original stringz macro command
 				tokeninzedInput.insert( tokeninzedInput.begin() + i, newInstructions.begin(), newInstructions.end() );
 
@@ -394,6 +768,7 @@ std::map<std::string, uint16_t> Assembler::BuildLabelAddressMap( std::vector<std
 				{
 					labelIndexPairs.insert( { label, i } );
 					inputTokens.erase( inputTokens.begin() + i );
+					EraseSourceLines( i, i + 1 );
 				}
 				--i;
 			}
@@ -515,6 +890,7 @@ void Assembler::HandleENDMacro( std::vector<std::string> &linifiedFile )
 		if ( valueAtIndex.find( ".END" ) == 0 )
 		{
 			linifiedFile.erase( linifiedFile.begin() + i, linifiedFile.end() );
+			EraseSourceLines( i, _sourceLines.size() );
 			break;
 		}
 	}
@@ -530,6 +906,11 @@ bool Assembler::HasErrors()
 	return false;
 }
 
+size_t Assembler::GetErrorCount()
+{
+	return _errors.size();
+}
+
 void Assembler::LogErrors( Logger &logger )
 {
 	logger.Log( _errors );
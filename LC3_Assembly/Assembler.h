@@ -1,5 +1,6 @@
 #pragma once
 #include <map>
+#include <memory>
 #include <algorithm>
 #include <string>
 #include <vector>
@@ -13,6 +14,21 @@ class Assembler
 public:
 	static void RunAssemblyProcess( std::vector<std::string>& fileAsLines );
 
+	// Clears errors, labels and source lines left over from a previous file
+	static void Reset();
+
+	// Reads a source file without comments and blank lines, remembering the source line of every kept line.
+	// .INCLUDE "file" pulls in another file in place, relative to the including one, and .MACRO NAME params
+	// ... .ENDM defines a macro that later lines use as NAME args. In the body \param stands for an
+	// argument and \@ for a number unique to each expansion, for labels. Both are expanded here, in the
+	// same pass that reads the lines.
+	static bool ReadFileAsLines( const std::string &path, std::vector<std::string> &fileAsLines );
+
+	// Files are read, stripped and split into words once per process, with their macro definitions parsed,
+	// and reused by every .INCLUDE of them after that. Only that much is cached: tokenizing, label
+	// resolution and encoding still run over each program's expanded lines.
+	static void ClearFileCache();
+
 	static std::vector<uint16_t> AssembleIntoBinary( const std::vector<std::vector<std::string>> &inputTokens );
 
 	static void ResolveAndReplaceLabels( std::vector<std::vector<std::string>> &inputTokens, uint16_t pcStart );
@@ -30,12 +46,65 @@ public:
 
 	static void LogErrors( Logger &logger );
 	static bool HasErrors();
+	static size_t GetErrorCount();
 
 	static bool IsANumberString( const std::string &token );
 	static uint16_t ConvertStringIfNumber( const std::string &token );
 
+	// Label addresses found by ResolveAndReplaceLabels
+	static const std::map<std::string, uint16_t> &GetLabelAddresses();
+
+	// 1-based source line of every row, row 0 being the origin. Empty if the input did not come from ReadFileAsLines.
+	static const std::vector<uint16_t> &GetSourceLines();
+
+	// Index into GetSourceFiles of every row, alongside GetSourceLines
+	static const std::vector<uint16_t> &GetSourceFileIndices();
+
+	// The file read by ReadFileAsLines followed by the files it included, in order of first use
+	static const std::vector<std::string> &GetSourceFiles();
+
 private:
+	struct Macro
+	{
+		std::vector<std::string> parameters;
+		std::vector<std::string> body;
+	};
+
+	struct MacroDefinition
+	{
+		size_t end;                           // row of its .ENDM, or the row count if there is none
+		std::shared_ptr<const Macro> macro;   // null if the definition is broken
+	};
+
+	struct StrippedFile
+	{
+		std::string path;
+		std::vector<std::string> lines;
+		std::vector<uint16_t> lineNumbers;
+		std::vector<std::vector<std::string>> words;       // every line split at blanks and commas
+		std::map<size_t, MacroDefinition> definitions;     // by the row of their .MACRO
+	};
+
 	static std::vector<std::string> _errors;
+	static std::map<std::string, uint16_t> _labelAddresses;
+	static std::vector<uint16_t> _sourceLines;
+	static std::vector<uint16_t> _sourceFileIndices;
+	static std::vector<std::string> _sourceFiles;
+	static std::map<std::string, StrippedFile> _fileCache;
+	static std::map<std::string, std::shared_ptr<const Macro>> _macros;
+	static size_t _expansionCount;
+
+	static const StrippedFile *LoadStrippedFile( const std::string &path );
+	static void SplitFile( StrippedFile &file );
+	static void ExpandLines( const StrippedFile &file, uint16_t fileIndex, std::vector<std::string> &fileAsLines, std::vector<std::string> &includeStack );
+	static void ExpandMacro( const std::string &name, const std::vector<std::string> &arguments, uint16_t lineNumber, uint16_t fileIndex,
+							 std::vector<std::string> &fileAsLines, std::vector<std::string> &includeStack );
+	static std::vector<std::string> SplitWords( const std::string &line );
+	static bool IsInstructionWord( const std::string &upperCaseWord );
+
+	// Keep _sourceLines in step when rows are removed or one row becomes several
+	static void EraseSourceLines( size_t first, size_t last );
+	static void DuplicateSourceLine( size_t index, size_t count );
 
 	static std::map<std::string, uint16_t> BuildLabelAddressMap( std::vector<std::vector<std::string>> &inputTokens, std::vector<std::string> &errors );
 	static void ReplaceLabelsWithOffsets( std::vector<std::vector<std::string>> &inputTokens, const std::vector<std::string> &opCodesToCheck, const std::map<std::string, uint16_t> &labelIndexPairs, uint16_t pcStart );
@@ -1,68 +1,38 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <filesystem>
 #include <fstream>
-#include <regex>
 #include "Assembler.h"
 #include "Logger.h"
+#include "../MyLC3/ObjectFormat.h"
 #include "Utilities.h"
 
-int main( int argc, char *argv[] )
+void PrintUsage( const char *executableName )
 {
-	if ( argc < 2 )
-	{
-		std::cout << "Usage: " << argv[0] << " path swap_endianness\n"
-			<< "  path:             relative or absolute path to input assembly code using forward slashes.\n"
-			<< "  swap_endianness:  whether to swap byte order during assembly. Acceptable values are TRUE or FALSE. Default is TRUE."
-			<< '\n';
-
-		return 1;
-	}
-
-	bool swapEndianness = true;
-
-	if (argc == 3)
-	{
-		if ( Utilities::ToUpperCase( argv[2] ) == "TRUE" )
-			swapEndianness = true;
-		else if ( Utilities::ToUpperCase( argv[2] ) == "FALSE" )
-			swapEndianness = false;
-		else
-		{
-			std::cout << "Usage: " << argv[0] << " path swap_endianness\n"
-				<< "  path:             relative or absolute path to input assembly code using forward slashes.\n"
-				<< "  swap_endianness:  whether to swap byte order during assembly. Acceptable values are TRUE or FALSE. Default is TRUE."
-				<< '\n';
-
-			return 1;
-		}
-	}
-
-	std::string inputFilePath = argv[1];
+	std::cout << "Usage: " << executableName << " path... swap_endianness format\n"
+		<< "  path:             relative or absolute path to input assembly code using forward slashes. Paths after the first\n"
+		<< "                    need a file extension. With several paths each file is assembled into a .obj and .sym next\n"
+		<< "                    to it, instead of ASSEMBLY.obj and ASSEMBLY.sym.\n"
+		<< "                    Files pulled in with .INCLUDE are read only once for all of them.\n"
+		<< "  swap_endianness:  whether to swap byte order during assembly. Acceptable values are TRUE or FALSE. Default is TRUE.\n"
+		<< "  format:           RAW for a plain word dump whose first word is the origin, or V2 for an object file\n"
+		<< "                    with a header, segments and a checksum. Default is RAW."
+		<< '\n';
+}
+
+// Assembles one file into outputName.obj and outputName.sym. Returns the exit code for it.
+int AssembleFile( const std::string &inputFilePath, const std::string &outputName, bool swapEndianness, bool writeObject )
+{
+	Assembler::Reset();
 
-	std::ifstream input( inputFilePath, std::ios::in );
-	if ( !input.is_open() )
+	std::vector<std::string> fileAsLines;
+	if ( !Assembler::ReadFileAsLines( inputFilePath, fileAsLines ) )
 	{
 		std::cout << "File failed to load at " + inputFilePath + ". Exiting..." << '\n';
 		return -1;
 	}
 
-	std::vector<std::string> fileAsLines;
-	std::string currentLine;
-	std::regex nonBlankLinePattern( "(\\w+)", std::regex_constants::ECMAScript );
-	while ( std::getline( input, currentLine ) )
-	{
-		Assembler::RemoveCommentsFromLine( currentLine );
-
-		std::smatch sm;
-		if ( std::regex_search( currentLine, sm, nonBlankLinePattern ) )
-		{
-			fileAsLines.push_back( currentLine );
-		}
-	}
-
-	input.close();
-
 	std::cout << "Recieved the following raw input: " << '\n';
 
 	for ( std::string const &line : fileAsLines )
@@ -136,12 +106,33 @@ int main( int argc, char *argv[] )
 		std::cout << "No errors were encountered during assembly.";
 	}
 
+	ObjectImage image;
+	image.entry = outputOfAssembler[0];
+	image.segments.push_back( { outputOfAssembler[0], std::vector<uint16_t>( outputOfAssembler.begin() + 1, outputOfAssembler.end() ) } );
+
+	for ( const auto &labelAddress : Assembler::GetLabelAddresses() )
+		image.symbols.push_back( { labelAddress.first, labelAddress.second } );
+	ObjectFormat::SortSymbols( image );
+
+	// Rows and output words line up one to one, the origin included
+	const std::vector<uint16_t> &sourceLines = Assembler::GetSourceLines();
+	const std::vector<uint16_t> &sourceFileIndices = Assembler::GetSourceFileIndices();
+	image.files = Assembler::GetSourceFiles();
+	for ( size_t row = 1; row < sourceLines.size() && row < outputOfAssembler.size(); ++row )
+		image.lines.push_back( { sourceFileIndices[row], sourceLines[row], static_cast<uint16_t>( image.entry + row - 1 ) } );
+
+	if ( ObjectFormat::WriteSymbolFile( outputName + ".sym", image ) )
+		std::cout << "Symbols and line map saved as " << outputName << ".sym" << '\n';
+
+	if ( writeObject )
+		outputOfAssembler = ObjectFormat::Encode( image );
+
 	if ( swapEndianness )
 		for ( uint16_t &value : outputOfAssembler )
 			value = Utilities::SwapEndianness( value );
 
 
-	std::ofstream output( "ASSEMBLY.obj", std::ios::binary | std::ios::trunc );
+	std::ofstream output( outputName + ".obj", std::ios::binary | std::ios::trunc );
 
 	if ( output.is_open() )
 	{
@@ -149,8 +140,72 @@ int main( int argc, char *argv[] )
 
 		output.close();
 
-		std::cout << "Assembly complete. Output saved as ASSEMBLY.obj" << '\n';
+		std::cout << "Assembly complete. Output saved as " << outputName << ".obj" << '\n';
 	}
 
 	return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+	if ( argc < 2 )
+	{
+		PrintUsage( argv[0] );
+		return 1;
+	}
+
+	// The first argument is always a path, so a file may be called TRUE or V2. More paths follow while they have an extension.
+	std::vector<std::string> inputFilePaths = { argv[1] };
+	int argument = 2;
+	while ( argument < argc && std::filesystem::path( argv[argument] ).has_extension() )
+		inputFilePaths.push_back( argv[argument++] );
+
+	bool swapEndianness = true;
+
+	if ( argument < argc )
+	{
+		if ( Utilities::ToUpperCase( argv[argument] ) == "TRUE" )
+			swapEndianness = true;
+		else if ( Utilities::ToUpperCase( argv[argument] ) == "FALSE" )
+			swapEndianness = false;
+		else
+		{
+			PrintUsage( argv[0] );
+			return 1;
+		}
+		++argument;
+	}
+
+	bool writeObject = false;
+
+	if ( argument < argc )
+	{
+		if ( Utilities::ToUpperCase( argv[argument] ) == "V2" )
+			writeObject = true;
+		else if ( Utilities::ToUpperCase( argv[argument] ) != "RAW" )
+		{
+			PrintUsage( argv[0] );
+			return 1;
+		}
+		++argument;
+	}
+
+	if ( argument < argc )
+	{
+		PrintUsage( argv[0] );
+		return 1;
+	}
+
+	if ( inputFilePaths.size() == 1 )
+		return AssembleFile( inputFilePaths[0], "ASSEMBLY", swapEndianness, writeObject );
+
+	int result = 0;
+	for ( const std::string &inputFilePath : inputFilePaths )
+	{
+		std::string outputName = std::filesystem::path( inputFilePath ).replace_extension().string();
+		if ( int fileResult = AssembleFile( inputFilePath, outputName, swapEndianness, writeObject ); fileResult != 0 && result == 0 )
+			result = fileResult;
+	}
+
+	return result;
 }
\ No newline at end of file
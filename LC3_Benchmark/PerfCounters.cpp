@@ -0,0 +1,72 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+PerfCounters::PerfCounters()
+{
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+
+    cacheMissFd = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+
+PerfCounters::~PerfCounters()
+{
+    if (cacheMissFd >= 0)
+        close(cacheMissFd);
+}
+
+void PerfCounters::Start()
+{
+    if (cacheMissFd < 0)
+        return;
+
+    ioctl(cacheMissFd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(cacheMissFd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t PerfCounters::Stop()
+{
+    if (cacheMissFd < 0)
+        return 0;
+
+    ioctl(cacheMissFd, PERF_EVENT_IOC_DISABLE, 0);
+
+    uint64_t count = 0;
+    if (read(cacheMissFd, &count, sizeof(count)) != sizeof(count))
+        return 0;
+
+    return count;
+}
+
+#else
+
+PerfCounters::PerfCounters() : cacheMissFd(-1)
+{
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::Start()
+{
+}
+
+uint64_t PerfCounters::Stop()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+// Hardware cache-miss counter for the calling thread. Only available on Linux through
+// perf_event_open; elsewhere IsAvailable() returns false and the benchmark prints n/a.
+class PerfCounters
+{
+public:
+    PerfCounters();
+
+    ~PerfCounters();
+
+    bool IsAvailable() const
+    {
+        return cacheMissFd >= 0;
+    }
+
+    void Start();
+
+    // Returns the number of cache misses since Start
+    uint64_t Stop();
+
+private:
+    int cacheMissFd;
+};
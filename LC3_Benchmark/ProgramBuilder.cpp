@@ -0,0 +1,136 @@
+#include "ProgramBuilder.h"
+#include <stdexcept>
+
+ProgramBuilder::ProgramBuilder(uint16_t origin) : origin(origin)
+{
+}
+
+void ProgramBuilder::Label(const std::string& name)
+{
+    labels[name] = words.size();
+}
+
+void ProgramBuilder::Add(uint16_t dr, uint16_t sr1, uint16_t sr2)
+{
+    words.push_back(0x1000 | (dr << 9) | (sr1 << 6) | sr2);
+}
+
+void ProgramBuilder::AddImm(uint16_t dr, uint16_t sr, int16_t imm5)
+{
+    words.push_back(0x1000 | (dr << 9) | (sr << 6) | 0x20 | (imm5 & 0x1F));
+}
+
+void ProgramBuilder::And(uint16_t dr, uint16_t sr1, uint16_t sr2)
+{
+    words.push_back(0x5000 | (dr << 9) | (sr1 << 6) | sr2);
+}
+
+void ProgramBuilder::AndImm(uint16_t dr, uint16_t sr, int16_t imm5)
+{
+    words.push_back(0x5000 | (dr << 9) | (sr << 6) | 0x20 | (imm5 & 0x1F));
+}
+
+void ProgramBuilder::Not(uint16_t dr, uint16_t sr)
+{
+    words.push_back(0x903F | (dr << 9) | (sr << 6));
+}
+
+void ProgramBuilder::Br(uint16_t nzp, const std::string& label)
+{
+    EmitWithOffset(nzp << 9, label, 9);
+}
+
+void ProgramBuilder::Jsr(const std::string& label)
+{
+    EmitWithOffset(0x4800, label, 11);
+}
+
+void ProgramBuilder::Jmp(uint16_t baseRegister)
+{
+    words.push_back(0xC000 | (baseRegister << 6));
+}
+
+void ProgramBuilder::Ret()
+{
+    Jmp(7);
+}
+
+void ProgramBuilder::Ld(uint16_t dr, const std::string& label)
+{
+    EmitWithOffset(0x2000 | (dr << 9), label, 9);
+}
+
+void ProgramBuilder::Ldi(uint16_t dr, const std::string& label)
+{
+    EmitWithOffset(0xA000 | (dr << 9), label, 9);
+}
+
+void ProgramBuilder::Ldr(uint16_t dr, uint16_t baseRegister, int16_t offset6)
+{
+    words.push_back(0x6000 | (dr << 9) | (baseRegister << 6) | (offset6 & 0x3F));
+}
+
+void ProgramBuilder::Lea(uint16_t dr, const std::string& label)
+{
+    EmitWithOffset(0xE000 | (dr << 9), label, 9);
+}
+
+void ProgramBuilder::St(uint16_t sr, const std::string& label)
+{
+    EmitWithOffset(0x3000 | (sr << 9), label, 9);
+}
+
+void ProgramBuilder::Sti(uint16_t sr, const std::string& label)
+{
+    EmitWithOffset(0xB000 | (sr << 9), label, 9);
+}
+
+void ProgramBuilder::Str(uint16_t sr, uint16_t baseRegister, int16_t offset6)
+{
+    words.push_back(0x7000 | (sr << 9) | (baseRegister << 6) | (offset6 & 0x3F));
+}
+
+void ProgramBuilder::Trap(uint16_t trapVector)
+{
+    words.push_back(0xF000 | (trapVector & 0xFF));
+}
+
+void ProgramBuilder::Fill(uint16_t value)
+{
+    words.push_back(value);
+}
+
+void ProgramBuilder::Stringz(const std::string& text)
+{
+    for (char letter : text)
+        words.push_back(static_cast<uint16_t>(letter));
+
+    words.push_back(0);
+}
+
+void ProgramBuilder::EmitWithOffset(uint16_t instruction, const std::string& label, int bitCount)
+{
+    fixups.push_back({ words.size(), label, bitCount });
+    words.push_back(instruction);
+}
+
+std::vector<uint16_t> ProgramBuilder::Build() const
+{
+    std::vector<uint16_t> image = words;
+
+    for (const Fixup& fixup : fixups)
+    {
+        auto label = labels.find(fixup.label);
+        if (label == labels.end())
+            throw std::runtime_error("Unknown label in benchmark program: " + fixup.label);
+
+        int offset = static_cast<int>(label->second) - static_cast<int>(fixup.index + 1);
+        int limit = 1 << (fixup.bitCount - 1);
+        if (offset < -limit || offset >= limit)
+            throw std::runtime_error("Label out of range in benchmark program: " + fixup.label);
+
+        image[fixup.index] |= offset & ((1 << fixup.bitCount) - 1);
+    }
+
+    return image;
+}
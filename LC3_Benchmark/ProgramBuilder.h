@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Builds small LC-3 images in code. PC-relative operands refer to labels that are resolved in Build().
+class ProgramBuilder
+{
+public:
+    explicit ProgramBuilder(uint16_t origin);
+
+    void Label(const std::string& name);
+
+    void Add(uint16_t dr, uint16_t sr1, uint16_t sr2);
+    void AddImm(uint16_t dr, uint16_t sr, int16_t imm5);
+    void And(uint16_t dr, uint16_t sr1, uint16_t sr2);
+    void AndImm(uint16_t dr, uint16_t sr, int16_t imm5);
+    void Not(uint16_t dr, uint16_t sr);
+    void Br(uint16_t nzp, const std::string& label);
+    void Jsr(const std::string& label);
+    void Jmp(uint16_t baseRegister);
+    void Ret();
+    void Ld(uint16_t dr, const std::string& label);
+    void Ldi(uint16_t dr, const std::string& label);
+    void Ldr(uint16_t dr, uint16_t baseRegister, int16_t offset6);
+    void Lea(uint16_t dr, const std::string& label);
+    void St(uint16_t sr, const std::string& label);
+    void Sti(uint16_t sr, const std::string& label);
+    void Str(uint16_t sr, uint16_t baseRegister, int16_t offset6);
+    void Trap(uint16_t trapVector);
+
+    void Fill(uint16_t value);
+    void Stringz(const std::string& text);
+
+    uint16_t GetOrigin() const
+    {
+        return origin;
+    }
+
+    // Resolves every label reference. Returns the image without the origin word.
+    std::vector<uint16_t> Build() const;
+
+private:
+    struct Fixup
+    {
+        size_t index;
+        std::string label;
+        int bitCount;
+    };
+
+    void EmitWithOffset(uint16_t instruction, const std::string& label, int bitCount);
+
+    uint16_t origin;
+
+    std::vector<uint16_t> words;
+
+    std::map<std::string, size_t> labels;
+
+    std::vector<Fixup> fixups;
+};
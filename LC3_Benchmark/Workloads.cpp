@@ -0,0 +1,218 @@
+#include "Workloads.h"
+#include "ProgramBuilder.h"
+#include "../MyLC3/CPU.h"
+#include "../MyLC3/Utilities.h"
+#include <algorithm>
+
+enum
+{
+    NZP_N = 0b100,
+    NZP_Z = 0b010,
+    NZP_P = 0b001,
+    NZP_ALL = 0b111
+};
+
+Workload Workloads::ArithmeticLoop()
+{
+    // ~58M instructions of ADD/AND/NOT with a counted inner loop
+    ProgramBuilder program(0x3000);
+
+    program.Ld(3, "OUTER");
+    program.Label("OLOOP");
+    program.Ld(1, "INNER");
+    program.Label("ILOOP");
+    program.Add(4, 4, 1);
+    program.AndImm(5, 4, 7);
+    program.Not(6, 5);
+    program.Add(6, 6, 4);
+    program.Add(2, 2, 6);
+    program.AddImm(1, 1, -1);
+    program.Br(NZP_P, "ILOOP");
+    program.AddImm(3, 3, -1);
+    program.Br(NZP_P, "OLOOP");
+    program.Trap(CPU::TRAP_HALT);
+    program.Label("OUTER");
+    program.Fill(0x1000);
+    program.Label("INNER");
+    program.Fill(0x0800);
+
+    return { "arithmetic loop", program.GetOrigin(), program.Build(), "", {} };
+}
+
+Workload Workloads::MemoryCopy()
+{
+    // Copies 4K words from x4000 to x8000, 1000 times
+    ProgramBuilder program(0x3000);
+
+    program.Ld(3, "PASSES");
+    program.Label("PASS");
+    program.Ld(1, "SOURCE");
+    program.Ld(2, "DESTINATION");
+    program.Ld(4, "COUNT");
+    program.Label("COPY");
+    program.Ldr(0, 1, 0);
+    program.Str(0, 2, 0);
+    program.AddImm(1, 1, 1);
+    program.AddImm(2, 2, 1);
+    program.AddImm(4, 4, -1);
+    program.Br(NZP_P, "COPY");
+    program.AddImm(3, 3, -1);
+    program.Br(NZP_P, "PASS");
+    program.Trap(CPU::TRAP_HALT);
+    program.Label("PASSES");
+    program.Fill(1000);
+    program.Label("SOURCE");
+    program.Fill(0x4000);
+    program.Label("DESTINATION");
+    program.Fill(0x8000);
+    program.Label("COUNT");
+    program.Fill(0x1000);
+
+    std::vector<uint16_t> source(0x1000);
+    for (size_t i = 0; i < source.size(); ++i)
+        source[i] = static_cast<uint16_t>(i * 7919);
+
+    return { "memory copy", program.GetOrigin(), program.Build(), "", { { 0x4000, source } } };
+}
+
+Workload Workloads::RecursiveCalls()
+{
+    // Naive recursive fib(20), 100 times. Exercises JSR/RET and the stack.
+    ProgramBuilder program(0x3000);
+
+    program.Ld(6, "STACK");
+    program.Ld(3, "REPEAT");
+    program.Label("AGAIN");
+    program.Ld(0, "N");
+    program.Jsr("FIB");
+    program.AddImm(3, 3, -1);
+    program.Br(NZP_P, "AGAIN");
+    program.Trap(CPU::TRAP_HALT);
+
+    // R1 = fib(R0)
+    program.Label("FIB");
+    program.AddImm(2, 0, -2);
+    program.Br(NZP_N, "BASE");
+    program.AddImm(6, 6, -3);
+    program.Str(7, 6, 0);
+    program.Str(0, 6, 1);
+    program.AddImm(0, 0, -1);
+    program.Jsr("FIB");
+    program.Str(1, 6, 2);
+    program.Ldr(0, 6, 1);
+    program.AddImm(0, 0, -2);
+    program.Jsr("FIB");
+    program.Ldr(2, 6, 2);
+    program.Add(1, 1, 2);
+    program.Ldr(7, 6, 0);
+    program.AddImm(6, 6, 3);
+    program.Ret();
+    program.Label("BASE");
+    program.AddImm(1, 0, 0);
+    program.Ret();
+
+    program.Label("STACK");
+    program.Fill(0xF000);
+    program.Label("N");
+    program.Fill(20);
+    program.Label("REPEAT");
+    program.Fill(100);
+
+    return { "recursive calls", program.GetOrigin(), program.Build(), "", {} };
+}
+
+Workload Workloads::StringOutput()
+{
+    // PUTS of a 64 character line, 32767 times
+    ProgramBuilder program(0x3000);
+
+    program.Ld(3, "COUNT");
+    program.Label("LOOP");
+    program.Lea(0, "MESSAGE");
+    program.Trap(CPU::TRAP_PUTS);
+    program.AddImm(3, 3, -1);
+    program.Br(NZP_P, "LOOP");
+    program.Trap(CPU::TRAP_HALT);
+    program.Label("COUNT");
+    program.Fill(0x7FFF);
+    program.Label("MESSAGE");
+    program.Stringz("The quick brown fox jumps over the lazy dog. 0123456789 ABCDEF\n");
+
+    return { "string output", program.GetOrigin(), program.Build(), "", {} };
+}
+
+Workload Workloads::ChannelPipeline()
+{
+    // Core 0 sends 1M words through channel 0, core 1 receives and sums them
+    ProgramBuilder program(0x3000);
+
+    program.Ldi(0, "CID");
+    program.Br(NZP_N | NZP_P, "CONSUMER");
+
+    program.Ld(3, "OUTER");
+    program.Label("SOLOOP");
+    program.Ld(1, "INNER");
+    program.Label("SEND");
+    program.Ldi(2, "STATUS");
+    program.Add(2, 2, 2); // room bit into the sign
+    program.Br(NZP_Z | NZP_P, "SEND");
+    program.Sti(1, "DATA");
+    program.AddImm(1, 1, -1);
+    program.Br(NZP_P, "SEND");
+    program.AddImm(3, 3, -1);
+    program.Br(NZP_P, "SOLOOP");
+    program.Trap(CPU::TRAP_HALT);
+
+    program.Label("CONSUMER");
+    program.Ld(3, "OUTER");
+    program.Label("ROLOOP");
+    program.Ld(1, "INNER");
+    program.Label("RECEIVE");
+    program.Ldi(2, "STATUS");
+    program.Br(NZP_Z | NZP_P, "RECEIVE");
+    program.Ldi(2, "DATA");
+    program.Add(4, 4, 2);
+    program.AddImm(1, 1, -1);
+    program.Br(NZP_P, "RECEIVE");
+    program.AddImm(3, 3, -1);
+    program.Br(NZP_P, "ROLOOP");
+    program.Trap(CPU::TRAP_HALT);
+
+    program.Label("CID");
+    program.Fill(CPU::MR_CID);
+    program.Label("STATUS");
+    program.Fill(CPU::MR_CHANNEL);
+    program.Label("DATA");
+    program.Fill(CPU::MR_CHANNEL + 2);
+    program.Label("OUTER");
+    program.Fill(64);
+    program.Label("INNER");
+    program.Fill(0x4000);
+
+    return { "channel pipeline", program.GetOrigin(), program.Build(), "", {}, 2 };
+}
+
+std::vector<Workload> Workloads::GetSyntheticWorkloads()
+{
+    return { ArithmeticLoop(), MemoryCopy(), RecursiveCalls(), StringOutput(), ChannelPipeline() };
+}
+
+bool Workloads::LoadProgram(const std::string& path, const std::string& input, Workload& workload)
+{
+    std::vector<uint16_t> scratch(MEM_MAX, 0);
+    uint16_t origin = Utilities::LoadFileInto(path, scratch.data(), MEM_MAX, true);
+
+    if (origin == 0)
+        return false;
+
+    auto last = std::find_if(scratch.rbegin(), scratch.rend(), [](uint16_t word) { return word != 0; });
+    size_t end = std::max<size_t>(scratch.rend() - last, origin);
+
+    workload.name = path;
+    workload.origin = origin;
+    workload.image.assign(scratch.begin() + origin, scratch.begin() + end);
+    workload.input = input;
+    workload.data.clear();
+
+    return true;
+}
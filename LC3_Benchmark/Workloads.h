@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Workload
+{
+    std::string name;
+
+    uint16_t origin;
+
+    std::vector<uint16_t> image;
+
+    // Scripted keyboard input, queued before the run starts
+    std::string input;
+
+    // Optional data placed in memory before the run, as (address, words) pairs
+    std::vector<std::pair<uint16_t, std::vector<uint16_t>>> data;
+
+    // Cores started at the origin. With more than one the workload runs until every core halts.
+    uint16_t cores = 1;
+};
+
+class Workloads
+{
+public:
+    static Workload ArithmeticLoop();
+
+    static Workload MemoryCopy();
+
+    static Workload RecursiveCalls();
+
+    static Workload StringOutput();
+
+    static Workload ChannelPipeline();
+
+    static std::vector<Workload> GetSyntheticWorkloads();
+
+    // Loads an assembled program and pairs it with scripted input
+    static bool LoadProgram(const std::string& path, const std::string& input, Workload& workload);
+};
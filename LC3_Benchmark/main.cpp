@@ -0,0 +1,244 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../MyLC3/CPU.h"
+#include "../MyLC3/Channels.h"
+#include "../MyLC3/Keyboard.h"
+#include "../MyLC3/Multiprocessor.h"
+#include "../MyLC3/Timer.h"
+#include "../MyLC3/Utilities.h"
+#include "PerfCounters.h"
+#include "Workloads.h"
+
+// Swallows guest output so terminal speed does not end up in the numbers
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int c) override
+	{
+		return c;
+	}
+
+	std::streamsize xsputn(const char*, std::streamsize count) override
+	{
+		return count;
+	}
+};
+
+struct RunResult
+{
+	uint64_t instructions = 0;
+	double seconds = 0;
+	uint64_t cacheMisses = 0;
+	uint64_t channelWords = 0;
+};
+
+RunResult RunWorkload(const Workload& workload, const std::vector<uint16_t>& osImage, uint64_t budget, PerfCounters& counters)
+{
+	CPU::Reset();
+	CPU::coreCount = 1; // a multi-core workload leaves its count behind
+	Keyboard::Reset();
+
+	std::copy(osImage.begin(), osImage.end(), CPU::memory);
+	std::copy(workload.image.begin(), workload.image.end(), CPU::memory + workload.origin);
+	for (const auto& block : workload.data)
+		std::copy(block.second.begin(), block.second.end(), CPU::memory + block.first);
+
+	for (char letter : workload.input)
+		Keyboard::Push(static_cast<uint16_t>(letter & 0xFF));
+	Keyboard::Close();
+
+	CPU::cores[0].SetValueInRegister(CPU::R_PC, workload.origin);
+	CPU::cores[0].SetConditionFlags(CPU::FL_ZRO);
+	CPU::cores[0].shouldBeRunning = true;
+
+	NullBuffer nullBuffer;
+	std::streambuf* consoleBuffer = std::cout.rdbuf(&nullBuffer);
+
+	counters.Start();
+	auto startTime = std::chrono::steady_clock::now();
+
+	if (workload.cores > 1)
+	{
+		// Runs to completion, the budget only applies to a single core
+		Multiprocessor::Run(workload.cores, workload.origin, 0);
+	}
+	else if (CPU::fusionEnabled)
+	{
+		while (CPU::cores[0].shouldBeRunning && CPU::cores[0].instructionCount < budget)
+			CPU::cores[0].ProcessFusedWord();
+	}
+	else
+	{
+		while (CPU::cores[0].shouldBeRunning && CPU::cores[0].instructionCount < budget)
+			CPU::cores[0].ProcessWord();
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+	RunResult result;
+	result.cacheMisses = counters.Stop();
+	result.seconds = elapsed.count();
+	result.instructions = workload.cores > 1 ? Multiprocessor::GetInstructionCount() : CPU::cores[0].instructionCount;
+	result.channelWords = Channels::GetTransferCount();
+
+	std::cout.rdbuf(consoleBuffer);
+	return result;
+}
+
+// The games in Programs, once LC3_Assembly has assembled them next to their sources. Missing ones
+// are reported and left out rather than failing the run.
+std::vector<Workload> LoadBundledPrograms(const std::string& directory, const std::string& input)
+{
+	std::vector<Workload> programs;
+
+	for (const char* name : { "2048", "dungeon" })
+	{
+		std::string path = directory + "/" + name + ".obj";
+		Workload program;
+
+		if (!std::ifstream(path).good())
+			std::cout << "Skipping " << path << ", assemble " << directory << "/" << name << ".asm with LC3_Assembly to include it" << '\n';
+		else if (Workloads::LoadProgram(path, input, program))
+			programs.push_back(program);
+	}
+
+	return programs;
+}
+
+void PrintUsage(const char* executableName)
+{
+	std::cout << "Usage: " << executableName << " options\n"
+		<< "  -programs dir     where the assembled 2048.obj and dungeon.obj are, run by default with the input below.\n"
+		<< "                    Default is Programs, or ../Programs when started from a project directory.\n"
+		<< "  -program path     also run an assembled program, e.g. Programs/2048.asm built with LC3_Assembly.\n"
+		<< "  -input text       scripted keyboard input for the preceding -program. Default is \"y\" followed by wasd moves.\n"
+		<< "  -os path          run traps through an LC-3 OS image instead of natively.\n"
+		<< "  -fusion           fuse common instruction sequences into single steps.\n"
+		<< "  -nofusion         execute every instruction on its own. This is the default.\n"
+		<< "  -budget count     instruction limit per workload. Default is 200000000.\n"
+		<< "  -repeat count     runs per workload, the fastest is reported. Default is 3."
+		<< '\n';
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<Workload> workloads = Workloads::GetSyntheticWorkloads();
+	std::vector<uint16_t> osImage;
+	uint64_t budget = 200000000;
+	int repeat = 3;
+	std::string programDirectory = std::ifstream("Programs/2048.asm").good() ? "Programs" : "../Programs";
+
+	std::string defaultInput = "y";
+	for (int i = 0; i < 2000; ++i)
+		defaultInput += "wasdy";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = Utilities::ToUpperCase(argv[i]);
+		bool hasValue = i + 1 < argc;
+
+		if (argument == "-PROGRAMS" && hasValue)
+		{
+			programDirectory = argv[++i];
+		}
+		else if (argument == "-PROGRAM" && hasValue)
+		{
+			Workload program;
+			if (!Workloads::LoadProgram(argv[++i], defaultInput, program))
+				return 1;
+			workloads.push_back(program);
+		}
+		else if (argument == "-INPUT" && hasValue && workloads.size() > Workloads::GetSyntheticWorkloads().size())
+		{
+			workloads.back().input = argv[++i];
+		}
+		else if (argument == "-OS" && hasValue)
+		{
+			osImage.assign(MEM_MAX, 0);
+			Utilities::LoadFileInto(argv[++i], osImage.data(), MEM_MAX, true);
+			osImage.resize(0x3000); // the trap table and routines live below user space
+			CPU::trapMode = CPU::TM_OS;
+		}
+		else if (argument == "-FUSION")
+		{
+			CPU::fusionEnabled = true;
+		}
+		else if (argument == "-NOFUSION")
+		{
+			CPU::fusionEnabled = false;
+		}
+		else if (argument == "-BUDGET" && hasValue)
+		{
+			budget = std::stoull(argv[++i]);
+		}
+		else if (argument == "-REPEAT" && hasValue)
+		{
+			repeat = std::max(1, std::stoi(argv[++i]));
+		}
+		else
+		{
+			std::cout << "Unrecognized argument: " << argv[i] << '\n' << '\n';
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<Workload> bundled = LoadBundledPrograms(programDirectory, defaultInput);
+	workloads.insert(workloads.begin() + Workloads::GetSyntheticWorkloads().size(), bundled.begin(), bundled.end());
+
+	PerfCounters counters;
+
+	std::cout << "Engine: " << (CPU::fusionEnabled ? "fused" : "unfused") << ", " << (CPU::trapMode == CPU::TM_OS ? "OS" : "native") << " traps"
+		<< ", best of " << repeat << " runs" << '\n' << '\n';
+
+	std::cout << std::left << std::setw(28) << "workload"
+		<< std::right << std::setw(14) << "instructions"
+		<< std::setw(12) << "seconds"
+		<< std::setw(12) << "MIPS"
+		<< std::setw(12) << "ns/instr"
+		<< std::setw(16) << "cache misses"
+		<< std::setw(14) << "misses/1K" << '\n';
+
+	for (const Workload& workload : workloads)
+	{
+		RunResult best;
+		for (int run = 0; run < repeat; ++run)
+		{
+			RunResult result = RunWorkload(workload, osImage, budget, counters);
+			if (run == 0 || result.seconds < best.seconds)
+				best = result;
+		}
+
+		std::cout << std::left << std::setw(28) << workload.name.substr(0, 27)
+			<< std::right << std::setw(14) << best.instructions
+			<< std::setw(12) << std::fixed << std::setprecision(4) << best.seconds
+			<< std::setw(12) << std::setprecision(2) << best.instructions / best.seconds / 1e6
+			<< std::setw(12) << std::setprecision(3) << best.seconds * 1e9 / best.instructions;
+
+		if (counters.IsAvailable())
+		{
+			std::cout << std::setw(16) << best.cacheMisses
+				<< std::setw(14) << std::setprecision(3) << best.cacheMisses * 1000.0 / best.instructions;
+		}
+		else
+		{
+			std::cout << std::setw(16) << "n/a" << std::setw(14) << "n/a";
+		}
+
+		std::cout << '\n';
+
+		if (best.channelWords)
+		{
+			std::cout << "  " << best.channelWords << " words through channels, "
+				<< std::setprecision(2) << best.channelWords / best.seconds / 1e6 << " M words/s" << '\n';
+		}
+	}
+
+	Timer::Shutdown();
+
+	return 0;
+}
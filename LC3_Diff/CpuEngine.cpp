@@ -0,0 +1,77 @@
+#include "CpuEngine.h"
+#include "../MyLC3/CPU.h"
+#include "../MyLC3/Keyboard.h"
+#include <algorithm>
+#include <iostream>
+
+CpuEngine::CpuEngine(bool fused) : fused(fused)
+{
+}
+
+void CpuEngine::Load(uint16_t origin, const std::vector<uint16_t>& image, const std::string& input)
+{
+    CPU::Reset();
+    CPU::trapMode = CPU::TM_NATIVE;
+    Keyboard::Reset();
+
+    std::copy(image.begin(), image.end(), CPU::memory + origin);
+
+    for (char letter : input)
+        Keyboard::Push(static_cast<uint16_t>(letter & 0xFF));
+    Keyboard::Close();
+
+    CPU::cores[0].SetValueInRegister(CPU::R_PC, origin);
+    CPU::cores[0].SetConditionFlags(CPU::FL_ZRO);
+    CPU::cores[0].shouldBeRunning = true;
+
+    output.str("");
+}
+
+int CpuEngine::Step()
+{
+    stepWrites.clear();
+
+    // Only the first instruction of a fused step can be predicted, the reference engine reports the rest
+    uint16_t address;
+    if (CPU::cores[0].GetStoreAddress(address))
+        stepWrites.push_back(address);
+
+    uint64_t before = CPU::cores[0].instructionCount;
+
+    // The CPU prints through std::cout, keep its output for comparison instead
+    std::streambuf* consoleBuffer = std::cout.rdbuf(output.rdbuf());
+
+    if (fused)
+        CPU::cores[0].ProcessFusedWord();
+    else
+        CPU::cores[0].ProcessWord();
+
+    std::cout.rdbuf(consoleBuffer);
+
+    return static_cast<int>(CPU::cores[0].instructionCount - before);
+}
+
+bool CpuEngine::IsRunning() const
+{
+    return CPU::cores[0].shouldBeRunning;
+}
+
+bool CpuEngine::IsInputExhausted() const
+{
+    return Keyboard::IsExhausted();
+}
+
+uint16_t CpuEngine::GetRegister(int index) const
+{
+    return CPU::cores[0].GetValueInReg(static_cast<CPU::REGISTER>(index));
+}
+
+uint16_t CpuEngine::GetConditionFlags() const
+{
+    return CPU::cores[0].GetConditionFlags();
+}
+
+uint16_t CpuEngine::PeekMemory(uint16_t address) const
+{
+    return CPU::memory[address];
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Engine.h"
+#include <sstream>
+
+// MyLC3's CPU. Its state is static, so only one instance should exist at a time.
+class CpuEngine : public Engine
+{
+public:
+    explicit CpuEngine(bool fused);
+
+    const char* GetName() const override
+    {
+        return fused ? "MyLC3 (fused)" : "MyLC3";
+    }
+
+    void Load(uint16_t origin, const std::vector<uint16_t>& image, const std::string& input) override;
+
+    int Step() override;
+
+    bool IsRunning() const override;
+
+    bool IsInputExhausted() const override;
+
+    uint16_t GetRegister(int index) const override;
+
+    uint16_t GetConditionFlags() const override;
+
+    uint16_t PeekMemory(uint16_t address) const override;
+
+    const std::vector<uint16_t>& GetStepWrites() const override
+    {
+        return stepWrites;
+    }
+
+    std::string GetOutput() const override
+    {
+        return output.str();
+    }
+
+private:
+    bool fused;
+
+    std::vector<uint16_t> stepWrites;
+
+    std::ostringstream output;
+};
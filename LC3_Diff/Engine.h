@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A step-able LC-3 implementation, so different interpreters can be run side by side.
+// Register indices 0-7 are R0-R7 and REG_PC is the program counter.
+class Engine
+{
+public:
+    enum
+    {
+        REG_PC = 8,
+        REG_COUNT
+    };
+
+    virtual ~Engine() = default;
+
+    virtual const char* GetName() const = 0;
+
+    // Clears the machine, places the image at origin and queues the scripted keyboard input
+    virtual void Load(uint16_t origin, const std::vector<uint16_t>& image, const std::string& input) = 0;
+
+    // Executes one step and returns the number of instructions it retired
+    virtual int Step() = 0;
+
+    virtual bool IsRunning() const = 0;
+
+    virtual bool IsInputExhausted() const = 0;
+
+    virtual uint16_t GetRegister(int index) const = 0;
+
+    // N/Z/P as bits 2/1/0
+    virtual uint16_t GetConditionFlags() const = 0;
+
+    // Reads memory without any device side effects
+    virtual uint16_t PeekMemory(uint16_t address) const = 0;
+
+    // Addresses stored to during the last step, as far as the engine can tell
+    virtual const std::vector<uint16_t>& GetStepWrites() const = 0;
+
+    virtual std::string GetOutput() const = 0;
+};
@@ -0,0 +1,79 @@
+#include "SimpleEngine.h"
+#include "../SimpleLC3/lc3.h"
+#include <algorithm>
+#include <cstdio>
+
+SimpleEngine* SimpleEngine::instance = nullptr;
+
+SimpleEngine::SimpleEngine()
+{
+    instance = this;
+    io = { CheckKey, GetChar, PutChar, Flush, OnWrite };
+}
+
+SimpleEngine::~SimpleEngine()
+{
+    instance = nullptr;
+    io.on_write = nullptr;
+}
+
+void SimpleEngine::Load(uint16_t origin, const std::vector<uint16_t>& image, const std::string& input)
+{
+    reset(origin);
+    std::copy(image.begin(), image.end(), memory + origin);
+
+    this->input = input;
+    inputPosition = 0;
+    output.clear();
+    running = true;
+}
+
+int SimpleEngine::Step()
+{
+    stepWrites.clear();
+    running = step() != 0;
+
+    return 1;
+}
+
+uint16_t SimpleEngine::GetRegister(int index) const
+{
+    return regs[index];
+}
+
+uint16_t SimpleEngine::GetConditionFlags() const
+{
+    return regs[R_PSR] & 0x7;
+}
+
+uint16_t SimpleEngine::PeekMemory(uint16_t address) const
+{
+    return memory[address];
+}
+
+uint16_t SimpleEngine::CheckKey()
+{
+    return !instance->IsInputExhausted();
+}
+
+int SimpleEngine::GetChar()
+{
+    if (instance->IsInputExhausted())
+        return EOF;
+
+    return static_cast<unsigned char>(instance->input[instance->inputPosition++]);
+}
+
+void SimpleEngine::PutChar(char c)
+{
+    instance->output += c;
+}
+
+void SimpleEngine::Flush()
+{
+}
+
+void SimpleEngine::OnWrite(uint16_t address)
+{
+    instance->stepWrites.push_back(address);
+}
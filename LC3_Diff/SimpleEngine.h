@@ -0,0 +1,69 @@
+#pragma once
+#include "Engine.h"
+
+// SimpleLC3's interpreter loop. It lives in globals, so only one instance should exist at a time.
+class SimpleEngine : public Engine
+{
+public:
+    SimpleEngine();
+
+    ~SimpleEngine() override;
+
+    const char* GetName() const override
+    {
+        return "SimpleLC3";
+    }
+
+    void Load(uint16_t origin, const std::vector<uint16_t>& image, const std::string& input) override;
+
+    int Step() override;
+
+    bool IsRunning() const override
+    {
+        return running;
+    }
+
+    bool IsInputExhausted() const override
+    {
+        return inputPosition >= input.size();
+    }
+
+    uint16_t GetRegister(int index) const override;
+
+    uint16_t GetConditionFlags() const override;
+
+    uint16_t PeekMemory(uint16_t address) const override;
+
+    const std::vector<uint16_t>& GetStepWrites() const override
+    {
+        return stepWrites;
+    }
+
+    std::string GetOutput() const override
+    {
+        return output;
+    }
+
+private:
+    static uint16_t CheckKey();
+
+    static int GetChar();
+
+    static void PutChar(char c);
+
+    static void Flush();
+
+    static void OnWrite(uint16_t address);
+
+    static SimpleEngine* instance;
+
+    bool running = false;
+
+    std::string input;
+
+    size_t inputPosition = 0;
+
+    std::string output;
+
+    std::vector<uint16_t> stepWrites;
+};
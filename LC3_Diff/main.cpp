@@ -0,0 +1,241 @@
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../MyLC3/CPU.h"
+#include "../MyLC3/Timer.h"
+#include "../MyLC3/Utilities.h"
+#include "CpuEngine.h"
+#include "SimpleEngine.h"
+
+namespace
+{
+	const char* opcodeNames[16] = { "BR", "ADD", "LD", "ST", "JSR", "AND", "LDR", "STR", "RTI", "NOT", "LDI", "STI", "JMP", "RES", "LEA", "TRAP" };
+
+	// Everything from KBSR up is device space, the engines model it differently
+	const uint32_t DEVICE_BASE = 0xFE00;
+
+	struct Divergence
+	{
+		std::vector<uint16_t> addresses;
+		bool registers = false;
+	};
+
+	void CompareState(const Engine& reference, const Engine& candidate, const std::vector<uint16_t>& addresses, Divergence& divergence)
+	{
+		for (int i = 0; i < Engine::REG_COUNT; ++i)
+			divergence.registers |= reference.GetRegister(i) != candidate.GetRegister(i);
+
+		divergence.registers |= reference.GetConditionFlags() != candidate.GetConditionFlags();
+
+		for (uint16_t address : addresses)
+		{
+			if (address < DEVICE_BASE && reference.PeekMemory(address) != candidate.PeekMemory(address))
+				divergence.addresses.push_back(address);
+		}
+	}
+
+	void CompareAllMemory(const Engine& reference, const Engine& candidate, Divergence& divergence)
+	{
+		for (uint32_t address = 0; address < DEVICE_BASE; ++address)
+		{
+			if (reference.PeekMemory(static_cast<uint16_t>(address)) != candidate.PeekMemory(static_cast<uint16_t>(address)))
+				divergence.addresses.push_back(static_cast<uint16_t>(address));
+		}
+	}
+
+	std::string Hex(uint16_t value)
+	{
+		std::ostringstream text;
+		text << 'x' << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << value;
+		return text.str();
+	}
+
+	char FlagLetter(uint16_t flags)
+	{
+		return flags & 0x4 ? 'N' : flags & 0x2 ? 'Z' : flags & 0x1 ? 'P' : '-';
+	}
+
+	void PrintDivergence(const Engine& reference, const Engine& candidate, uint64_t instructions, uint16_t pc, const std::vector<uint16_t>& words, const Divergence& divergence)
+	{
+		std::cout << "Divergence after " << instructions << " instructions, in the step starting at " << Hex(pc) << ":";
+		for (uint16_t word : words)
+			std::cout << ' ' << opcodeNames[word >> 12] << " (" << Hex(word) << ')';
+		std::cout << '\n' << '\n';
+
+		std::cout << std::left << std::setw(8) << "" << std::setw(14) << reference.GetName() << candidate.GetName() << '\n';
+		for (int i = 0; i < Engine::REG_COUNT; ++i)
+		{
+			uint16_t expected = reference.GetRegister(i);
+			uint16_t actual = candidate.GetRegister(i);
+			std::cout << std::setw(8) << (i == Engine::REG_PC ? std::string("PC") : "R" + std::to_string(i))
+				<< std::setw(14) << Hex(expected) << Hex(actual) << (expected != actual ? "  <<" : "") << '\n';
+		}
+
+		uint16_t expectedFlags = reference.GetConditionFlags();
+		uint16_t actualFlags = candidate.GetConditionFlags();
+		std::cout << std::setw(8) << "COND" << std::setw(14) << FlagLetter(expectedFlags) << FlagLetter(actualFlags)
+			<< (expectedFlags != actualFlags ? "  <<" : "") << '\n';
+
+		for (size_t i = 0; i < divergence.addresses.size() && i < 16; ++i)
+		{
+			uint16_t address = divergence.addresses[i];
+			std::cout << std::setw(8) << Hex(address) << std::setw(14) << Hex(reference.PeekMemory(address)) << Hex(candidate.PeekMemory(address)) << "  <<" << '\n';
+		}
+
+		if (divergence.addresses.size() > 16)
+			std::cout << "... " << divergence.addresses.size() - 16 << " more memory differences" << '\n';
+	}
+
+	// Compares what both engines printed so far. The shorter output only has to be a prefix,
+	// since one engine may stop with a message of its own.
+	bool CompareOutput(const Engine& reference, const Engine& candidate)
+	{
+		std::string expected = reference.GetOutput();
+		std::string actual = candidate.GetOutput();
+		size_t length = std::min(expected.size(), actual.size());
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			if (expected[i] != actual[i])
+			{
+				std::cout << "Output differs at character " << i << ": " << reference.GetName() << " printed \"" << expected.substr(i, 20)
+					<< "\", " << candidate.GetName() << " printed \"" << actual.substr(i, 20) << '"' << '\n';
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+void PrintUsage(const char* executableName)
+{
+	std::cout << "Usage: " << executableName << " path [options]\n"
+		<< "  Runs an assembled program on SimpleLC3 and MyLC3 in lockstep and stops at the first difference\n"
+		<< "  in registers, condition codes, stored memory or output.\n"
+		<< "  -input text       scripted keyboard input, fed to both engines.\n"
+		<< "  -fusion           compare MyLC3's fused steps instead of single instructions.\n"
+		<< "  -limit count      stop after this many instructions. Default is 100000000.\n"
+		<< "  -sweep count      compare all of memory every count instructions. Default is 65536, 0 disables."
+		<< '\n';
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::string input;
+	bool fused = false;
+	uint64_t limit = 100000000;
+	uint64_t sweepInterval = 0x10000;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string argument = Utilities::ToUpperCase(argv[i]);
+		bool hasValue = i + 1 < argc;
+
+		if (argument == "-INPUT" && hasValue)
+			input = argv[++i];
+		else if (argument == "-FUSION")
+			fused = true;
+		else if (argument == "-LIMIT" && hasValue)
+			limit = std::stoull(argv[++i]);
+		else if (argument == "-SWEEP" && hasValue)
+			sweepInterval = std::stoull(argv[++i]);
+		else
+		{
+			std::cout << "Unrecognized argument: " << argv[i] << '\n' << '\n';
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<uint16_t> scratch(MEM_MAX, 0);
+	uint16_t origin = Utilities::LoadFileInto(argv[1], scratch.data(), MEM_MAX, true);
+	if (origin == 0)
+		return 1;
+
+	std::vector<uint16_t> image(scratch.begin() + origin, scratch.end());
+
+	SimpleEngine reference;
+	CpuEngine candidate(fused);
+
+	reference.Load(origin, image, input);
+	candidate.Load(origin, image, input);
+
+	uint64_t instructions = 0;
+	uint64_t nextSweep = sweepInterval;
+	int exitCode = 0;
+
+	while (instructions < limit)
+	{
+		uint16_t pc = candidate.GetRegister(Engine::REG_PC);
+		std::vector<uint16_t> words;
+
+		int retired = candidate.Step();
+
+		// Bring the reference up to the same instruction and collect everything it stored
+		std::vector<uint16_t> addresses = candidate.GetStepWrites();
+		for (int i = 0; i < retired && reference.IsRunning(); ++i)
+		{
+			words.push_back(reference.PeekMemory(reference.GetRegister(Engine::REG_PC)));
+			reference.Step();
+			addresses.insert(addresses.end(), reference.GetStepWrites().begin(), reference.GetStepWrites().end());
+		}
+		instructions += retired;
+
+		Divergence divergence;
+		CompareState(reference, candidate, addresses, divergence);
+
+		if (sweepInterval && instructions >= nextSweep)
+		{
+			CompareAllMemory(reference, candidate, divergence);
+			nextSweep = instructions + sweepInterval;
+		}
+
+		if (divergence.registers || !divergence.addresses.empty())
+		{
+			PrintDivergence(reference, candidate, instructions, pc, words, divergence);
+			exitCode = 1;
+			break;
+		}
+
+		if (!reference.IsRunning() || !candidate.IsRunning())
+		{
+			if (reference.IsRunning() != candidate.IsRunning() && !(reference.IsInputExhausted() && candidate.IsInputExhausted()))
+			{
+				std::cout << (reference.IsRunning() ? candidate.GetName() : reference.GetName()) << " stopped alone after " << instructions << " instructions" << '\n';
+				exitCode = 1;
+			}
+			break;
+		}
+	}
+
+	if (exitCode == 0)
+	{
+		Divergence divergence;
+		CompareAllMemory(reference, candidate, divergence);
+
+		if (!divergence.addresses.empty())
+		{
+			PrintDivergence(reference, candidate, instructions, candidate.GetRegister(Engine::REG_PC), {}, divergence);
+			exitCode = 1;
+		}
+		else if (!CompareOutput(reference, candidate))
+		{
+			exitCode = 1;
+		}
+	}
+
+	Timer::Shutdown();
+
+	if (exitCode == 0)
+		std::cout << "No divergence in " << instructions << " instructions" << '\n';
+
+	return exitCode;
+}
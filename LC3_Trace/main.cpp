@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../MyLC3/ObjectFormat.h"
+#include "../MyLC3/TraceFormat.h"
+#include "../MyLC3/Utilities.h"
+
+namespace
+{
+	const char* opcodeNames[16] = { "BR", "ADD", "LD", "ST", "JSR", "AND", "LDR", "STR", "RTI", "NOT", "LDI", "STI", "JMP", "RES", "LEA", "TRAP" };
+
+	struct Filter
+	{
+		uint32_t pcFirst = 0;
+		uint32_t pcLast = 0xFFFF;
+		int address = -1;
+		int opcode = -1;
+		int destination = -1;
+		uint64_t first = 0;
+		uint64_t last = UINT64_MAX;
+
+		bool Matches(uint64_t index, const TraceRecord& record) const
+		{
+			if (index < first || index > last || record.pc < pcFirst || record.pc > pcLast)
+				return false;
+			if (opcode >= 0 && (record.instruction >> 12) != opcode)
+				return false;
+			if (destination >= 0 && (!(record.flags & TraceFormat::TF_DEST) || (record.flags & TraceFormat::TF_DEST_MASK) != destination))
+				return false;
+			if (address >= 0 && (!(record.flags & (TraceFormat::TF_LOAD | TraceFormat::TF_STORE)) || record.address != address))
+				return false;
+			return true;
+		}
+	};
+
+	std::string Hex(uint16_t value)
+	{
+		std::ostringstream text;
+		text << 'x' << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << value;
+		return text.str();
+	}
+
+	// Accepts x3000, 0x3000 and decimal
+	bool ParseNumber(const std::string& text, uint64_t& value)
+	{
+		try
+		{
+			size_t used = 0;
+			if (text.size() > 1 && (text[0] == 'x' || text[0] == 'X'))
+				value = std::stoull(text.substr(1), &used, 16), ++used;
+			else
+				value = std::stoull(text, &used, 0);
+			return used == text.size();
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+	}
+
+	// Parses "first:last" or a single value into an inclusive range
+	bool ParseRange(const std::string& text, uint64_t& first, uint64_t& last)
+	{
+		size_t colon = text.find(':');
+		if (colon == std::string::npos)
+			return ParseNumber(text, first) && ParseNumber(text, last);
+
+		return ParseNumber(text.substr(0, colon), first) && ParseNumber(text.substr(colon + 1), last);
+	}
+
+	void PrintRecord(uint64_t index, const TraceRecord& record)
+	{
+		std::cout << std::setw(12) << index << "  " << Hex(record.pc) << "  " << Hex(record.instruction) << "  "
+			<< std::left << std::setw(5) << opcodeNames[record.instruction >> 12] << std::right;
+
+		if (record.flags & TraceFormat::TF_DEST)
+			std::cout << "  R" << (record.flags & TraceFormat::TF_DEST_MASK) << "=" << Hex(record.destValue);
+
+		if (record.flags & TraceFormat::TF_LOAD)
+			std::cout << "  [" << Hex(record.address) << "] -> " << Hex(record.value);
+		else if (record.flags & TraceFormat::TF_STORE)
+			std::cout << "  [" << Hex(record.address) << "] <- " << Hex(record.value);
+
+		std::cout << '\n';
+	}
+}
+
+void PrintUsage(const char* executableName)
+{
+	std::cout << "Usage: " << executableName << " trace [options]\n"
+		<< "  Lists the instructions in a trace written by MyLC3 -trace=file.\n"
+		<< "  -pc first[:last]       only instructions in this address range.\n"
+		<< "  -address address       only loads and stores touching this address.\n"
+		<< "  -op name               only this opcode, e.g. LDR.\n"
+		<< "  -reg Rn                only instructions writing this register.\n"
+		<< "  -range first[:last]    only these instruction numbers, counted from 0.\n"
+		<< "  -limit count           stop after printing count instructions.\n"
+		<< "  -symbols image         symbols of the traced program, from a v2 object file or the .sym next to it.\n"
+		<< "  -stats                 print a summary instead of the instructions, with hot spots by label if symbols are given."
+		<< '\n';
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	Filter filter;
+	uint64_t limit = UINT64_MAX;
+	bool statsOnly = false;
+	ObjectImage symbols;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string argument = Utilities::ToUpperCase(argv[i]);
+		std::string value = i + 1 < argc ? argv[i + 1] : "";
+		uint64_t first, last;
+		bool valid = true;
+
+		if (argument == "-STATS")
+		{
+			statsOnly = true;
+			continue;
+		}
+
+		if (value.empty())
+			valid = false;
+		else if (argument == "-PC" && (valid = ParseRange(value, first, last)))
+			filter.pcFirst = static_cast<uint32_t>(first), filter.pcLast = static_cast<uint32_t>(last);
+		else if (argument == "-ADDRESS" && (valid = ParseNumber(value, first)))
+			filter.address = static_cast<int>(first & 0xFFFF);
+		else if (argument == "-RANGE" && (valid = ParseRange(value, first, last)))
+			filter.first = first, filter.last = last;
+		else if (argument == "-LIMIT")
+			valid = ParseNumber(value, limit);
+		else if (argument == "-SYMBOLS")
+			valid = Utilities::LoadDebugInfo(value, symbols);
+		else if (argument == "-OP")
+		{
+			std::string name = Utilities::ToUpperCase(value);
+			filter.opcode = 0;
+			while (filter.opcode < 16 && name != opcodeNames[filter.opcode])
+				++filter.opcode;
+			valid = filter.opcode < 16;
+		}
+		else if (argument == "-REG")
+		{
+			std::string name = Utilities::ToUpperCase(value);
+			valid = name.size() == 2 && name[0] == 'R' && name[1] >= '0' && name[1] <= '7';
+			filter.destination = valid ? name[1] - '0' : -1;
+		}
+		else
+			valid = false;
+
+		if (!valid)
+		{
+			std::cout << "Unrecognized argument: " << argv[i] << (value.empty() ? "" : " " + value) << '\n' << '\n';
+			PrintUsage(argv[0]);
+			return 1;
+		}
+		++i;
+	}
+
+	TraceReader reader;
+	if (!reader.Open(argv[1]))
+	{
+		std::cout << reader.GetError() << '\n';
+		return 1;
+	}
+
+	std::vector<TraceRecord> records;
+	uint64_t index = 0;
+	uint64_t printed = 0;
+	uint64_t matched = 0;
+	uint64_t blocks = 0;
+	uint64_t opcodeCount[16] = {};
+	std::vector<uint64_t> pcCount(symbols.symbols.empty() ? 0 : 0x10000);
+
+	while (printed < limit && reader.ReadBlock(records))
+	{
+		++blocks;
+		for (const TraceRecord& record : records)
+		{
+			if (filter.Matches(index, record))
+			{
+				++matched;
+				++opcodeCount[record.instruction >> 12];
+				if (!pcCount.empty())
+					++pcCount[record.pc];
+
+				if (!statsOnly && printed < limit)
+				{
+					PrintRecord(index, record);
+					++printed;
+				}
+			}
+			++index;
+		}
+	}
+
+	if (!reader.GetError().empty())
+	{
+		std::cout << "Stopped after " << index << " instructions: " << reader.GetError() << '\n';
+		return 1;
+	}
+
+	if (statsOnly)
+	{
+		std::cout << "Instructions: " << index << " in " << blocks << " blocks, " << matched << " matching" << '\n';
+		std::cout << "Encoded: " << reader.GetRawBytes() << " bytes, stored: " << reader.GetStoredBytes() << " bytes";
+		if (index)
+			std::cout << std::fixed << std::setprecision(2) << " (" << double(reader.GetStoredBytes()) / index << " bytes per instruction)";
+		std::cout << '\n' << '\n';
+
+		for (int i = 0; i < 16; ++i)
+		{
+			if (opcodeCount[i])
+				std::cout << std::left << std::setw(6) << opcodeNames[i] << std::right << std::setw(14) << opcodeCount[i] << '\n';
+		}
+
+		// Hot spots are attributed to the closest label at or below each PC
+		std::map<std::string, uint64_t> labelCount;
+		for (size_t pc = 0; pc < pcCount.size(); ++pc)
+		{
+			if (pcCount[pc])
+			{
+				std::string name = ObjectFormat::Locate(symbols, static_cast<uint16_t>(pc));
+				labelCount[name.empty() ? "(no label)" : name.substr(0, name.find('+'))] += pcCount[pc];
+			}
+		}
+
+		std::vector<std::pair<uint64_t, std::string>> hotSpots;
+		for (const auto& entry : labelCount)
+			hotSpots.push_back({ entry.second, entry.first });
+		std::sort(hotSpots.rbegin(), hotSpots.rend());
+
+		if (!hotSpots.empty())
+			std::cout << '\n' << "Hot spots:" << '\n';
+
+		for (size_t i = 0; i < hotSpots.size() && i < 10; ++i)
+		{
+			std::cout << std::left << std::setw(20) << hotSpots[i].second << std::right << std::setw(14) << hotSpots[i].first
+				<< std::fixed << std::setprecision(1) << std::setw(8) << 100.0 * hotSpots[i].first / matched << "%" << '\n';
+		}
+	}
+
+	return 0;
+}
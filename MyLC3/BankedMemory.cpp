@@ -0,0 +1,49 @@
+#include "BankedMemory.h"
+#include <algorithm>
+
+std::vector<uint16_t> BankedMemory::frames;
+uint16_t BankedMemory::mapping[PAGE_COUNT];
+bool BankedMemory::enabled = false;
+uint64_t BankedMemory::switchCount = 0;
+
+void BankedMemory::Enable(uint32_t frameCount)
+{
+    frameCount = std::clamp<uint32_t>(frameCount, PAGE_COUNT, MAX_FRAMES);
+
+    frames.assign(static_cast<size_t>(frameCount) * PAGE_SIZE, 0);
+    for (uint16_t page = 0; page < PAGE_COUNT; ++page)
+    {
+        mapping[page] = page;
+    }
+
+    switchCount = 0;
+    enabled = true;
+}
+
+void BankedMemory::Reset()
+{
+    if (enabled)
+        Enable(GetFrameCount());
+}
+
+bool BankedMemory::Map(uint16_t page, uint16_t frame)
+{
+    if (!enabled || page < FIRST_BANKED_PAGE || page > LAST_BANKED_PAGE || frame >= GetFrameCount())
+        return false;
+
+    if (mapping[page] == frame)
+        return true;
+
+    if (std::find(std::begin(mapping), std::end(mapping), frame) != std::end(mapping))
+        return false;
+
+    uint16_t* window = CPU::memory + (static_cast<size_t>(page) << PAGE_BITS);
+    std::copy(window, window + PAGE_SIZE, frames.begin() + (static_cast<size_t>(mapping[page]) << PAGE_BITS));
+
+    auto incoming = frames.begin() + (static_cast<size_t>(frame) << PAGE_BITS);
+    std::copy(incoming, incoming + PAGE_SIZE, window);
+
+    mapping[page] = frame;
+    ++switchCount;
+    return true;
+}
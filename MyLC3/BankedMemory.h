@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CPU.h"
+
+// Physical memory larger than the 64K address space, reached by switching 4K-word pages onto
+// frames of it through the bank registers (CPU::MR_BANK). Pages x1000-xEFFF can be switched. Page 0
+// holds the vector tables and page xF000 the device registers, so both stay on their own frames.
+//
+// CPU::memory stays the only memory the CPU and all tools look at: a switch copies the page out to
+// the frame it was mapped to and copies the new frame in. That costs two 8 KB copies per switch
+// instead of a translation step on every fetch, load and store, and keeps the fused loops, the
+// debuggers and the trace working on plain memory. Programs that stream through large data touch
+// a whole page between switches, where the copies are noise.
+class BankedMemory
+{
+public:
+    enum
+    {
+        PAGE_BITS = 12,
+        PAGE_SIZE = 1 << PAGE_BITS,           /* words per page and per frame */
+        PAGE_COUNT = MEM_MAX / PAGE_SIZE,
+        FIRST_BANKED_PAGE = 1,
+        LAST_BANKED_PAGE = PAGE_COUNT - 2,
+        MAX_FRAMES = 4096                     /* 16M words */
+    };
+
+    // Gives the machine frameCount frames, at least PAGE_COUNT. Every page starts on the frame
+    // with its own number, so programs that never switch see no difference.
+    static void Enable(uint32_t frameCount);
+
+    static bool IsEnabled()
+    {
+        return enabled;
+    }
+
+    // Clears all frames and maps every page back onto its own frame
+    static void Reset();
+
+    static uint32_t GetFrameCount()
+    {
+        return static_cast<uint32_t>(frames.size() / PAGE_SIZE);
+    }
+
+    static uint16_t GetFrame(uint16_t page)
+    {
+        return mapping[page];
+    }
+
+    // Maps page onto frame. Fails and leaves the mapping alone for a fixed page, a frame that does
+    // not exist or a frame another page is mapped onto, since the two copies would drift apart.
+    static bool Map(uint16_t page, uint16_t frame);
+
+    static uint64_t GetSwitchCount()
+    {
+        return switchCount;
+    }
+
+private:
+    static std::vector<uint16_t> frames;
+
+    static uint16_t mapping[PAGE_COUNT];
+
+    static bool enabled;
+
+    static uint64_t switchCount;
+};
@@ -1,408 +1,959 @@
 #include "CPU.h"
-#include "ExternalUtilities.h"
+#include "BankedMemory.h"
+#include "Channels.h"
+#include "Debugger.h"
+#include "DecodeTable.h"
+#include "GdbStub.h"
+#include "Keyboard.h"
+#include "ReverseDebugger.h"
+#include "Timer.h"
+#include "TimingModel.h"
+#include "TraceWriter.h"
+#include "TranslationCache.h"
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <thread>
 
+template <CPU::ENGINE engine>
 void CPU::WriteMemoryAt(uint16_t address, uint16_t value)
 {
-    if (address < MEM_MAX)
-        memory[address] = value;
+    NoteWrite<engine>(address, value);
+
+    if (address >= MR_KBSR) // device registers live at the top of the address space
+    {
+        WriteDeviceAt(address, value);
+        return;
+    }
+
+    StoreWord(address, value);
+
+    // Only the planned loop runs with a plan, the others never look at it
+    if constexpr (engine == EN_PLANNED)
+    {
+        if (TranslationCache::plan[address])
+            TranslationCache::Invalidate(address);
+    }
 }
 
-uint16_t CPU::reg[R_COUNT];
 uint16_t CPU::memory[MEM_MAX] = {0};
-bool CPU::shouldBeRunning = false;
+CPU CPU::cores[MAX_CORES];
+bool CPU::fusionEnabled = false;
+CPU::TRAP_MODE CPU::trapMode = CPU::TM_NATIVE;
+std::atomic<bool> CPU::interruptPending[MAX_CORES] = {};
+std::atomic<bool> CPU::ipiPending[MAX_CORES] = {};
+static std::mutex eventMutex;
+static std::condition_variable eventArrived;
+uint16_t CPU::coreCount = 1;
+bool CPU::lockstep = false;
+
+template <CPU::ENGINE engine>
+uint16_t CPU::ReadMemoryAt(uint16_t address) 
+{
+    // single compare keeps ordinary loads off the device path
+    uint16_t value = address >= MR_KBSR ? ReadDeviceAt(address) : LoadWord(address);
+
+    NoteRead<engine>(address, value);
 
-void CPU::UpdateFlags(REGISTER regIndex)
+    return value;
+}
+
+template <CPU::ENGINE engine>
+void CPU::NoteRead(uint16_t address, uint16_t value)
 {
-    uint16_t valueAtRegister = reg[regIndex];
+    if constexpr (engine == EN_INSTRUMENTED)
+    {
+        if (Debugger::IsArmed())
+            Debugger::CheckRead(address, value);
+    }
+}
 
-    if (valueAtRegister == 0)
+template <CPU::ENGINE engine>
+void CPU::NoteWrite(uint16_t address, uint16_t value)
+{
+    if constexpr (engine == EN_INSTRUMENTED)
     {
-        reg[R_COND] = FL_ZRO;
+        if (Debugger::IsArmed())
+            Debugger::CheckWrite(address, value);
     }
-    else if ((valueAtRegister >> 15) & 1) // negative bit is set
+}
+
+uint16_t CPU::ReadDeviceAt(uint16_t address)
+{
+    switch (address)
+    {
+    case MR_KBSR:
+    case MR_KBDR:
+    case MR_TSR:
+    case MR_TMR:
     {
-        reg[R_COND] = FL_NEG;
+        // The keyboard and the timer belong to core 0, whose thread alone touches their words
+        if (coreId != 0)
+            return 0;
+
+        if (address == MR_KBSR)
+        {
+            LatchKey();
+
+            if (!(memory[MR_KBSR] & KBSR_READY) && IsPollingLoop(memory[MR_KBSR]))
+            {
+                if (Keyboard::IsExhausted())
+                {
+                    // Nothing will ever arrive, e.g. the end of piped or scripted input
+                    std::cout << "Input closed" << '\n';
+                    shouldBeRunning = false;
+                }
+                else if (!lockstep)
+                {
+                    // The guest is spinning on the keyboard, sleep until something happens
+                    WaitForEvent(std::min(Timer::TimeUntilExpiry(), std::chrono::milliseconds(1000)));
+                    LatchKey();
+                }
+            }
+        }
+        else if (address == MR_TSR)
+        {
+            if (!Timer::HasExpired() && !lockstep && IsPollingLoop(memory[MR_TSR] & TSR_INTERRUPT))
+            {
+                WaitForEvent(std::min(Timer::TimeUntilExpiry(), std::chrono::milliseconds(1000)));
+            }
+
+            memory[MR_TSR] = (memory[MR_TSR] & TSR_INTERRUPT) | (Timer::ConsumeExpiry() ? TSR_READY : 0);
+        }
+        else if (address == MR_KBDR)
+        {
+            memory[MR_KBSR] &= ~KBSR_READY;
+
+            // Typed-ahead keys raised their event long ago, latch the next one at the coming block boundary
+            if (Keyboard::HasKey())
+                interruptPending[coreId].store(true, std::memory_order_relaxed);
+        }
+
+        return memory[address];
     }
-    else
+    case MR_DSR:
+        return 1 << 15; // the host console is always ready
+    // Per-core registers are answered directly, another core may be reading the same word
+    case MR_CID:
+        return coreId;
+    case MR_CCNT:
+        return coreCount;
+    case MR_CASA:
+        return casAddress;
+    case MR_CASE:
+        return casExpected;
+    case MR_CASX:
+        return casResult;
+    default:
     {
-        reg[R_COND] = FL_POS;
+        uint16_t channelOffset = address - MR_CHANNEL;
+        if (channelOffset < Channels::CHANNEL_COUNT * 4)
+            return ReadChannel(channelOffset / 4, channelOffset % 4 != 0);
+
+        uint16_t page = address - MR_BANK;
+        if (page < BankedMemory::PAGE_COUNT && BankedMemory::IsEnabled())
+            StoreWord(address, BankedMemory::GetFrame(page));
+        break;
+    }
     }
+
+    return LoadWord(address);
 }
 
-uint16_t CPU::ReadMemoryAt(uint16_t address) 
+uint16_t CPU::ReadChannel(uint16_t channel, bool data)
 {
-    if (address == CPU::MR_KBSR)
+    if (data)
+        return Channels::Receive(channel);
+
+    uint16_t status = Channels::GetStatus(channel);
+
+    bool waitingForData = !(status & Channels::CS_DATA) && IsPollingLoop(status);
+    bool waitingForRoom = !(status & Channels::CS_ROOM) && Channels::IsProducer(channel, coreId);
+
+    if ((waitingForData || waitingForRoom) && coreCount == 1)
+    {
+        // No other core could ever send or take a word
+        std::cout << "Channel closed" << '\n';
+        shouldBeRunning = false;
+    }
+    else if ((waitingForData || waitingForRoom) && !lockstep)
+    {
+        // The other end runs on another thread, give it the host core rather than spinning
+        std::this_thread::yield();
+        status = Channels::GetStatus(channel);
+    }
+
+    return status;
+}
+
+void CPU::WriteDeviceAt(uint16_t address, uint16_t value)
+{
+    switch (address)
     {
-        if (ExternalUtilities::check_key())
+    case MR_KBSR:
+    case MR_KBDR:
+    case MR_TSR:
+    case MR_TMR:
+    {
+        // Writes of other cores are dropped, the keyboard and the timer belong to core 0
+        if (coreId != 0)
+            return;
+
+        if (address == MR_KBSR)
         {
-            CPU::memory[CPU::MR_KBSR] = (1 << 15);
-            CPU::memory[CPU::MR_KBDR] = getchar();
+            // Only the interrupt enable bit is writable
+            memory[MR_KBSR] = (memory[MR_KBSR] & KBSR_READY) | (value & KBSR_INTERRUPT);
+            interruptPending[coreId].store(true, std::memory_order_relaxed);
         }
-        else 
+        else if (address == MR_TSR)
+        {
+            memory[MR_TSR] = (memory[MR_TSR] & TSR_READY) | (value & TSR_INTERRUPT);
+            interruptPending[coreId].store(true, std::memory_order_relaxed);
+        }
+        else
+        {
+            if (address == MR_TMR)
+                Timer::SetInterval(value);
+
+            memory[address] = value;
+        }
+        return;
+    }
+    case MR_DSR:
+        return;
+    case MR_DDR:
+    {
+        std::cout << static_cast<char>(value & 0xFF) << std::flush;
+        break;
+    }
+    case MR_IPI:
+    {
+        SendInterrupt(value);
+        return;
+    }
+    case MR_CASA:
+    {
+        casAddress = value;
+        return;
+    }
+    case MR_CASE:
+    {
+        casExpected = value;
+        return;
+    }
+    case MR_CASX:
+    {
+        casResult = CompareAndSwap(value);
+        return;
+    }
+    case MR_CID:
+    case MR_CCNT:
+        return;
+    case MR_MCR:
+    {
+        if (!((value >> 15) & 1)) // clearing the clock enable bit stops the machine
         {
-            CPU::memory[CPU::MR_KBSR] = 0;
+            std::cout << "HALT" << '\n';
+            shouldBeRunning = false;
         }
+        break;
     }
-    else if (address > (MEM_MAX))
+    default:
     {
-        std::cout << "Attempted to read data outside of MEM_MAX. Attempted Address was: " << address << '\n';
+        // Channels are shared between cores and never go through memory[]; writing a status does nothing
+        uint16_t channelOffset = address - MR_CHANNEL;
+        if (channelOffset < Channels::CHANNEL_COUNT * 4)
+        {
+            if (channelOffset % 4 != 0)
+                Channels::Send(channelOffset / 4, value, coreId);
+            return;
+        }
+
+        uint16_t page = address - MR_BANK;
+        if (page < BankedMemory::PAGE_COUNT && BankedMemory::IsEnabled())
+        {
+            // Writes naming a fixed page or an unusable frame leave the mapping as it was
+            BankedMemory::Map(page, value);
+            StoreWord(address, BankedMemory::GetFrame(page));
+            return;
+        }
+        break;
     }
-    
-    return CPU::memory[address];
+    }
+
+    StoreWord(address, value);
 }
 
 void CPU::ProcessProgram()
 {
-    reg[R_COND] = FL_ZRO;
+    SetConditionFlags(FL_ZRO);
 
-    while (CPU::shouldBeRunning)
+    Run();
+}
+
+void CPU::Run()
+{
+    if (TimingModel::IsEnabled() || TraceWriter::IsEnabled() || ReverseDebugger::IsEnabled())
     {
-        ProcessWord();
+        // Instrumentation looks at every instruction on its own, so it gets a loop of its own
+        while (CPU::shouldBeRunning)
+        {
+            ProcessInstrumentedWord();
+        }
+    }
+    else if (fusionEnabled && TranslationCache::IsEnabled())
+    {
+        while (CPU::shouldBeRunning)
+        {
+            ProcessPlannedWord();
+        }
+    }
+    else if (fusionEnabled)
+    {
+        while (CPU::shouldBeRunning)
+        {
+            ProcessFusedWord();
+        }
+    }
+    else
+    {
+        while (CPU::shouldBeRunning)
+        {
+            ProcessWord();
+        }
     }
 }
 
-void CPU::Add(const uint16_t& instruction)
+template <CPU::ENGINE engine>
+void CPU::Trap(const uint16_t& instruction) 
 {
-    // xxxx xxx xxx x xx xxx
-    // inst  dr sr1 m xx sr2
-    // inst  dr sr1 m imm5
-    uint16_t destinationRegister = (instruction >> 9) & 0x7;
-    uint16_t firstRegister = (instruction >> 6) & 0x7;
-    if ((instruction >> 5) & 1) // alt-add mode
-    {
-        uint16_t valueToAdd = (instruction) & 0b11111;
-        valueToAdd = ExtendSign(valueToAdd, 5);
-    
-        reg[destinationRegister] = reg[firstRegister] + valueToAdd;
-    }
-    else // first add mode 
-    {
-        uint16_t secondRegister = (instruction) & 0x7;
-      
-        reg[destinationRegister] = reg[firstRegister] + reg[secondRegister];
-    }
-    
-    UpdateFlags(static_cast<REGISTER>(destinationRegister));
+    reg[R_R7] = reg[R_PC];
+
+    if (trapMode == TM_OS)
+    {
+        // xxxx xxxx xxxxxxxx
+        // inst 0000 trapvect8
+        reg[R_PC] = ReadMemoryAt<engine>(instruction & 0xFF);
+        return;
+    }
+
+    TrapNative<engine>(instruction);
 }
 
-void CPU::And(const uint16_t& instruction)
+template <CPU::ENGINE engine>
+void CPU::TrapNative(const uint16_t& instruction)
 {
-    // xxxx xxx xxx x xx xxx
-    // inst  dr sr1 m xx sr2
-    // inst  dr sr1 m imm5
-    uint16_t firstRegister = (instruction >> 6) & 0x7;
-    uint16_t destinationRegister = (instruction >> 9) & 0x7;
+    switch (instruction & 0xFF)
+    {
+    case TRAP_GETC:
+    {
+        uint16_t key = ReadKey(engine == EN_INSTRUMENTED ? &Debugger::breakRequested : nullptr);
 
-    if ((instruction >> 5) & 1) // alt-and mode
+        if (key == 0xFFFE)
+        {
+            --reg[R_PC]; // Ctrl-C in the debugger, stop on the TRAP so continuing waits again
+            break;
+        }
+
+        SetValueInRegister(R_R0, key);
+        UpdateFlags(R_R0);
+        break;
+    }
+    case TRAP_HALT:
+    {
+        std::cout << "HALT" << '\n';
+        shouldBeRunning = false;
+        break;
+    }
+    case TRAP_IN:
     {
-        uint16_t valueToAnd = (instruction) & 0b11111;
-        valueToAnd = ExtendSign(valueToAnd, 5);
+        std::cout << "Input a character: " << std::flush;
+        uint16_t key = ReadKey(engine == EN_INSTRUMENTED ? &Debugger::breakRequested : nullptr);
 
-        reg[destinationRegister] = reg[firstRegister] & valueToAnd;
+        if (key == 0xFFFE)
+        {
+            std::cout << '\n';
+            --reg[R_PC];
+            break;
+        }
+
+        SetValueInRegister(R_R0, key & 0xFF);
+        UpdateFlags(R_R0);
+        std::cout << std::flush;
+        break;
     }
-    else // normal mode
+    case TRAP_OUT:
     {
-        uint16_t secondRegister = (instruction) & 0x7;
-        reg[destinationRegister] = reg[firstRegister] & reg[secondRegister];
+        char letter = GetValueInReg(R_R0) & 0xFF;
+        std::cout << letter << std::flush;
+        break;
+    }
+    case TRAP_PUTS:
+    {
+        // Strings are read straight from the memory array and written out in chunks
+        char buffer[256];
+        size_t length = 0;
+
+        for (uint32_t address = GetValueInReg(R_R0); address < MEM_MAX; ++address)
+        {
+            uint16_t letter = LoadWord(address);
+            NoteRead<engine>(address, letter);
+
+            if (!(letter & 0xFF))
+                break;
+
+            buffer[length++] = static_cast<char>(letter & 0xFF);
+
+            if (length == sizeof(buffer))
+            {
+                std::cout.write(buffer, length);
+                length = 0;
+            }
+        }
+
+        std::cout.write(buffer, length) << std::flush;
+        break;
     }
+    case TRAP_PUTSP:
+    {
+        char buffer[256];
+        size_t length = 0;
+
+        for (uint32_t address = GetValueInReg(R_R0); address < MEM_MAX; ++address)
+        {
+            uint16_t letter = LoadWord(address);
+            NoteRead<engine>(address, letter);
+
+            if (!letter)
+                break;
+
+            buffer[length++] = static_cast<char>(letter & 0xFF); // Low side
+
+            if ((letter >> 8) == 0)
+                break;
+
+            buffer[length++] = static_cast<char>(letter >> 8); //High side
+
+            if (length >= sizeof(buffer) - 1)
+            {
+                std::cout.write(buffer, length);
+                length = 0;
+            }
+        }
 
-    UpdateFlags(static_cast<REGISTER>(destinationRegister));
+        std::cout.write(buffer, length) << std::flush;
+        break;
+    }
+    default:
+        std::cout << "Error in execution of trap code: " << std::to_string(instruction & 0xFF) << " at line: " << std::to_string(reg[R_PC]) << ". Full instruction: " << std::to_string(instruction) << '\n';
+        break;
+    }
 }
 
-void CPU::Not(const uint16_t& instruction) 
+void CPU::SetValueInRegister(REGISTER regIndex, uint16_t value)
 {
-    // xxxx xxx xxx x xxxxx
-    // inst DR  SR  x xxxxx
-    uint16_t destinationRegister = (instruction >> 9) & 0x7;
-    uint16_t firstRegister = (instruction >> 6) & 0x7;
-
-    reg[destinationRegister] = ~reg[firstRegister];
+    if (regIndex == R_COND)
+    {
+        SetConditionFlags(value);
+        return;
+    }
 
-    CPU::UpdateFlags(static_cast<REGISTER>(destinationRegister));
+    CPU::reg[regIndex] = value;
 }
 
-void CPU::Jmp(const uint16_t& instruction) 
+uint16_t CPU::ReadKey(const std::atomic<bool>* cancel)
 {
-    // xxxx xxx xxx xxxxxx
-    // inst xxx reg xxxxxx
+    // A key already latched by a KBSR poll has to be consumed first
+    if (coreId == 0 && (memory[MR_KBSR] & KBSR_READY))
+    {
+        memory[MR_KBSR] &= ~KBSR_READY;
+        return memory[MR_KBDR];
+    }
+
+    uint16_t key = Keyboard::PopKey(cancel);
 
-    uint16_t regIndex = (instruction >> 6) & 0x7;
-    reg[R_PC] = reg[regIndex];
+    if (Keyboard::IsExhausted() && key == 0xFFFF)
+    {
+        std::cout << "Input closed" << '\n';
+        shouldBeRunning = false;
+    }
+
+    return key;
 }
 
-void CPU::Jsr(const uint16_t& instruction) 
+void CPU::Reset()
 {
-    // xxxx x xxxxxxxxxxx JSR
-    // inst m1 PCOffset11
-    // xxxx x xx xxx xxxxxx
-    // inst m0   reg xxxxxx
+    std::fill(std::begin(memory), std::end(memory), 0);
+    BankedMemory::Reset();
+    Channels::Reset();
 
-    bool flagSet = (instruction >> 11) & 1;
-    reg[R_R7] = reg[R_PC];
-    
-    if (flagSet) 
+    for (uint16_t core = 0; core < MAX_CORES; ++core)
     {
-        reg[R_PC] += ExtendSign(instruction & 0b11111111111, 11);
+        cores[core] = CPU();
+        cores[core].coreId = core;
+        interruptPending[core].store(false, std::memory_order_relaxed);
+        ipiPending[core].store(false, std::memory_order_relaxed);
     }
-    else 
+}
+
+template <CPU::ENGINE engine>
+void CPU::Rti(const uint16_t&)
+{
+    if (psr & PSR_USER)
     {
-        uint16_t registerIndex = (instruction >> 6) & 0x7;
+        Interrupt<engine>(INT_PRIVILEGE, GetPriority());
+        return;
+    }
+
+    reg[R_PC] = ReadMemoryAt<engine>(reg[R_R6]++);
+    SetPSR(ReadMemoryAt<engine>(reg[R_R6]++));
 
-        reg[R_PC] = reg[registerIndex];
+    if (psr & PSR_USER)
+    {
+        savedSSP = reg[R_R6];
+        reg[R_R6] = savedUSP;
     }
+
+    // The priority may have dropped below a request that was held back
+    interruptPending[coreId].store(true, std::memory_order_relaxed);
 }
 
-void CPU::Ld(const uint16_t & instruction)
+template <CPU::ENGINE engine>
+void CPU::Interrupt(uint16_t vector, uint16_t priority)
 {
-    // xxxx xxx xxxxxxxxx
-    // inst DR  PCOffset9
-    uint16_t destinationRegister = (instruction >> 9) & 0x7;
-    uint16_t signExtendedOffset = ExtendSign((instruction) & 0b111111111, 9);
-    
-    reg[destinationRegister] = CPU::ReadMemoryAt(reg[R_PC] + signExtendedOffset);
-
-    UpdateFlags(static_cast<REGISTER>(destinationRegister));
+    uint16_t oldPSR = GetPSR();
+
+    if (psr & PSR_USER)
+    {
+        savedUSP = reg[R_R6];
+        reg[R_R6] = savedSSP;
+    }
+
+    WriteMemoryAt<engine>(--reg[R_R6], oldPSR);
+    WriteMemoryAt<engine>(--reg[R_R6], reg[R_PC]);
+
+    psr = priority << PSR_PRIORITY_SHIFT; // supervisor mode
+    reg[R_PC] = ReadMemoryAt<engine>(INT_TABLE + vector);
 }
 
-void CPU::Ldi(const uint16_t& instruction)
+template <CPU::ENGINE engine>
+void CPU::ServiceInterrupts()
 {
-    // xxxx xxx xxxxxxxxx
-    // inst DR  9PCOffset
+    interruptPending[coreId].store(false, std::memory_order_relaxed);
+
+    if (ipiPending[coreId].load(std::memory_order_acquire) && GetPriority() < PL_IPI)
+    {
+        ipiPending[coreId].store(false, std::memory_order_relaxed);
+        Interrupt<engine>(INT_IPI, PL_IPI);
+        return;
+    }
 
-    uint16_t destinationRegister = (instruction >> 9) & 0x7;
-    uint16_t signExtendedOffset = ExtendSign((instruction) & 0b111111111, 9);
+    // Device interrupts go to core 0 only
+    if (coreId != 0)
+        return;
 
-    reg[destinationRegister] = ReadMemoryAt(ReadMemoryAt(reg[R_PC] + signExtendedOffset));
+    GdbStub::Poll();
 
-    UpdateFlags(static_cast<REGISTER>(destinationRegister));
+    LatchKey();
+
+    if ((memory[MR_TSR] & TSR_INTERRUPT) && Timer::HasExpired() && GetPriority() < PL_TIMER)
+    {
+        Interrupt<engine>(INT_TIMER, PL_TIMER);
+    }
+    else if ((memory[MR_KBSR] & (KBSR_READY | KBSR_INTERRUPT)) == (KBSR_READY | KBSR_INTERRUPT) && GetPriority() < PL_KEYBOARD)
+    {
+        Interrupt<engine>(INT_KEYBOARD, PL_KEYBOARD);
+    }
 }
 
-void CPU::Ldr(const uint16_t& instruction)
+void CPU::LatchKey()
 {
-    // xxxx xxx xxx xxxxxx
-    // inst DR  Reg  Off6
+    if (!(memory[MR_KBSR] & KBSR_READY) && Keyboard::HasKey())
+    {
+        memory[MR_KBDR] = Keyboard::PopKey();
+        memory[MR_KBSR] |= KBSR_READY;
+    }
+}
 
-    uint16_t destinationRegister = (instruction >> 9) & 0x7;
-    uint16_t baseRegister = (instruction >> 6) & 0x7;
+void CPU::RaiseEvent()
+{
+    {
+        // Any core may be polling the devices
+        std::lock_guard<std::mutex> lock(eventMutex);
+        for (uint16_t core = 0; core < coreCount; ++core)
+        {
+            interruptPending[core].store(true, std::memory_order_release);
+        }
+    }
 
-    uint16_t signExtendedOffset = ExtendSign((instruction) & 0b111111, 6);
+    eventArrived.notify_all();
+}
 
-    reg[destinationRegister] = ReadMemoryAt(reg[baseRegister] + signExtendedOffset);
+void CPU::SendInterrupt(uint16_t core)
+{
+    if (core >= coreCount)
+        return;
 
-    UpdateFlags(static_cast<REGISTER>(destinationRegister));
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        ipiPending[core].store(true, std::memory_order_release);
+        interruptPending[core].store(true, std::memory_order_release);
+    }
+
+    eventArrived.notify_all();
 }
 
-void CPU::Lea(const uint16_t& instruction) 
+void CPU::WaitForEvent(std::chrono::milliseconds timeout)
 {
-    // xxxx xxx xxxxxxxxx
-    // inst DR  PCOffset9
+    std::unique_lock<std::mutex> lock(eventMutex);
+    uint16_t core = coreId;
+    eventArrived.wait_for(lock, timeout, [core] { return interruptPending[core].load(std::memory_order_acquire); });
+}
 
-    uint16_t destinationRegister = (instruction >> 9) & 0x7;
-    uint16_t signExtendedOffset = ExtendSign(instruction & 0b111111111, 9);
+uint16_t CPU::CompareAndSwap(uint16_t value)
+{
+    // Sequentially consistent, so it also orders the relaxed loads and stores around it
+    uint16_t found = casExpected;
+    std::atomic_ref<uint16_t>(memory[casAddress]).compare_exchange_strong(found, value, std::memory_order_seq_cst);
 
-    reg[destinationRegister] = reg[R_PC] + signExtendedOffset;
+    if (found == casExpected && TranslationCache::plan[casAddress])
+        TranslationCache::Invalidate(casAddress);
 
-    UpdateFlags(static_cast<REGISTER>(destinationRegister));
+    return found;
 }
 
-void CPU::St(const uint16_t& instruction) 
+bool CPU::IsPollingLoop(uint16_t status)
 {
-    // xxxx xxx xxxxxxxxx
-    // inst SR  PCOffset9
+    // Matches a short backward BRz/BRp/BRzp right after the status load whose body only loads
+    // and computes, e.g. 'LOOP ADD R1, R1, #1; LDI R0, KBSR; BRzp LOOP', and that status takes
+    // back into the loop. Sleeping there is indistinguishable from the loop simply running slower.
+    uint16_t branch = LoadWord(reg[R_PC]);
+
+    if ((branch >> 12) != OP_BR || ((branch >> 11) & 1) || !((branch >> 9) & 0x3))
+        return false;
+
+    uint16_t flag = status == 0 ? FL_ZRO : (status >> 15) ? FL_NEG : FL_POS;
+    if (!((branch >> 9) & flag))
+        return false;
+
+    int16_t offset = static_cast<int16_t>(ExtendSign(branch & 0x1FF, 9));
+    if (offset > -2 || offset < -(MAX_POLL_LOOP + 1))
+        return false;
 
-    uint16_t sourceRegister = (instruction >> 9) & 0x7;
-    uint16_t signExtendedOffset = ExtendSign((instruction) & 0b111111111, 9);
+    for (uint16_t address = reg[R_PC] + 1 + offset; address != reg[R_PC]; ++address)
+    {
+        switch (LoadWord(address) >> 12)
+        {
+        case OP_ADD:
+        case OP_AND:
+        case OP_NOT:
+        case OP_LD:
+        case OP_LDI:
+        case OP_LDR:
+        case OP_LEA:
+            break;
+        default:
+            return false;
+        }
+    }
 
-    WriteMemoryAt(reg[R_PC] + signExtendedOffset, reg[sourceRegister]);
+    return true;
 }
 
-void CPU::Sti(const uint16_t& instruction)
+void CPU::HandleBadOpCode(const uint16_t& instruction) 
 {
-    // xxxx xxx xxxxxxxxx
-    // inst SR  PCOffset9
+    std::cout << "Bad Op Code: " << instruction << '\n';
+    //Do something!
+}
 
-    uint16_t sourceRegister = (instruction >> 9) & 0x7;
-    uint16_t signExtendedOffset = ExtendSign((instruction) & 0b111111111, 9);
+void CPU::ProcessWord()
+{
+    ++instructionCount;
 
-    WriteMemoryAt(ReadMemoryAt(reg[R_PC] + signExtendedOffset), reg[sourceRegister]);
+    Execute(ReadMemoryAt(reg[R_PC]++));
 }
 
-void CPU::Str(const uint16_t& instruction)
+void CPU::ProcessInstrumentedWord()
 {
-    // xxxx xxx xxx xxxxxx
-    // inst SR  BSR Off6
+    if (TimingModel::IsEnabled())
+        TimingModel::BeginStep();
+    if (TraceWriter::IsEnabled())
+        TraceWriter::BeginStep();
+    if (ReverseDebugger::IsEnabled())
+        ReverseDebugger::BeginStep();
+
+    ++instructionCount;
+
+    Execute<EN_INSTRUMENTED>(ReadMemoryAt(reg[R_PC]++));
+
+    if (TimingModel::IsEnabled())
+        TimingModel::EndStep();
+    if (TraceWriter::IsEnabled())
+        TraceWriter::EndStep();
+    if (ReverseDebugger::IsEnabled())
+        ReverseDebugger::EndStep();
+}
 
-    uint16_t sourceRegister = (instruction >> 9) & 0x7;
-    uint16_t baseRegister = (instruction >> 6) & 0x7;
-    uint16_t signExtendedOffset = ExtendSign((instruction) & 0b111111, 6);
+bool CPU::GetLoadAddress(uint16_t& address)
+{
+    uint16_t instr = memory[reg[R_PC]];
+    uint16_t nextPC = reg[R_PC] + 1;
 
-    WriteMemoryAt(reg[baseRegister] + signExtendedOffset, reg[sourceRegister]);
+    switch (instr >> 12)
+    {
+    case OP_LD:
+        address = nextPC + ExtendSign(instr & 0b111111111, 9);
+        return true;
+    case OP_LDI:
+    {
+        uint16_t pointer = nextPC + ExtendSign(instr & 0b111111111, 9);
+        if (pointer >= MR_KBSR)
+            return false;
+
+        address = memory[pointer];
+        return true;
+    }
+    case OP_LDR:
+        address = reg[(instr >> 6) & 0x7] + ExtendSign(instr & 0b111111, 6);
+        return true;
+    default:
+        return false;
+    }
 }
 
-void CPU::Trap(const uint16_t& instruction) 
+bool CPU::GetStoreAddress(uint16_t& address)
 {
-    reg[R_R7] = reg[R_PC];
+    uint16_t instr = memory[reg[R_PC]];
+    uint16_t nextPC = reg[R_PC] + 1;
 
-    switch (instruction & 0xFF)
+    switch (instr >> 12)
     {
-    case TRAP_GETC:
+    case OP_ST:
+        address = nextPC + ExtendSign(instr & 0b111111111, 9);
+        return true;
+    case OP_STI:
     {
-        char letter = std::getchar();
-        SetValueInRegister(R_R0, static_cast<uint16_t>(letter));
-        UpdateFlags(R_R0);
-        break;
+        uint16_t pointer = nextPC + ExtendSign(instr & 0b111111111, 9);
+        if (pointer >= MR_KBSR)
+            return false;
+
+        address = memory[pointer];
+        return true;
     }
-    case TRAP_HALT:
-    {
-        std::cout << "HALT" << '\n';
-        shouldBeRunning = false;
-        break;
+    case OP_STR:
+        address = reg[(instr >> 6) & 0x7] + ExtendSign(instr & 0b111111, 6);
+        return true;
+    default:
+        return false;
     }
-    case TRAP_IN:
+}
+
+void CPU::ProcessFusedWord()
+{
+    ++instructionCount;
+
+    uint16_t instr = ReadMemoryAt(reg[R_PC]++);
+    uint16_t next = LoadWord(reg[R_PC]);
+
+    // Sequences are matched at the current PC only, so a jump into the middle of one
+    // simply executes the remaining instructions one by one.
+    switch (instr >> 12)
     {
-        std::cout << "Input a character: ";
-        char letter = std::getchar();
-        SetValueInRegister(R_R0, static_cast<uint16_t>(letter) & 0xFF);
-        UpdateFlags(R_R0);
-        std::cout << std::flush;
-        break;
-    }
-    case TRAP_OUT:
+    case OP_ADD:
     {
-        char letter = GetValueInReg(R_R0) & 0xFF;
-        std::cout << letter << std::flush;
+        // ADD R, R, #imm; BR loop
+        if (((instr >> 5) & 1) && (next >> 12) == OP_BR)
+        {
+            Execute(instr);
+            ++reg[R_PC];
+            ++instructionCount;
+            Execute(next);
+            return;
+        }
         break;
     }
-    case TRAP_PUTS:
+    case OP_AND:
     {
-        uint16_t index = 0;
-        while (char letter = ReadMemoryAt(GetValueInReg(R_R0) + index) & 0xFF)
+        // AND R, R, #0; ADD R, R, #imm
+        uint16_t destinationRegister = (instr >> 9) & 0x7;
+        if ((instr & 0x3F) == 0x20 && (next >> 12) == OP_ADD && ((next >> 5) & 1)
+            && ((next >> 9) & 0x7) == destinationRegister && ((next >> 6) & 0x7) == destinationRegister)
         {
-            std::cout << letter;
-            ++index;
+            reg[destinationRegister] = DecodeTable::Get(next).operand;
+            UpdateFlags(static_cast<REGISTER>(destinationRegister));
+            ++reg[R_PC];
+            ++instructionCount;
+            return;
         }
-
-        std::cout << std::flush;
         break;
     }
-    case TRAP_PUTSP:
+    case OP_LDR:
     {
-        uint16_t index = 0;
-        
-        while (uint16_t letter = ReadMemoryAt(GetValueInReg(R_R0) + index))
+        // LDR R, B, #off; ADD R, R, #imm; STR R, B, #off
+        uint16_t valueRegister = (instr >> 9) & 0x7;
+        uint16_t baseRegister = (instr >> 6) & 0x7;
+        uint16_t third = LoadWord(reg[R_PC] + 1);
+        if ((next >> 12) == OP_ADD && ((next >> 5) & 1) && valueRegister != baseRegister
+            && ((next >> 9) & 0x7) == valueRegister && ((next >> 6) & 0x7) == valueRegister
+            && third == ((OP_STR << 12) | (instr & 0x0FFF)))
         {
-            char c1, c2;
-
-            c1 = letter >> 8; //High side
-            c2 = letter & 0xFF; // Low side
-            
-            std::cout << c2;
-
-            if (c1 == 0)
-                break;
-
-            std::cout << c1;
-
-            ++index;
+            uint16_t address = reg[baseRegister] + DecodeTable::Get(instr).operand;
+            if (address < MR_KBSR) // device registers keep their side effects
+            {
+                reg[valueRegister] = LoadWord(address) + DecodeTable::Get(next).operand;
+                StoreWord(address, reg[valueRegister]);
+                UpdateFlags(static_cast<REGISTER>(valueRegister));
+                reg[R_PC] += 2;
+                instructionCount += 2;
+                return;
+            }
         }
-        std::cout << std::flush;
-
         break;
     }
     default:
-        std::cout << "Error in execution of trap code: " << std::to_string(instruction & 0xFF) << " at line: " << std::to_string(reg[R_PC]) << ". Full instruction: " << std::to_string(instruction) << '\n';
         break;
     }
+
+    Execute(instr);
 }
 
-void CPU::Br(const uint16_t& instruction)
+void CPU::ProcessPlannedWord()
 {
-    // xxxx x x x xxxxxxxxx
-    // inst n z p PCOffset9
-    bool nInstructionFlagSet = (instruction >> 11) & 0x1;
-    bool zInstructionFlagSet = (instruction >> 10) & 0x1;
-    bool pInstructionFlagSet = (instruction >> 9) & 0x1;
+    ++instructionCount;
 
-    bool nRegisterSet = reg[R_COND] & FL_NEG;
-    bool zRegisterSet = reg[R_COND] & FL_ZRO;
-    bool pRegisterSet = reg[R_COND] & FL_POS;
+    uint16_t pc = reg[R_PC]++;
+    uint16_t instr = ReadMemoryAt(pc);
 
-    if ((nInstructionFlagSet && nRegisterSet) || (zInstructionFlagSet && zRegisterSet) || (pInstructionFlagSet && pRegisterSet)) 
+    // Same sequences as ProcessFusedWord, matched ahead of time. Stores into them have already
+    // removed them from the plan.
+    switch (TranslationCache::plan[pc] & TranslationCache::PL_KIND)
+    {
+    case TranslationCache::PL_ADD_BR:
     {
-        reg[R_PC] += ExtendSign(instruction & 0b111111111, 9);
+        Execute<EN_PLANNED>(instr);
+        ++instructionCount;
+        Execute<EN_PLANNED>(LoadWord(reg[R_PC]++));
+        return;
+    }
+    case TranslationCache::PL_CLEAR_ADD:
+    {
+        uint16_t destinationRegister = (instr >> 9) & 0x7;
+        reg[destinationRegister] = DecodeTable::Get(LoadWord(reg[R_PC])).operand;
+        UpdateFlags(static_cast<REGISTER>(destinationRegister));
+        ++reg[R_PC];
+        ++instructionCount;
+        return;
+    }
+    case TranslationCache::PL_INCREMENT:
+    {
+        const DecodedInstruction& load = DecodeTable::Get(instr);
+        uint16_t valueRegister = load.dr;
+        uint16_t address = reg[load.sr] + load.operand;
+        if (address < MR_KBSR) // device registers keep their side effects
+        {
+            reg[valueRegister] = LoadWord(address) + DecodeTable::Get(LoadWord(reg[R_PC])).operand;
+            StoreWord(address, reg[valueRegister]);
+            if (TranslationCache::plan[address])
+                TranslationCache::Invalidate(address);
+            UpdateFlags(static_cast<REGISTER>(valueRegister));
+            reg[R_PC] += 2;
+            instructionCount += 2;
+            return;
+        }
+        break;
+    }
+    default:
+        break;
     }
-}
-
-void CPU::SetValueInRegister(REGISTER regIndex, uint16_t value)
-{
-    CPU::reg[regIndex] = value;
-}
 
-void CPU::HandleBadOpCode(const uint16_t& instruction) 
-{
-    std::cout << "Bad Op Code: " << instruction << '\n';
-    //Do something!
+    Execute<EN_PLANNED>(instr);
 }
 
-void CPU::ProcessWord()
+template <CPU::ENGINE engine>
+void CPU::Execute(uint16_t instr)
 {
-    uint16_t instr = ReadMemoryAt(reg[R_PC]++);
-    uint16_t op = instr >> 12;
+    const DecodedInstruction& decoded = DecodeTable::Get(instr);
 
-    switch (op)
+    switch (instr >> 12)
     {
     case OP_ADD:
-        CPU::Add(instr);
+        if (decoded.handler == DecodeTable::H_ADD_IMM)
+            reg[decoded.dr] = reg[decoded.sr] + decoded.operand;
+        else
+            reg[decoded.dr] = reg[decoded.sr] + reg[decoded.operand];
+        UpdateFlags(static_cast<REGISTER>(decoded.dr));
         break;
     case OP_AND:
-        CPU::And(instr);
+        if (decoded.handler == DecodeTable::H_AND_IMM)
+            reg[decoded.dr] = reg[decoded.sr] & decoded.operand;
+        else
+            reg[decoded.dr] = reg[decoded.sr] & reg[decoded.operand];
+        UpdateFlags(static_cast<REGISTER>(decoded.dr));
         break;
     case OP_NOT:
-        CPU::Not(instr);
+        reg[decoded.dr] = ~reg[decoded.sr];
+        UpdateFlags(static_cast<REGISTER>(decoded.dr));
         break;
     case OP_BR:
-        CPU::Br(instr);
+        if (decoded.dr & GetConditionFlags())
+            reg[R_PC] += decoded.operand;
+        PollInterrupts<engine>();
         break;
     case OP_JMP:
-        CPU::Jmp(instr);
+        reg[R_PC] = reg[decoded.sr];
+        PollInterrupts<engine>();
         break;
     case OP_JSR:
-        CPU::Jsr(instr);
+        reg[R_R7] = reg[R_PC];
+        if (decoded.handler == DecodeTable::H_JSR)
+            reg[R_PC] += decoded.operand;
+        else
+            reg[R_PC] = reg[decoded.sr];
+        PollInterrupts<engine>();
         break;
     case OP_LD:
-        CPU::Ld(instr);
+        reg[decoded.dr] = ReadMemoryAt<engine>(reg[R_PC] + decoded.operand);
+        UpdateFlags(static_cast<REGISTER>(decoded.dr));
         break;
     case OP_LDI:
-        CPU::Ldi(instr);
+        reg[decoded.dr] = ReadMemoryAt<engine>(ReadMemoryAt<engine>(reg[R_PC] + decoded.operand));
+        UpdateFlags(static_cast<REGISTER>(decoded.dr));
         break;
     case OP_LDR:
-        CPU::Ldr(instr);
+        reg[decoded.dr] = ReadMemoryAt<engine>(reg[decoded.sr] + decoded.operand);
+        UpdateFlags(static_cast<REGISTER>(decoded.dr));
         break;
     case OP_LEA:
-        CPU::Lea(instr);
+        reg[decoded.dr] = reg[R_PC] + decoded.operand;
+        UpdateFlags(static_cast<REGISTER>(decoded.dr));
         break;
     case OP_ST:
-        CPU::St(instr);
+        WriteMemoryAt<engine>(reg[R_PC] + decoded.operand, reg[decoded.dr]);
         break;
     case OP_STI:
-        CPU::Sti(instr);
+        WriteMemoryAt<engine>(ReadMemoryAt<engine>(reg[R_PC] + decoded.operand), reg[decoded.dr]);
         break;
     case OP_STR:
-        CPU::Str(instr);
+        WriteMemoryAt<engine>(reg[decoded.sr] + decoded.operand, reg[decoded.dr]);
         break;
     case OP_TRAP:
-        CPU::Trap(instr);
+        Trap<engine>(instr);
+        PollInterrupts<engine>();
         break;
     case OP_RES:
         CPU::HandleBadOpCode(instr);
         break;
     case OP_RTI:
-        CPU::HandleBadOpCode(instr);
+        Rti<engine>(instr);
+        PollInterrupts<engine>();
         break;
     default:
         CPU::HandleBadOpCode(instr);
         break;
     }
 }
+
+// The interpreter fallback of LC3_AOT traps and services interrupts from outside this file
+template void CPU::Trap<CPU::EN_PLAIN>(const uint16_t& instruction);
+
+template void CPU::ServiceInterrupts<CPU::EN_PLAIN>();
@@ -1,15 +1,40 @@
 #pragma once
 #include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 #define MEM_MAX (1 << 16)
 
-class CPU
+// One instance per core. Registers, condition codes, PSR and stack pointers are members, memory and
+// the devices are shared by all instances. Single-core tools work on cores[0].
+class alignas(64) CPU
 {
 
 public:
     enum 
     {
         MR_KBSR = 0xFE00, /* keyboard status */
-        MR_KBDR = 0xFE02  /* keyboard data */
+        MR_KBDR = 0xFE02, /* keyboard data */
+        MR_DSR = 0xFE04,  /* display status */
+        MR_DDR = 0xFE06,  /* display data */
+        MR_TSR = 0xFE08,  /* timer status */
+        MR_TMR = 0xFE0A,  /* timer interval in milliseconds, 0 stops the timer */
+        MR_BANK = 0xFE10, /* bank registers, the frame of page n is at MR_BANK + n */
+        MR_CID = 0xFE20,  /* number of the core reading it */
+        MR_CCNT = 0xFE22, /* number of cores */
+        MR_IPI = 0xFE24,  /* writing a core number raises an inter-processor interrupt on that core */
+        MR_CASA = 0xFE26, /* compare-and-swap address */
+        MR_CASE = 0xFE28, /* compare-and-swap expected value */
+        MR_CASX = 0xFE2A, /* writing a value swaps it into MR_CASA if that holds MR_CASE, reading returns what the last swap found */
+        MR_CHANNEL = 0xFE40, /* channel registers, status of channel n at MR_CHANNEL + 4 * n, its data right after */
+        MR_MCR = 0xFFFE   /* machine control */
+    };
+
+    enum TRAP_MODE
+    {
+        TM_NATIVE = 0, /* trap routines are executed by the VM itself */
+        TM_OS          /* trap routines are executed by a loaded OS image through the trap vector table */
     };
 
     enum
@@ -62,57 +87,190 @@ public:
         FL_POS = 1 << 0, /* P */
         FL_ZRO = 1 << 1, /* Z */
         FL_NEG = 1 << 2, /* N */
+        NO_CONDITION_CODES = 0x10000 /* lastResult after a PSR with n/z/p all clear was loaded */
     };
 
-    static uint16_t ReadMemoryAt(uint16_t address);
+    enum
+    {
+        PSR_USER = 1 << 15,         /* privilege bit, set while running in user mode */
+        PSR_PRIORITY_SHIFT = 8,     /* priority level lives in bits 10-8 */
+        KBSR_READY = 1 << 15,       /* a key is latched in KBDR */
+        KBSR_INTERRUPT = 1 << 14,   /* keyboard interrupt enable */
+        TSR_READY = 1 << 15,        /* the timer expired since TSR was last read */
+        TSR_INTERRUPT = 1 << 14,    /* timer interrupt enable */
+        MAX_POLL_LOOP = 8           /* longest loop body treated as a device polling loop */
+    };
 
-    static void WriteMemoryAt(uint16_t address, uint16_t value);
+    enum
+    {
+        INT_PRIVILEGE = 0x00, /* RTI executed in user mode */
+        INT_KEYBOARD = 0x80,  /* keyboard interrupt vector */
+        INT_TIMER = 0x81,     /* timer interrupt vector */
+        INT_IPI = 0x82,       /* inter-processor interrupt vector */
+        INT_TABLE = 0x0100,   /* interrupt vector table base */
+        PL_KEYBOARD = 4,      /* keyboard interrupt priority */
+        PL_TIMER = 5,         /* timer interrupt priority */
+        PL_IPI = 6            /* inter-processor interrupt priority */
+    };
 
-    static void UpdateFlags(REGISTER regIndex);
+    enum
+    {
+        MAX_CORES = 8,
+        SSP_STRIDE = 0x0100   /* core n starts with its supervisor stack at x3000 - n * SSP_STRIDE */
+    };
+
+    // What the loop executing an instruction needs to hear about its memory accesses. The functions
+    // taking it are compiled once per engine, so the plain loops pay for none of it.
+    enum ENGINE
+    {
+        EN_PLAIN = 0,   /* ProcessWord and ProcessFusedWord */
+        EN_PLANNED,     /* ProcessPlannedWord, stores also drop the TranslationCache plan of the word they overwrite */
+        EN_INSTRUMENTED /* ProcessInstrumentedWord, loads and stores are also checked against the debugger's watchpoints */
+    };
 
-    static void ProcessProgram();
+    template <ENGINE engine = EN_PLAIN>
+    uint16_t ReadMemoryAt(uint16_t address);
 
-    static void Add(const uint16_t& instruction);
+    template <ENGINE engine = EN_PLAIN>
+    void WriteMemoryAt(uint16_t address, uint16_t value);
+
+    uint16_t ReadDeviceAt(uint16_t address);
+
+    void WriteDeviceAt(uint16_t address, uint16_t value);
+
+    // Condition codes are evaluated lazily: only the last result is recorded here and N/Z/P
+    // are derived from it when a BR or a PSR read needs them.
+    void UpdateFlags(REGISTER regIndex)
+    {
+        lastResult = reg[regIndex];
+    }
 
-    static void And(const uint16_t& instruction);
+    uint16_t GetConditionFlags()
+    {
+        // Indexed by the sign bit, or 2 for NO_CONDITION_CODES
+        static constexpr uint16_t nonZeroFlags[3] = { FL_POS, FL_NEG, 0 };
 
-    static void Not(const uint16_t& instruction);
+        if (lastResult == 0)
+            return FL_ZRO;
 
-    static void Jmp(const uint16_t& instruction);
+        return nonZeroFlags[lastResult >> 15];
+    }
 
-    static void Jsr(const uint16_t& instruction);
+    // A PSR loaded with more than one of n/z/p set keeps only the first of N, P, Z, since a
+    // result has exactly one sign. None set stays none, so no BR is taken until the next result.
+    void SetConditionFlags(uint16_t flags)
+    {
+        if (flags & FL_NEG)
+            lastResult = 0x8000;
+        else if (flags & FL_POS)
+            lastResult = 1;
+        else if (flags & FL_ZRO)
+            lastResult = 0;
+        else
+            lastResult = NO_CONDITION_CODES;
+    }
 
-    static void Br(const uint16_t& instruction);
+    void ProcessProgram();
 
-    static void Ld(const uint16_t& instruction);
+    // The loop of ProcessProgram without its initialisation, so a stopped program can be resumed
+    void Run();
 
-    static void Ldi(const uint16_t& instruction);
-    
-    static void Ldr(const uint16_t& instruction);
+    // Clears memory and the architectural state of all cores. Trap mode and fusion settings are kept.
+    static void Reset();
 
-    static void Lea(const uint16_t& instruction);
-    
-    static void St(const uint16_t& instruction);
+    template <ENGINE engine = EN_PLAIN>
+    void Trap(const uint16_t& instruction);
 
-    static void Sti(const uint16_t& instruction);
+    template <ENGINE engine = EN_PLAIN>
+    void TrapNative(const uint16_t& instruction);
 
-    static void Str(const uint16_t& instruction);
-    
-    static void Trap(const uint16_t& instruction);
+    template <ENGINE engine = EN_PLAIN>
+    void Rti(const uint16_t& instruction);
 
     static void HandleBadOpCode(const uint16_t& instruction);
 
-    static uint16_t GetValueInReg(REGISTER regIndex) 
+    uint16_t GetValueInReg(REGISTER regIndex) 
     {
+        if (regIndex == R_COND)
+            return GetConditionFlags();
+
         return reg[regIndex];
     }
 
-    static bool shouldBeRunning;
+    // HALT stops only the core executing it
+    bool shouldBeRunning = false;
+
+    // Set by devices and other cores whenever a core may need service, one flag per core. Tested
+    // only at block boundaries.
+    static std::atomic<bool> interruptPending[MAX_CORES];
+
+    template <ENGINE engine = EN_PLAIN>
+    void PollInterrupts()
+    {
+        if (interruptPending[coreId].load(std::memory_order_relaxed))
+            ServiceInterrupts<engine>();
+    }
+
+    template <ENGINE engine = EN_PLAIN>
+    void ServiceInterrupts();
+
+    template <ENGINE engine = EN_PLAIN>
+    void Interrupt(uint16_t vector, uint16_t priority);
+
+    uint16_t GetPSR()
+    {
+        return psr | GetConditionFlags();
+    }
+
+    void SetPSR(uint16_t value)
+    {
+        psr = value & (PSR_USER | (0x7 << PSR_PRIORITY_SHIFT));
+        SetConditionFlags(value & 0x7);
+    }
+
+    uint16_t GetPriority()
+    {
+        return (psr >> PSR_PRIORITY_SHIFT) & 0x7;
+    }
+
+    // Returns 0xFFFE without consuming a key when cancel becomes true while waiting
+    uint16_t ReadKey(const std::atomic<bool>* cancel = nullptr);
+
+    static void LatchKey();
+
+    // Wakes cores sleeping in WaitForEvent and makes them service devices at the next block boundary
+    static void RaiseEvent();
+
+    // Raises an inter-processor interrupt on core, as a write to MR_IPI does
+    static void SendInterrupt(uint16_t core);
+
+    void WaitForEvent(std::chrono::milliseconds timeout);
+
+    // True if the instructions around the PC spin on a status load until it changes from status
+    bool IsPollingLoop(uint16_t status);
+
+    uint16_t savedSSP = 0x3000;
+
+    uint16_t savedUSP = 0;
 
-    static void SetValueInRegister(REGISTER regIndex, uint16_t value);
+    static TRAP_MODE trapMode;
 
+    uint64_t instructionCount = 0;
 
-    static uint16_t ExtendSign(const uint16_t& value, const int& bitCount)
+    // Index of this instance in cores
+    uint16_t coreId = 0;
+
+    static uint16_t coreCount;
+
+    // Set while Multiprocessor runs the cores in turns on one thread, where a core must not sleep
+    static bool lockstep;
+
+    static CPU cores[MAX_CORES];
+
+    void SetValueInRegister(REGISTER regIndex, uint16_t value);
+
+
+    static constexpr uint16_t ExtendSign(const uint16_t& value, const int& bitCount)
     {
         uint16_t valueCopy = value;
         if (valueCopy >> (bitCount - 1)) 
@@ -122,10 +280,76 @@ public:
         return valueCopy;
     }
 
-    static void ProcessWord();
+    void ProcessWord();
+
+    // Same as ProcessWord, but executes common instruction pairs and triples as one step
+    void ProcessFusedWord();
+
+    // Same as ProcessFusedWord, with the sequences taken from the TranslationCache plan
+    void ProcessPlannedWord();
+
+    // Executes one fetched instruction, the PC already past it. The only implementation of the
+    // instructions; the fused and planned loops call it for everything they do not combine.
+    template <ENGINE engine = EN_PLAIN>
+    void Execute(uint16_t instr);
 
-    static uint16_t reg[R_COUNT];
+    // ProcessWord with the enabled timing, trace, history and debugger hooks around it
+    void ProcessInstrumentedWord();
 
+    // Decodes the instruction at PC and reports the address it is going to load from, without
+    // executing it. Returns false for anything but LD/LDI/LDR and for an LDI whose pointer is a device register.
+    bool GetLoadAddress(uint16_t& address);
+
+    // Same for the address ST/STI/STR is going to store to
+    bool GetStoreAddress(uint16_t& address);
+
+    // Set by -fusion. Run uses ProcessWord unless it is on.
+    static bool fusionEnabled;
+
+    uint16_t reg[R_COUNT] = {};
+
+    // Value the condition codes are derived from, or NO_CONDITION_CODES. reg[R_COND] is not kept up to date.
+    uint32_t lastResult = 0;
+
+    // Privilege and priority bits of the PSR. Condition codes come from lastResult.
+    uint16_t psr = PSR_USER;
+
+    // Shared by all cores. While cores run on several threads the engine only goes through
+    // LoadWord and StoreWord.
     static uint16_t memory[MEM_MAX];
 
+    // Relaxed atomic accesses: a plain 16-bit move on the host, but never a data race with another
+    // core's access or compare-and-swap
+    static uint16_t LoadWord(uint16_t address)
+    {
+        return std::atomic_ref<uint16_t>(memory[address]).load(std::memory_order_relaxed);
+    }
+
+    static void StoreWord(uint16_t address, uint16_t value)
+    {
+        std::atomic_ref<uint16_t>(memory[address]).store(value, std::memory_order_relaxed);
+    }
+
+private:
+    // Reports a load or store of the guest to the debugger when engine is EN_INSTRUMENTED
+    template <ENGINE engine>
+    static void NoteRead(uint16_t address, uint16_t value);
+
+    template <ENGINE engine>
+    static void NoteWrite(uint16_t address, uint16_t value);
+
+    uint16_t CompareAndSwap(uint16_t value);
+
+    // A read of a channel register; a core polling a channel that is not ready yields its thread,
+    // unless the cores share one in lockstep
+    uint16_t ReadChannel(uint16_t channel, bool data);
+
+    static std::atomic<bool> ipiPending[MAX_CORES];
+
+    // Operands of the compare-and-swap registers, per core so cores cannot disturb each other's setup
+    uint16_t casAddress = 0;
+
+    uint16_t casExpected = 0;
+
+    uint16_t casResult = 0;
 };
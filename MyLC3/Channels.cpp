@@ -0,0 +1,70 @@
+#include "Channels.h"
+
+Channels::Ring Channels::rings[CHANNEL_COUNT];
+
+uint16_t Channels::GetStatus(uint16_t channel)
+{
+    Ring& ring = rings[channel];
+    uint32_t head = ring.head.load(std::memory_order_acquire);
+    uint32_t tail = ring.tail.load(std::memory_order_acquire);
+
+    return (tail != head ? CS_DATA : 0) | (tail - head < CAPACITY ? CS_ROOM : 0);
+}
+
+uint16_t Channels::Receive(uint16_t channel)
+{
+    Ring& ring = rings[channel];
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+
+    if (head == ring.knownTail)
+    {
+        ring.knownTail = ring.tail.load(std::memory_order_acquire);
+        if (head == ring.knownTail)
+            return 0;
+    }
+
+    uint16_t value = ring.words[head & (CAPACITY - 1)];
+    ring.head.store(head + 1, std::memory_order_release);
+    return value;
+}
+
+void Channels::Send(uint16_t channel, uint16_t value, uint16_t core)
+{
+    Ring& ring = rings[channel];
+    uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+
+    if (ring.producer.load(std::memory_order_relaxed) != core)
+        ring.producer.store(core, std::memory_order_relaxed);
+
+    if (tail - ring.knownHead >= CAPACITY)
+    {
+        ring.knownHead = ring.head.load(std::memory_order_acquire);
+        if (tail - ring.knownHead >= CAPACITY)
+            return;
+    }
+
+    ring.words[tail & (CAPACITY - 1)] = value;
+    ring.tail.store(tail + 1, std::memory_order_release);
+}
+
+void Channels::Reset()
+{
+    for (Ring& ring : rings)
+    {
+        ring.head.store(0, std::memory_order_relaxed);
+        ring.tail.store(0, std::memory_order_relaxed);
+        ring.knownHead = 0;
+        ring.knownTail = 0;
+        ring.producer.store(0xFFFF, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Channels::GetTransferCount()
+{
+    uint64_t count = 0;
+    for (const Ring& ring : rings)
+    {
+        count += ring.head.load(std::memory_order_relaxed);
+    }
+    return count;
+}
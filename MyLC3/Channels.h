@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Word channels between cores, so programs can be chained into producer/consumer pipelines without
+// going through the host. Channel n has a status register at CPU::MR_CHANNEL + 4 * n and a data
+// register right after it. Status bit 15 is set while a word is waiting, bit 14 while there is room
+// for another one. Reading the data register takes the oldest word (0 if there is none), writing it
+// appends a word (dropped if there is no room).
+//
+// Every channel is a lock-free ring with one producer and one consumer core: the producer owns the
+// tail index, the consumer the head index, each on a cache line of its own, and each side keeps a
+// copy of the other's index and only reloads it when the ring looks full or empty. A word costs
+// one release store per side, so a pipeline runs at interpreter speed.
+class Channels
+{
+public:
+    enum
+    {
+        CHANNEL_COUNT = 8,
+        CAPACITY = 1024,      /* words per channel, a power of two */
+        CS_DATA = 1 << 15,    /* status: a word can be read */
+        CS_ROOM = 1 << 14     /* status: a word can be written */
+    };
+
+    static uint16_t GetStatus(uint16_t channel);
+
+    static uint16_t Receive(uint16_t channel);
+
+    static void Send(uint16_t channel, uint16_t value, uint16_t core);
+
+    // Whether core last wrote to the channel, i.e. is the one waiting when it is full
+    static bool IsProducer(uint16_t channel, uint16_t core)
+    {
+        return rings[channel].producer.load(std::memory_order_relaxed) == core;
+    }
+
+    // Empties all channels. Only while no core is running.
+    static void Reset();
+
+    // Words received through all channels since the last Reset
+    static uint64_t GetTransferCount();
+
+private:
+    struct Ring
+    {
+        alignas(64) std::atomic<uint32_t> head{0}; /* next word to read, written by the consumer */
+        uint32_t knownTail = 0;                    /* consumer's copy of tail */
+        alignas(64) std::atomic<uint32_t> tail{0}; /* next free slot, written by the producer */
+        uint32_t knownHead = 0;                    /* producer's copy of head */
+        std::atomic<uint16_t> producer{0xFFFF};    /* core that last wrote, on the producer's line */
+        alignas(64) uint16_t words[CAPACITY];
+    };
+
+    static Ring rings[CHANNEL_COUNT];
+};
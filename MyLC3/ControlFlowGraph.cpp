@@ -0,0 +1,461 @@
+#include "ControlFlowGraph.h"
+#include "CPU.h"
+#include "ObjectFormat.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+static uint16_t Offset(uint16_t instruction, int bitCount)
+{
+    return CPU::ExtendSign(instruction & ((1 << bitCount) - 1), bitCount);
+}
+
+static std::string Describe(uint16_t address, const ObjectImage& debugInfo)
+{
+    char text[8];
+    std::snprintf(text, sizeof(text), "x%04X", address);
+
+    std::string label = ObjectFormat::Locate(debugInfo, address);
+    return label.empty() ? text : std::string(text) + " <" + label + ">";
+}
+
+bool ControlFlowGraph::EndsBlock(uint16_t instruction)
+{
+    switch (instruction >> 12)
+    {
+    case CPU::OP_BR:
+        return (instruction >> 9) & 0x7;
+    case CPU::OP_JMP:
+    case CPU::OP_JSR:
+    case CPU::OP_TRAP:
+    case CPU::OP_RTI:
+    case CPU::OP_RES:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char* ControlFlowGraph::GetExitName(EXIT exit)
+{
+    static const char* names[] = { "fallthrough", "branch", "jump", "computed", "call", "return", "trap", "halt", "rti", "invalid" };
+    return names[exit];
+}
+
+void ControlFlowGraph::Analyze(const uint16_t* image, uint16_t entryPoint)
+{
+    Analyze(image, std::vector<uint16_t>{ entryPoint });
+}
+
+void ControlFlowGraph::Analyze(const uint16_t* image, const std::vector<uint16_t>& entries)
+{
+    memory = image;
+    entry = entries.empty() ? 0 : entries[0];
+    kinds.assign(MEM_MAX, WK_UNKNOWN);
+    blockStart.assign(MEM_MAX, false);
+    referenced.assign(MEM_MAX, false);
+    pending.clear();
+    functionEntries.clear();
+    handlers.clear();
+    resolved.clear();
+
+    for (uint16_t root : entries)
+        AddRoot(root, true, false);
+
+    while (!pending.empty())
+    {
+        uint16_t address = pending.back();
+        pending.pop_back();
+        Walk(address);
+    }
+
+    for (uint32_t address = 0; address < MEM_MAX; ++address)
+    {
+        if (referenced[address] && kinds[address] != WK_CODE)
+            kinds[address] = WK_DATA;
+    }
+
+    std::sort(resolved.begin(), resolved.end());
+
+    BuildBlocks();
+    BuildFunctions();
+}
+
+void ControlFlowGraph::AddRoot(uint16_t address, bool isFunction, bool isHandler)
+{
+    if (address >= CPU::MR_KBSR)
+        return;
+
+    if (isFunction && std::find(functionEntries.begin(), functionEntries.end(), address) == functionEntries.end())
+        functionEntries.push_back(address);
+
+    if (isHandler && std::find(handlers.begin(), handlers.end(), address) == handlers.end())
+        handlers.push_back(address);
+
+    blockStart[address] = true;
+    pending.push_back(address);
+}
+
+void ControlFlowGraph::Walk(uint16_t address)
+{
+    // Register constants are carried along one straight-line path only
+    Constants constants;
+
+    for (; kinds[address] != WK_CODE; ++address)
+    {
+        kinds[address] = WK_CODE;
+
+        uint16_t instruction = memory[address];
+        uint16_t next = address + 1;
+        uint16_t op = instruction >> 12;
+        uint16_t target = next + Offset(instruction, 9);
+        uint16_t source = (instruction >> 9) & 0x7;
+        uint16_t base = (instruction >> 6) & 0x7;
+        bool storeKnown = false;
+        uint16_t storeAddress = 0;
+
+        switch (op)
+        {
+        case CPU::OP_LD:
+        case CPU::OP_LEA:
+            referenced[target] = true;
+            break;
+        case CPU::OP_ST:
+            referenced[target] = true;
+            storeKnown = true;
+            storeAddress = target;
+            break;
+        case CPU::OP_LDI:
+        case CPU::OP_STI:
+            referenced[target] = true;
+            if (target < CPU::MR_KBSR && memory[target] < CPU::MR_KBSR)
+            {
+                referenced[memory[target]] = true;
+                storeKnown = op == CPU::OP_STI;
+                storeAddress = memory[target];
+            }
+            break;
+        case CPU::OP_STR:
+            storeKnown = (constants.known >> base) & 1;
+            storeAddress = constants.value[base] + Offset(instruction, 6);
+            break;
+        default:
+            break;
+        }
+
+        // Installing a constant address into a vector table, e.g. 'LEA R0, ISR; STI R0, KBD_VECTOR'
+        if (storeKnown && storeAddress < VECTOR_TABLE_END && ((constants.known >> source) & 1))
+            AddRoot(constants.value[source], true, true);
+
+        if (!EndsBlock(instruction))
+        {
+            Track(address, constants);
+
+            if (next >= CPU::MR_KBSR)
+                return;
+            continue;
+        }
+
+        switch (op)
+        {
+        case CPU::OP_BR:
+            AddRoot(target, false, false);
+            if (((instruction >> 9) & 0x7) != 0x7)
+                AddRoot(next, false, false);
+            break;
+        case CPU::OP_JSR:
+            if ((instruction >> 11) & 1)
+            {
+                AddRoot(next + Offset(instruction, 11), true, false);
+            }
+            else if ((constants.known >> base) & 1)
+            {
+                resolved.push_back({ address, constants.value[base] });
+                AddRoot(constants.value[base], true, false);
+            }
+            AddRoot(next, false, false);
+            break;
+        case CPU::OP_JMP:
+            if (base != CPU::R_R7 && ((constants.known >> base) & 1))
+            {
+                resolved.push_back({ address, constants.value[base] });
+                AddRoot(constants.value[base], false, false);
+            }
+            break;
+        case CPU::OP_TRAP:
+            if ((instruction & 0xFF) != CPU::TRAP_HALT)
+                AddRoot(next, false, false);
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+}
+
+void ControlFlowGraph::Track(uint16_t address, Constants& constants)
+{
+    uint16_t instruction = memory[address];
+    uint16_t destination = (instruction >> 9) & 0x7;
+    uint16_t first = (instruction >> 6) & 0x7;
+    uint16_t second = instruction & 0x7;
+    bool immediate = (instruction >> 5) & 1;
+    bool known = false;
+    uint16_t value = 0;
+
+    auto isKnown = [&](uint16_t index) { return (constants.known >> index) & 1; };
+
+    switch (instruction >> 12)
+    {
+    case CPU::OP_LEA:
+        known = true;
+        value = address + 1 + Offset(instruction, 9);
+        break;
+    case CPU::OP_LD:
+    {
+        uint16_t source = address + 1 + Offset(instruction, 9);
+        known = source < CPU::MR_KBSR;
+        value = memory[source];
+        break;
+    }
+    case CPU::OP_ADD:
+    case CPU::OP_AND:
+    {
+        known = isKnown(first) && (immediate || isKnown(second));
+        uint16_t operand = immediate ? Offset(instruction, 5) : constants.value[second];
+        value = (instruction >> 12) == CPU::OP_ADD ? constants.value[first] + operand : constants.value[first] & operand;
+
+        // AND R, R, #0 clears a register whatever it held
+        if ((instruction >> 12) == CPU::OP_AND && immediate && !(instruction & 0x1F))
+        {
+            known = true;
+            value = 0;
+        }
+        break;
+    }
+    case CPU::OP_NOT:
+        known = isKnown(first);
+        value = ~constants.value[first];
+        break;
+    case CPU::OP_LDR:
+    case CPU::OP_LDI:
+        break;
+    default:
+        return;
+    }
+
+    constants.value[destination] = value;
+    constants.known = known ? constants.known | (1 << destination) : constants.known & ~(1 << destination);
+}
+
+void ControlFlowGraph::BuildBlocks()
+{
+    blocks.clear();
+
+    bool open = false;
+    for (uint32_t address = 0; address < MEM_MAX; ++address)
+    {
+        if (kinds[address] != WK_CODE)
+        {
+            open = false;
+            continue;
+        }
+
+        if (!open || blockStart[address] || blocks.back().length == MAX_BLOCK)
+        {
+            blockStart[address] = true;
+            blocks.push_back(BasicBlock());
+            blocks.back().start = static_cast<uint16_t>(address);
+        }
+
+        ++blocks.back().length;
+        open = !EndsBlock(memory[address]);
+    }
+
+    for (BasicBlock& block : blocks)
+    {
+        uint16_t last = block.start + block.length - 1;
+        uint16_t instruction = memory[last];
+        uint16_t next = last + 1;
+        uint16_t target = next + Offset(instruction, 9);
+
+        auto resolvedTarget = std::lower_bound(resolved.begin(), resolved.end(), std::make_pair(last, uint16_t(0)));
+        bool isResolved = resolvedTarget != resolved.end() && resolvedTarget->first == last;
+
+        switch (instruction >> 12)
+        {
+        case CPU::OP_BR:
+        {
+            uint16_t condition = (instruction >> 9) & 0x7;
+            if (condition == 0x7)
+            {
+                block.exit = EX_JUMP;
+                block.successors = { target };
+            }
+            else if (condition)
+            {
+                block.exit = EX_BRANCH;
+                block.successors = { target, next };
+            }
+            else
+            {
+                block.exit = EX_FALLTHROUGH;
+            }
+            break;
+        }
+        case CPU::OP_JSR:
+            block.exit = EX_CALL;
+            block.successors = { next };
+            if ((instruction >> 11) & 1)
+                block.callees = { static_cast<uint16_t>(next + Offset(instruction, 11)) };
+            else if (isResolved)
+                block.callees = { resolvedTarget->second };
+            break;
+        case CPU::OP_JMP:
+            if (((instruction >> 6) & 0x7) == CPU::R_R7)
+            {
+                block.exit = EX_RETURN;
+            }
+            else if (isResolved)
+            {
+                block.exit = EX_JUMP;
+                block.successors = { resolvedTarget->second };
+            }
+            else
+            {
+                block.exit = EX_COMPUTED;
+            }
+            break;
+        case CPU::OP_TRAP:
+            block.exit = (instruction & 0xFF) == CPU::TRAP_HALT ? EX_HALT : EX_TRAP;
+            if (block.exit == EX_TRAP)
+                block.successors = { next };
+            break;
+        case CPU::OP_RTI:
+            block.exit = EX_RTI;
+            break;
+        case CPU::OP_RES:
+            block.exit = EX_INVALID;
+            break;
+        default:
+            block.exit = EX_FALLTHROUGH;
+            break;
+        }
+
+        if (block.exit == EX_FALLTHROUGH)
+        {
+            if (next < CPU::MR_KBSR && kinds[next] == WK_CODE)
+                block.successors = { next };
+            else
+                block.exit = EX_INVALID;
+        }
+
+        // Successors outside the address space the walk covers, e.g. device registers, are dropped
+        block.successors.erase(std::remove_if(block.successors.begin(), block.successors.end(),
+            [this](uint16_t address) { return !blockStart[address]; }), block.successors.end());
+    }
+}
+
+void ControlFlowGraph::BuildFunctions()
+{
+    functions.clear();
+    std::sort(functionEntries.begin(), functionEntries.end());
+
+    std::vector<uint32_t> visited(blocks.size(), 0);
+    std::vector<size_t> stack;
+
+    for (uint16_t functionEntry : functionEntries)
+    {
+        FunctionInfo function;
+        function.entry = functionEntry;
+        function.isHandler = std::find(handlers.begin(), handlers.end(), functionEntry) != handlers.end();
+
+        // Calls are followed to their return point only, so a function owns its own blocks
+        uint32_t mark = static_cast<uint32_t>(functions.size() + 1);
+        const BasicBlock* first = FindBlock(functionEntry);
+        if (first)
+        {
+            stack.push_back(first - blocks.data());
+            visited[stack.back()] = mark;
+        }
+
+        while (!stack.empty())
+        {
+            const BasicBlock& block = blocks[stack.back()];
+            stack.pop_back();
+
+            function.blocks.push_back(block.start);
+            for (uint16_t callee : block.callees)
+            {
+                if (std::find(function.callees.begin(), function.callees.end(), callee) == function.callees.end())
+                    function.callees.push_back(callee);
+            }
+
+            for (uint16_t successor : block.successors)
+            {
+                size_t index = FindBlock(successor) - blocks.data();
+                if (visited[index] != mark)
+                {
+                    visited[index] = mark;
+                    stack.push_back(index);
+                }
+            }
+        }
+
+        std::sort(function.blocks.begin(), function.blocks.end());
+        std::sort(function.callees.begin(), function.callees.end());
+        functions.push_back(std::move(function));
+    }
+}
+
+const BasicBlock* ControlFlowGraph::FindBlock(uint16_t address) const
+{
+    if (kinds.empty() || kinds[address] != WK_CODE)
+        return nullptr;
+
+    auto next = std::upper_bound(blocks.begin(), blocks.end(), address,
+        [](uint16_t value, const BasicBlock& block) { return value < block.start; });
+
+    return next == blocks.begin() ? nullptr : &*(next - 1);
+}
+
+void ControlFlowGraph::Print(std::ostream& out, const ObjectImage& debugInfo) const
+{
+    size_t counts[3] = {};
+    size_t unknownWords = 0;
+    for (uint32_t address = 0; address < MEM_MAX; ++address)
+    {
+        ++counts[kinds[address]];
+        if (kinds[address] == WK_UNKNOWN && memory[address])
+            ++unknownWords;
+    }
+
+    out << functions.size() << " functions, " << blocks.size() << " blocks, " << counts[WK_CODE] << " code words, "
+        << counts[WK_DATA] << " data words, " << unknownWords << " other non-zero words" << '\n';
+
+    for (const FunctionInfo& function : functions)
+    {
+        out << '\n' << (function.isHandler ? "handler " : "function ") << Describe(function.entry, debugInfo);
+        if (!function.callees.empty())
+        {
+            out << " calls";
+            for (uint16_t callee : function.callees)
+                out << ' ' << Describe(callee, debugInfo);
+        }
+        out << '\n';
+
+        for (uint16_t start : function.blocks)
+        {
+            const BasicBlock& block = *FindBlock(start);
+            out << "  " << Describe(block.start, debugInfo) << "  " << block.length << " instructions, "
+                << GetExitName(static_cast<EXIT>(block.exit));
+
+            for (uint16_t callee : block.callees)
+                out << " [" << Describe(callee, debugInfo) << "]";
+
+            for (uint16_t successor : block.successors)
+                out << ' ' << Describe(successor, debugInfo);
+            out << '\n';
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct ObjectImage;
+
+struct BasicBlock
+{
+    uint16_t start = 0;
+    uint16_t length = 0;                /* instructions */
+    uint8_t exit = 0;                   /* ControlFlowGraph::EXIT */
+    std::vector<uint16_t> successors;   /* blocks control can continue in, including the return point of a call or trap */
+    std::vector<uint16_t> callees;      /* known targets of a JSR or JSRR */
+};
+
+struct FunctionInfo
+{
+    uint16_t entry = 0;
+    bool isHandler = false;             /* installed into the trap or interrupt vector table */
+    std::vector<uint16_t> blocks;       /* start addresses, a tail shared by two functions is listed in both */
+    std::vector<uint16_t> callees;
+};
+
+// Recovers code from a loaded image by following control flow from the entry point. The result is a
+// set of basic blocks with their successors, the functions and their call graph, and a map telling
+// code from data for every word.
+//
+// Conditional branches continue both ways, calls and traps continue at their return point and HALT
+// ends the path. JMP R7 is a return. Other JMPs and JSRRs are resolved when the register was set
+// from a constant earlier on the same path (LEA, or LD of a .FILL holding an address). A constant
+// address stored into the trap or interrupt vector table makes its target a handler function. Words
+// that are loaded, stored or pointed at by reached code are data, everything else that was never
+// reached stays unknown.
+//
+// The whole analysis makes one pass over the reached code and a few linear passes over the address
+// space, so a full image takes a few milliseconds.
+class ControlFlowGraph
+{
+public:
+    enum EXIT
+    {
+        EX_FALLTHROUGH = 0,  /* the next word starts another block */
+        EX_BRANCH,           /* conditional BR */
+        EX_JUMP,             /* unconditional BR, or JMP with a resolved target */
+        EX_COMPUTED,         /* JMP with an unknown target */
+        EX_CALL,             /* JSR or JSRR */
+        EX_RETURN,           /* JMP R7 */
+        EX_TRAP,
+        EX_HALT,
+        EX_RTI,
+        EX_INVALID           /* reserved opcode, or the walk ran into the device registers */
+    };
+
+    enum WORD_KIND
+    {
+        WK_UNKNOWN = 0,
+        WK_CODE,
+        WK_DATA
+    };
+
+    enum
+    {
+        MAX_BLOCK = 256,       /* longest block, longer straight-line runs are split */
+        VECTOR_TABLE_END = 0x0200
+    };
+
+    void Analyze(const uint16_t* memory, uint16_t entry);
+
+    // Same with more roots after the entry point, e.g. the trap routines of an OS image
+    void Analyze(const uint16_t* memory, const std::vector<uint16_t>& entries);
+
+    const std::vector<BasicBlock>& GetBlocks() const
+    {
+        return blocks;
+    }
+
+    const std::vector<FunctionInfo>& GetFunctions() const
+    {
+        return functions;
+    }
+
+    WORD_KIND GetKind(uint16_t address) const
+    {
+        return static_cast<WORD_KIND>(kinds[address]);
+    }
+
+    bool IsBlockStart(uint16_t address) const
+    {
+        return blockStart[address];
+    }
+
+    // Block containing address, nullptr if it is not code
+    const BasicBlock* FindBlock(uint16_t address) const;
+
+    // True if the instruction always ends a block
+    static bool EndsBlock(uint16_t instruction);
+
+    static const char* GetExitName(EXIT exit);
+
+    // Lists functions and blocks with their labels, then the code/data summary
+    void Print(std::ostream& out, const ObjectImage& debugInfo) const;
+
+private:
+    struct Constants
+    {
+        uint16_t value[8] = {};
+        uint8_t known = 0;
+    };
+
+    void Walk(uint16_t address);
+
+    void Track(uint16_t address, Constants& constants);
+
+    void AddRoot(uint16_t address, bool isFunction, bool isHandler);
+
+    void BuildBlocks();
+
+    void BuildFunctions();
+
+    const uint16_t* memory = nullptr;
+    uint16_t entry = 0;
+    std::vector<uint8_t> kinds;
+    std::vector<bool> blockStart;
+    std::vector<bool> referenced;
+    std::vector<uint16_t> pending;
+    std::vector<uint16_t> functionEntries;
+    std::vector<uint16_t> handlers;
+    std::vector<std::pair<uint16_t, uint16_t>> resolved; /* JMP/JSRR site and its target */
+    std::vector<BasicBlock> blocks;
+    std::vector<FunctionInfo> functions;
+};
@@ -0,0 +1,421 @@
+#include "DebugConsole.h"
+#include "CPU.h"
+#include "Debugger.h"
+#include "Keyboard.h"
+#include "ReverseDebugger.h"
+#include "Utilities.h"
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+bool DebugConsole::quitRequested = false;
+ObjectImage DebugConsole::debugInfo;
+
+namespace
+{
+    std::string Hex(uint16_t value)
+    {
+        std::ostringstream text;
+        text << 'x' << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << value;
+        return text.str();
+    }
+
+    std::string Reg(uint16_t instruction, int shift)
+    {
+        return "R" + std::to_string((instruction >> shift) & 0x7);
+    }
+
+    std::string Imm(uint16_t instruction, int bits)
+    {
+        return "#" + std::to_string(static_cast<int16_t>(CPU::ExtendSign(instruction & ((1 << bits) - 1), bits)));
+    }
+
+    std::string Target(uint16_t address, uint16_t instruction, int bits)
+    {
+        return Hex(address + 1 + CPU::ExtendSign(instruction & ((1 << bits) - 1), bits));
+    }
+}
+
+std::string DebugConsole::Disassemble(uint16_t address, uint16_t instruction)
+{
+    switch (instruction >> 12)
+    {
+    case CPU::OP_BR:
+    {
+        if (!(instruction & 0x0E00))
+            return "NOP";
+
+        std::string name = "BR";
+        if (instruction & 0x0800) name += 'n';
+        if (instruction & 0x0400) name += 'z';
+        if (instruction & 0x0200) name += 'p';
+        return name + " " + Target(address, instruction, 9);
+    }
+    case CPU::OP_ADD:
+    case CPU::OP_AND:
+        return std::string((instruction >> 12) == CPU::OP_ADD ? "ADD " : "AND ") + Reg(instruction, 9) + ", " + Reg(instruction, 6) + ", "
+            + ((instruction & 0x20) ? Imm(instruction, 5) : Reg(instruction, 0));
+    case CPU::OP_NOT:
+        return "NOT " + Reg(instruction, 9) + ", " + Reg(instruction, 6);
+    case CPU::OP_LD:
+        return "LD " + Reg(instruction, 9) + ", " + Target(address, instruction, 9);
+    case CPU::OP_LDI:
+        return "LDI " + Reg(instruction, 9) + ", " + Target(address, instruction, 9);
+    case CPU::OP_LEA:
+        return "LEA " + Reg(instruction, 9) + ", " + Target(address, instruction, 9);
+    case CPU::OP_ST:
+        return "ST " + Reg(instruction, 9) + ", " + Target(address, instruction, 9);
+    case CPU::OP_STI:
+        return "STI " + Reg(instruction, 9) + ", " + Target(address, instruction, 9);
+    case CPU::OP_LDR:
+        return "LDR " + Reg(instruction, 9) + ", " + Reg(instruction, 6) + ", " + Imm(instruction, 6);
+    case CPU::OP_STR:
+        return "STR " + Reg(instruction, 9) + ", " + Reg(instruction, 6) + ", " + Imm(instruction, 6);
+    case CPU::OP_JSR:
+        return (instruction & 0x0800) ? "JSR " + Target(address, instruction, 11) : "JSRR " + Reg(instruction, 6);
+    case CPU::OP_JMP:
+        return ((instruction >> 6) & 0x7) == 7 ? "RET" : "JMP " + Reg(instruction, 6);
+    case CPU::OP_TRAP:
+    {
+        std::ostringstream text;
+        text << "TRAP x" << std::hex << std::uppercase << (instruction & 0xFF);
+        return text.str();
+    }
+    case CPU::OP_RTI:
+        return "RTI";
+    default:
+        return ".FILL " + Hex(instruction);
+    }
+}
+
+bool DebugConsole::ReadLine(std::string& line)
+{
+    line.clear();
+    std::cout << "(lc3) " << std::flush;
+
+    while (true)
+    {
+        uint16_t key = Keyboard::PopKey();
+        if (key == 0xFFFF)
+            return false;
+
+        if (key == '\r' || key == '\n')
+        {
+            std::cout << '\n';
+            return true;
+        }
+
+        // The console is in raw mode, so echo and erase by hand
+        if (key == 8 || key == 127)
+        {
+            if (!line.empty())
+            {
+                line.pop_back();
+                std::cout << "\b \b" << std::flush;
+            }
+            continue;
+        }
+
+        line += static_cast<char>(key);
+        std::cout << static_cast<char>(key) << std::flush;
+    }
+}
+
+bool DebugConsole::ParseNumber(const std::string& text, uint32_t& value)
+{
+    uint16_t address;
+    if (ObjectFormat::FindSymbol(debugInfo, Utilities::ToUpperCase(text), address))
+    {
+        value = address;
+        return true;
+    }
+
+    try
+    {
+        size_t used = 0;
+        if (text.size() > 1 && (text[0] == 'x' || text[0] == 'X'))
+            value = std::stoul(text.substr(1), &used, 16), ++used;
+        else
+            value = std::stoul(text, &used, 0);
+        return used == text.size();
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+}
+
+std::string DebugConsole::Label(uint16_t address)
+{
+    std::string name = ObjectFormat::Locate(debugInfo, address);
+    return name.empty() ? "" : " <" + name + ">";
+}
+
+void DebugConsole::PrintLocation()
+{
+    uint16_t pc = CPU::cores[0].reg[CPU::R_PC];
+    uint16_t line = ObjectFormat::FindLine(debugInfo, pc);
+
+    std::cout << "[" << CPU::cores[0].instructionCount << (ReverseDebugger::IsReplaying() ? ", replay" : "") << "] "
+        << Hex(pc) << Label(pc) << ": " << Disassemble(pc, CPU::memory[pc])
+        << (line ? "  ; line " + std::to_string(line) : "") << (CPU::cores[0].shouldBeRunning ? "" : "  (halted)") << '\n';
+}
+
+void DebugConsole::PrintRegisters()
+{
+    for (int i = 0; i < 8; ++i)
+        std::cout << "R" << i << "=" << Hex(CPU::cores[0].reg[i]) << (i == 3 ? '\n' : ' ');
+
+    uint16_t flags = CPU::cores[0].GetConditionFlags();
+    std::cout << "\nPC=" << Hex(CPU::cores[0].reg[CPU::R_PC]) << " PSR=" << Hex(CPU::cores[0].GetPSR()) << " CC="
+        << (flags & CPU::FL_NEG ? 'N' : flags & CPU::FL_ZRO ? 'Z' : 'P') << '\n';
+}
+
+void DebugConsole::PrintMemory(uint16_t address, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        uint16_t current = address + i;
+        std::cout << Hex(current) << Label(current) << ": " << Hex(CPU::memory[current]) << "  " << Disassemble(current, CPU::memory[current]) << '\n';
+    }
+}
+
+void DebugConsole::PrintHelp()
+{
+    std::cout << "  s [n]         step n instructions, default 1\n"
+        << "  b [n]         step back n instructions\n"
+        << "  c             continue until a breakpoint, a watchpoint or the program halts; Ctrl-C stops it\n"
+        << "  rc [address]  run backwards to the last breakpoint or watched store, or to the last time PC\n"
+        << "                was at address; stops at the start of history otherwise\n"
+        << "  bp address [Rn op value]\n"
+        << "                break before the instruction at address, optionally only when the register\n"
+        << "                compares true; op is one of == != < <= > >= and values are signed\n"
+        << "  wp address [r|w|rw]\n"
+        << "                stop after a load from or store to address, default w\n"
+        << "  l             list breakpoints and watchpoints\n"
+        << "  del [id]      delete one breakpoint or watchpoint, or all of them\n"
+        << "  g n           go to instruction number n within the history\n"
+        << "  r             show registers\n"
+        << "  m address [n] show n words of memory, default 8\n"
+        << "  h             show the recorded history\n"
+        << "  q             quit" << '\n';
+}
+
+void DebugConsole::RunForward(uint64_t count)
+{
+    Debugger::ClearStop();
+    Debugger::breakRequested.store(false, std::memory_order_relaxed);
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        // A breakpoint on the current instruction does not stop the first step, so continuing from it works
+        if (i > 0 && Debugger::IsArmed() && Debugger::IsBreakpointHit(CPU::cores[0].reg))
+        {
+            std::cout << "Breakpoint" << '\n';
+            break;
+        }
+
+        if (ReverseDebugger::IsReplaying())
+        {
+            const uint16_t* registers;
+            int storeAddress;
+            ReverseDebugger::GetStep(ReverseDebugger::GetPosition(), registers, storeAddress);
+            ReverseDebugger::StepForward();
+
+            if (Debugger::IsArmed())
+                Debugger::CheckRecordedStore(storeAddress);
+        }
+        else if (CPU::cores[0].shouldBeRunning)
+        {
+            CPU::cores[0].ProcessInstrumentedWord();
+        }
+        else
+        {
+            std::cout << "The program has halted" << '\n';
+            break;
+        }
+
+        if (Debugger::HasStopped())
+        {
+            std::cout << Debugger::GetStopReason() << '\n';
+            break;
+        }
+
+        if (Debugger::breakRequested.load(std::memory_order_relaxed))
+        {
+            std::cout << "Interrupted" << '\n';
+            break;
+        }
+    }
+
+    PrintLocation();
+}
+
+void DebugConsole::AddPoint(const std::vector<std::string>& words)
+{
+    uint32_t address;
+    if (words.size() < 2 || !ParseNumber(words[1], address))
+    {
+        PrintHelp();
+        return;
+    }
+
+    if (Utilities::ToUpperCase(words[0]) == "WP")
+    {
+        std::string kind = words.size() > 2 ? Utilities::ToUpperCase(words[2]) : "W";
+        uint8_t flags = (kind.find('R') != std::string::npos ? Debugger::DF_READ : 0) | (kind.find('W') != std::string::npos ? Debugger::DF_WRITE : 0);
+
+        if (!flags)
+        {
+            PrintHelp();
+            return;
+        }
+
+        Debugger::AddWatchpoint(static_cast<uint16_t>(address), flags);
+        std::cout << Debugger::Describe(Debugger::GetPoints().back()) << '\n';
+        return;
+    }
+
+    if (words.size() == 2)
+    {
+        Debugger::AddBreakpoint(static_cast<uint16_t>(address));
+        std::cout << Debugger::Describe(Debugger::GetPoints().back()) << '\n';
+        return;
+    }
+
+    static const char* operators[] = { "", "==", "!=", "<", "<=", ">", ">=" };
+    std::string registerName = words.size() == 5 ? Utilities::ToUpperCase(words[2]) : "";
+    uint32_t value;
+    int condition = 1;
+
+    while (words.size() == 5 && condition < 7 && words[3] != operators[condition])
+        ++condition;
+
+    if (registerName.size() != 2 || registerName[0] != 'R' || registerName[1] < '0' || registerName[1] > '7'
+        || condition == 7 || !ParseNumber(words[4], value))
+    {
+        PrintHelp();
+        return;
+    }
+
+    Debugger::AddBreakpoint(static_cast<uint16_t>(address), static_cast<Debugger::CONDITION>(condition),
+        static_cast<uint8_t>(registerName[1] - '0'), static_cast<uint16_t>(value));
+    std::cout << Debugger::Describe(Debugger::GetPoints().back()) << '\n';
+}
+
+void DebugConsole::Execute(const std::vector<std::string>& words)
+{
+    std::string command = Utilities::ToUpperCase(words[0]);
+    uint32_t argument = 0;
+    bool hasArgument = words.size() > 1 && ParseNumber(words[1], argument);
+
+    if (words.size() > 1 && !hasArgument && command != "BP" && command != "WP")
+    {
+        std::cout << "Bad number: " << words[1] << '\n';
+        return;
+    }
+
+    if (command == "S")
+    {
+        RunForward(hasArgument ? argument : 1);
+    }
+    else if (command == "B")
+    {
+        uint32_t count = hasArgument ? argument : 1;
+        bool moved = true;
+
+        for (uint32_t i = 0; i < count && moved; ++i)
+            moved = ReverseDebugger::StepBack();
+
+        if (!moved)
+            std::cout << "At the start of the recorded history" << '\n';
+        PrintLocation();
+    }
+    else if (command == "C")
+    {
+        RunForward(UINT64_MAX);
+    }
+    else if (command == "RC")
+    {
+        bool found = ReverseDebugger::ReverseContinue([&](const uint16_t* registers, int storeAddress)
+        {
+            if (hasArgument)
+                return registers[CPU::R_PC] == argument;
+
+            return Debugger::IsArmed() && (Debugger::IsBreakpointHit(registers)
+                || (storeAddress >= 0 && (Debugger::flags[storeAddress] & Debugger::DF_WRITE)));
+        });
+
+        if (!found)
+            std::cout << "At the start of the recorded history" << '\n';
+        PrintLocation();
+    }
+    else if (command == "BP" || command == "WP")
+    {
+        AddPoint(words);
+    }
+    else if (command == "L")
+    {
+        for (const Debugger::Point& point : Debugger::GetPoints())
+            std::cout << Debugger::Describe(point) << '\n';
+    }
+    else if (command == "DEL")
+    {
+        if (!hasArgument)
+            Debugger::RemoveAll();
+        else if (!Debugger::Remove(static_cast<int>(argument)))
+            std::cout << "No breakpoint or watchpoint #" << argument << '\n';
+    }
+    else if (command == "G" && hasArgument)
+    {
+        if (!ReverseDebugger::GoTo(argument))
+            std::cout << "Not in the recorded history, which covers " << ReverseDebugger::GetFirst() << " to " << ReverseDebugger::GetEnd() << '\n';
+        PrintLocation();
+    }
+    else if (command == "R")
+    {
+        PrintRegisters();
+    }
+    else if (command == "M" && hasArgument)
+    {
+        uint32_t count = 8;
+        if (words.size() > 2 && !ParseNumber(words[2], count))
+            count = 8;
+        PrintMemory(static_cast<uint16_t>(argument), static_cast<uint16_t>(std::min<uint32_t>(count, MEM_MAX)));
+    }
+    else if (command == "H")
+    {
+        std::cout << "History covers instructions " << ReverseDebugger::GetFirst() << " to " << ReverseDebugger::GetEnd()
+            << ", using " << ReverseDebugger::GetMemoryUsage() / 1024 << " KB" << '\n';
+    }
+    else if (command == "Q")
+    {
+        quitRequested = true;
+    }
+    else
+    {
+        PrintHelp();
+    }
+}
+
+void DebugConsole::Run()
+{
+    CPU::cores[0].SetConditionFlags(CPU::FL_ZRO);
+
+    std::cout << "Debugging, ? lists the commands" << '\n';
+    PrintLocation();
+
+    std::string line;
+    while (!quitRequested && ReadLine(line))
+    {
+        std::istringstream stream(line);
+        std::vector<std::string> words;
+        std::string word;
+
+        while (stream >> word)
+            words.push_back(word);
+
+        if (!words.empty())
+            Execute(words);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ObjectFormat.h"
+
+// Interactive command loop for -debug. Commands are read from the keyboard queue, so keys typed
+// while the program runs still go to the program. Ctrl-C stops a running program.
+class DebugConsole
+{
+public:
+    // Runs the loaded program under the console until the user quits
+    static void Run();
+
+    static std::string Disassemble(uint16_t address, uint16_t instruction);
+
+    // Symbols and source lines to show next to addresses. Labels are also accepted wherever an address is.
+    static void SetDebugInfo(const ObjectImage& info)
+    {
+        debugInfo = info;
+    }
+
+private:
+    static bool ReadLine(std::string& line);
+
+    static void Execute(const std::vector<std::string>& words);
+
+    // Steps forward, replaying recorded history first, until count steps are done, the program
+    // halts, a breakpoint or watchpoint fires or Ctrl-C is pressed
+    static void RunForward(uint64_t count);
+
+    static void AddPoint(const std::vector<std::string>& words);
+
+    static void PrintLocation();
+
+    static void PrintRegisters();
+
+    static void PrintMemory(uint16_t address, uint16_t count);
+
+    static void PrintHelp();
+
+    static bool ParseNumber(const std::string& text, uint32_t& value);
+
+    // " <LABEL+n>" for addresses covered by a symbol, empty otherwise
+    static std::string Label(uint16_t address);
+
+    static ObjectImage debugInfo;
+
+    static bool quitRequested;
+};
@@ -0,0 +1,143 @@
+#include "Debugger.h"
+#include <algorithm>
+#include <csignal>
+#include <iomanip>
+#include <sstream>
+
+std::atomic<bool> Debugger::breakRequested(false);
+uint8_t Debugger::flags[MEM_MAX] = {0};
+std::vector<Debugger::Point> Debugger::points;
+bool Debugger::armed = false;
+int Debugger::nextId = 1;
+std::string Debugger::stopReason;
+
+namespace
+{
+    const char* conditionNames[] = { "", "==", "!=", "<", "<=", ">", ">=" };
+
+    std::string Hex(uint16_t value)
+    {
+        std::ostringstream text;
+        text << 'x' << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << value;
+        return text.str();
+    }
+}
+
+int Debugger::AddBreakpoint(uint16_t address, CONDITION condition, uint8_t registerIndex, uint16_t value)
+{
+    points.push_back({ nextId, address, DF_BREAK, registerIndex, condition, value });
+    RefreshFlags(address);
+    return nextId++;
+}
+
+int Debugger::AddWatchpoint(uint16_t address, uint8_t kind)
+{
+    points.push_back({ nextId, address, static_cast<uint8_t>(kind & (DF_READ | DF_WRITE)), 0, CO_ALWAYS, 0 });
+    RefreshFlags(address);
+    return nextId++;
+}
+
+bool Debugger::Remove(int id)
+{
+    auto point = std::find_if(points.begin(), points.end(), [id](const Point& candidate) { return candidate.id == id; });
+    if (point == points.end())
+        return false;
+
+    uint16_t address = point->address;
+    points.erase(point);
+    RefreshFlags(address);
+    return true;
+}
+
+void Debugger::RemoveAll()
+{
+    for (const Point& point : points)
+        flags[point.address] = 0;
+
+    points.clear();
+    armed = false;
+}
+
+void Debugger::RefreshFlags(uint16_t address)
+{
+    flags[address] = 0;
+    for (const Point& point : points)
+    {
+        if (point.address == address)
+            flags[address] |= point.kind;
+    }
+
+    armed = !points.empty();
+}
+
+bool Debugger::IsBreakpointHit(const uint16_t* registers)
+{
+    uint16_t pc = registers[CPU::R_PC];
+    if (!(flags[pc] & DF_BREAK))
+        return false;
+
+    for (const Point& point : points)
+    {
+        if (point.address != pc || point.kind != DF_BREAK)
+            continue;
+
+        int16_t actual = static_cast<int16_t>(registers[point.registerIndex]);
+        int16_t expected = static_cast<int16_t>(point.value);
+
+        switch (point.condition)
+        {
+        case CO_ALWAYS: return true;
+        case CO_EQUAL: if (actual == expected) return true; break;
+        case CO_NOT_EQUAL: if (actual != expected) return true; break;
+        case CO_LESS: if (actual < expected) return true; break;
+        case CO_LESS_EQUAL: if (actual <= expected) return true; break;
+        case CO_GREATER: if (actual > expected) return true; break;
+        case CO_GREATER_EQUAL: if (actual >= expected) return true; break;
+        }
+    }
+
+    return false;
+}
+
+void Debugger::CheckRead(uint16_t address, uint16_t value)
+{
+    // The first watched access of a step is the one reported
+    if ((flags[address] & DF_READ) && stopReason.empty())
+        stopReason = "Read from " + Hex(address) + ": " + Hex(value);
+}
+
+void Debugger::CheckWrite(uint16_t address, uint16_t value)
+{
+    if ((flags[address] & DF_WRITE) && stopReason.empty())
+        stopReason = "Write to " + Hex(address) + ": " + Hex(CPU::memory[address]) + " -> " + Hex(value);
+}
+
+void Debugger::CheckRecordedStore(int address)
+{
+    if (address >= 0 && (flags[address] & DF_WRITE))
+        stopReason = "Write to " + Hex(static_cast<uint16_t>(address)) + ": " + Hex(CPU::memory[address]);
+}
+
+std::string Debugger::Describe(const Point& point)
+{
+    std::string text = "#" + std::to_string(point.id) + " ";
+
+    if (point.kind == DF_BREAK)
+    {
+        text += "break at " + Hex(point.address);
+        if (point.condition != CO_ALWAYS)
+            text += " if R" + std::to_string(point.registerIndex) + " " + conditionNames[point.condition] + " " + std::to_string(static_cast<int16_t>(point.value));
+    }
+    else
+    {
+        text += std::string("watch ") + ((point.kind & DF_READ) ? "r" : "") + ((point.kind & DF_WRITE) ? "w" : "") + " " + Hex(point.address);
+    }
+
+    return text;
+}
+
+void Debugger::HandleInterrupt(int signal)
+{
+    breakRequested.store(true, std::memory_order_relaxed);
+    std::signal(signal, HandleInterrupt);
+}
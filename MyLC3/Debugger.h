@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+// Breakpoints and watchpoints for the -debug console. Every address has a flag byte saying whether
+// anything is set on it, and the flags are only looked at while at least one point is armed, so
+// an unarmed debugger costs one branch per step and per access. Watchpoints see every load and
+// store the instrumented engine makes, including LDI/STI pointers, interrupt and TRAP stack
+// frames and the strings native PUTS reads. The normal ProcessProgram loops never call it.
+class Debugger
+{
+public:
+    enum
+    {
+        DF_BREAK = 1 << 0, /* breakpoint on the instruction at this address */
+        DF_READ = 1 << 1,  /* watch loads from this address */
+        DF_WRITE = 1 << 2  /* watch stores to this address */
+    };
+
+    enum CONDITION
+    {
+        CO_ALWAYS = 0,
+        CO_EQUAL,
+        CO_NOT_EQUAL,
+        CO_LESS,       /* registers compare as signed 16-bit values */
+        CO_LESS_EQUAL,
+        CO_GREATER,
+        CO_GREATER_EQUAL
+    };
+
+    struct Point
+    {
+        int id;
+        uint16_t address;
+        uint8_t kind;  /* DF_BREAK, or DF_READ and/or DF_WRITE */
+        uint8_t registerIndex;
+        CONDITION condition;
+        uint16_t value;
+    };
+
+    static int AddBreakpoint(uint16_t address, CONDITION condition = CO_ALWAYS, uint8_t registerIndex = 0, uint16_t value = 0);
+
+    static int AddWatchpoint(uint16_t address, uint8_t kind);
+
+    static bool Remove(int id);
+
+    static void RemoveAll();
+
+    static const std::vector<Point>& GetPoints()
+    {
+        return points;
+    }
+
+    static bool IsArmed()
+    {
+        return armed;
+    }
+
+    // Whether a breakpoint stops the step whose registers (R0-R7 and PC) are given, before it executes
+    static bool IsBreakpointHit(const uint16_t* registers);
+
+    // Called by the instrumented engine for every load, with the value it read
+    static void CheckRead(uint16_t address, uint16_t value);
+
+    // Called by the instrumented engine for every store, before memory changes
+    static void CheckWrite(uint16_t address, uint16_t value);
+
+    // Checks a store replayed from the history against the write watchpoints
+    static void CheckRecordedStore(int address);
+
+    static bool HasStopped()
+    {
+        return !stopReason.empty();
+    }
+
+    static const std::string& GetStopReason()
+    {
+        return stopReason;
+    }
+
+    static void ClearStop()
+    {
+        stopReason.clear();
+    }
+
+    static std::string Describe(const Point& point);
+
+    // SIGINT handler while debugging: stops a running program at the next instruction
+    static void HandleInterrupt(int signal);
+
+    static std::atomic<bool> breakRequested;
+
+    static uint8_t flags[MEM_MAX];
+
+private:
+    static void RefreshFlags(uint16_t address);
+
+    static std::vector<Point> points;
+
+    static bool armed;
+
+    static int nextId;
+
+    static std::string stopReason;
+};
@@ -0,0 +1,19 @@
+#include "DecodeTable.h"
+
+namespace
+{
+    constexpr std::array<DecodedInstruction, MEM_MAX> BuildEntries()
+    {
+        std::array<DecodedInstruction, MEM_MAX> entries{};
+        for (uint32_t instruction = 0; instruction < MEM_MAX; ++instruction)
+        {
+            entries[instruction] = DecodeTable::Decode(static_cast<uint16_t>(instruction));
+        }
+        return entries;
+    }
+}
+
+// Evaluated by the compiler. MSVC needs a raised /constexpr:steps for the 64K iterations.
+alignas(64) constinit const std::array<DecodedInstruction, MEM_MAX> DecodeTable::entries = BuildEntries();
+
+static_assert(sizeof(DecodedInstruction) == 6, "decode table entries are expected to be 6 bytes");
@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "CPU.h"
+
+struct DecodedInstruction
+{
+    uint16_t operand = 0;   /* sign-extended immediate or offset, or the second source register */
+    uint8_t handler = 0;    /* DecodeTable::HANDLER */
+    uint8_t dr = 0;         /* destination or source register, the n/z/p mask of a BR */
+    uint8_t sr = 0;         /* first source or base register */
+};
+
+// Every 16-bit word decoded once, at compile time. CPU::Execute looks an instruction up here and
+// finds its registers and sign-extended immediate already extracted, so the handlers do no
+// shifting, masking or sign extension at run time. The handler also tells apart the modes of an
+// opcode (register or immediate ADD/AND, JSR or JSRR).
+//
+// Execute still dispatches on the top four bits of the word rather than on the handler: those are
+// known as soon as the word is fetched, while the handler is one more load away, and putting that
+// load in front of the indirect jump made every instruction slower.
+//
+// Entries are 6 bytes, so the table takes 384 KB. Only the encodings a program actually executes
+// are ever touched, usually a few hundred cache lines.
+class DecodeTable
+{
+public:
+    enum HANDLER
+    {
+        H_BR = 0,
+        H_ADD,
+        H_ADD_IMM,
+        H_LD,
+        H_ST,
+        H_JSR,
+        H_JSRR,
+        H_AND,
+        H_AND_IMM,
+        H_LDR,
+        H_STR,
+        H_RTI,
+        H_NOT,
+        H_LDI,
+        H_STI,
+        H_JMP,
+        H_RES,
+        H_LEA,
+        H_TRAP
+    };
+
+    static const DecodedInstruction& Get(uint16_t instruction)
+    {
+        return entries[instruction];
+    }
+
+    static constexpr DecodedInstruction Decode(uint16_t instruction)
+    {
+        DecodedInstruction decoded;
+        decoded.dr = (instruction >> 9) & 0x7;
+        decoded.sr = (instruction >> 6) & 0x7;
+
+        switch (instruction >> 12)
+        {
+        case CPU::OP_BR:
+            decoded.handler = H_BR;
+            decoded.operand = CPU::ExtendSign(instruction & 0b111111111, 9);
+            break;
+        case CPU::OP_ADD:
+        case CPU::OP_AND:
+        {
+            bool isAdd = (instruction >> 12) == CPU::OP_ADD;
+            if ((instruction >> 5) & 1)
+            {
+                decoded.handler = isAdd ? H_ADD_IMM : H_AND_IMM;
+                decoded.operand = CPU::ExtendSign(instruction & 0b11111, 5);
+            }
+            else
+            {
+                decoded.handler = isAdd ? H_ADD : H_AND;
+                decoded.operand = instruction & 0x7;
+            }
+            break;
+        }
+        case CPU::OP_JSR:
+            decoded.handler = ((instruction >> 11) & 1) ? H_JSR : H_JSRR;
+            decoded.operand = CPU::ExtendSign(instruction & 0b11111111111, 11);
+            break;
+        case CPU::OP_LD:
+        case CPU::OP_ST:
+        case CPU::OP_LDI:
+        case CPU::OP_STI:
+        case CPU::OP_LEA:
+            decoded.handler = GetHandler(instruction >> 12);
+            decoded.operand = CPU::ExtendSign(instruction & 0b111111111, 9);
+            break;
+        case CPU::OP_LDR:
+        case CPU::OP_STR:
+            decoded.handler = GetHandler(instruction >> 12);
+            decoded.operand = CPU::ExtendSign(instruction & 0b111111, 6);
+            break;
+        default:
+            decoded.handler = GetHandler(instruction >> 12);
+            break;
+        }
+
+        return decoded;
+    }
+
+private:
+    static constexpr uint8_t GetHandler(uint16_t opcode)
+    {
+        switch (opcode)
+        {
+        case CPU::OP_LD: return H_LD;
+        case CPU::OP_ST: return H_ST;
+        case CPU::OP_LDR: return H_LDR;
+        case CPU::OP_STR: return H_STR;
+        case CPU::OP_RTI: return H_RTI;
+        case CPU::OP_NOT: return H_NOT;
+        case CPU::OP_LDI: return H_LDI;
+        case CPU::OP_STI: return H_STI;
+        case CPU::OP_JMP: return H_JMP;
+        case CPU::OP_LEA: return H_LEA;
+        case CPU::OP_TRAP: return H_TRAP;
+        default: return H_RES;
+        }
+    }
+
+    static const std::array<DecodedInstruction, MEM_MAX> entries;
+};
@@ -0,0 +1,465 @@
+#include "GdbStub.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET SocketHandle;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketHandle;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+std::atomic<bool> GdbStub::inputArrived(false);
+bool GdbStub::breakpoints[MEM_MAX] = {false};
+uint32_t GdbStub::breakpointCount = 0;
+int GdbStub::stopSignal = SIG_TRAP;
+
+static SocketHandle connection = INVALID_SOCKET;
+static char receiveBuffer[4096];
+static int receivedCount = 0;
+static int receivedOffset = 0;
+static bool acknowledge = true;
+
+static bool ReadByte(char& value)
+{
+    if (receivedOffset == receivedCount)
+    {
+        receivedCount = recv(connection, receiveBuffer, sizeof(receiveBuffer), 0);
+        receivedOffset = 0;
+
+        if (receivedCount <= 0)
+        {
+            receivedCount = 0;
+            return false;
+        }
+    }
+
+    value = receiveBuffer[receivedOffset++];
+    return true;
+}
+
+static bool WaitReadable(int milliseconds)
+{
+    if (receivedOffset < receivedCount)
+        return true;
+
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(connection, &readable);
+    timeval timeout = { 0, milliseconds * 1000 };
+
+    return select(static_cast<int>(connection + 1), &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+static void SendAll(const std::string& data)
+{
+    size_t sent = 0;
+
+    while (sent < data.size())
+    {
+        int count = send(connection, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+        if (count <= 0)
+            return;
+
+        sent += count;
+    }
+}
+
+static std::string HexWord(uint16_t value)
+{
+    static const char digits[] = "0123456789abcdef";
+    return { digits[value >> 12], digits[(value >> 8) & 0xF], digits[(value >> 4) & 0xF], digits[value & 0xF] };
+}
+
+static int HexDigit(char digit)
+{
+    if (digit >= '0' && digit <= '9')
+        return digit - '0';
+    if (digit >= 'a' && digit <= 'f')
+        return digit - 'a' + 10;
+    if (digit >= 'A' && digit <= 'F')
+        return digit - 'A' + 10;
+    return -1;
+}
+
+// Reads hex digits starting at position, leaving position on the first character that is not one
+static uint32_t ParseHex(const std::string& text, size_t& position)
+{
+    uint32_t value = 0;
+
+    while (position < text.size() && HexDigit(text[position]) >= 0)
+        value = (value << 4) | HexDigit(text[position++]);
+
+    return value;
+}
+
+static uint16_t ParseWord(const std::string& text, size_t position, size_t digits = 4)
+{
+    size_t end = 0;
+    return static_cast<uint16_t>(ParseHex(text.substr(position, digits), end));
+}
+
+bool GdbStub::Serve(uint16_t port)
+{
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return false;
+#endif
+
+    SocketHandle listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+        return false;
+
+    int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0)
+    {
+        std::cout << "Could not listen on localhost:" << port << '\n';
+        closesocket(listener);
+        return false;
+    }
+
+    std::cout << "Waiting for GDB on localhost:" << port << '\n';
+    connection = accept(listener, nullptr, nullptr);
+    closesocket(listener);
+
+    if (connection == INVALID_SOCKET)
+        return false;
+
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+    std::cout << "GDB connected" << '\n';
+
+    std::string packet;
+    while (ReadPacket(packet) && HandlePacket(packet))
+    {
+    }
+
+    // Whatever happens next runs without the debugger
+    std::fill(std::begin(breakpoints), std::end(breakpoints), false);
+    breakpointCount = 0;
+
+    closesocket(connection);
+    connection = INVALID_SOCKET;
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    return true;
+}
+
+void GdbStub::RequestStop(int signal)
+{
+    stopSignal = signal;
+    CPU::cores[0].shouldBeRunning = false;
+}
+
+bool GdbStub::ReadPacket(std::string& packet)
+{
+    while (true)
+    {
+        char value;
+
+        // Acks and a Ctrl-C sent while already stopped are skipped
+        do
+        {
+            if (!ReadByte(value))
+                return false;
+        } while (value != '$');
+
+        packet.clear();
+        uint8_t sum = 0;
+
+        while (true)
+        {
+            if (!ReadByte(value))
+                return false;
+            if (value == '#')
+                break;
+
+            packet += value;
+            sum += static_cast<uint8_t>(value);
+        }
+
+        char checksum[2];
+        if (!ReadByte(checksum[0]) || !ReadByte(checksum[1]))
+            return false;
+
+        bool valid = HexDigit(checksum[0]) * 16 + HexDigit(checksum[1]) == sum;
+
+        if (acknowledge)
+            SendAll(valid ? "+" : "-");
+
+        if (valid || !acknowledge)
+            return true;
+    }
+}
+
+void GdbStub::SendPacket(const std::string& packet)
+{
+    uint8_t sum = 0;
+    for (char value : packet)
+        sum += static_cast<uint8_t>(value);
+
+    SendAll("$" + packet + "#" + HexWord(sum).substr(2));
+}
+
+bool GdbStub::HandlePacket(const std::string& packet)
+{
+    size_t position = 1;
+
+    switch (packet.empty() ? 0 : packet[0])
+    {
+    case '?':
+        SendPacket(StopReply());
+        break;
+    case 'g':
+    {
+        std::string reply;
+        for (int i = 0; i < REGISTER_COUNT; ++i)
+            reply += HexWord(GetRegister(i));
+
+        SendPacket(reply);
+        break;
+    }
+    case 'G':
+    {
+        for (int i = 0; i < REGISTER_COUNT && position + 4 <= packet.size(); ++i, position += 4)
+            SetRegister(i, ParseWord(packet, position));
+
+        SendPacket("OK");
+        break;
+    }
+    case 'p':
+    {
+        uint32_t index = ParseHex(packet, position);
+        SendPacket(index < REGISTER_COUNT ? HexWord(GetRegister(index)) : "E01");
+        break;
+    }
+    case 'P':
+    {
+        uint32_t index = ParseHex(packet, position);
+        uint32_t value = ParseHex(packet, ++position);
+
+        if (index < REGISTER_COUNT)
+            SetRegister(index, static_cast<uint16_t>(value));
+
+        SendPacket(index < REGISTER_COUNT ? "OK" : "E01");
+        break;
+    }
+    case 'm':
+    {
+        // Two hex digits a byte, so a reply never outgrows the packet size
+        uint32_t address = ParseHex(packet, position);
+        uint32_t length = std::min<uint32_t>(ParseHex(packet, ++position), PACKET_SIZE / 2);
+
+        std::string reply;
+        for (uint32_t i = 0; i < length && address + i / 2 < MEM_MAX; ++i)
+            reply += HexWord(GetMemoryByte(address, i)).substr(2);
+
+        SendPacket(reply.empty() && length ? "E01" : reply);
+        break;
+    }
+    case 'M':
+    {
+        uint32_t address = ParseHex(packet, position);
+        uint32_t length = ParseHex(packet, ++position);
+        ++position;
+
+        for (uint32_t i = 0; i < length && address + i / 2 < MEM_MAX && position + 2 <= packet.size(); ++i, position += 2)
+            SetMemoryByte(address, i, static_cast<uint8_t>(ParseWord(packet, position, 2)));
+
+        SendPacket("OK");
+        break;
+    }
+    case 'c':
+    case 's':
+    {
+        if (position < packet.size())
+            CPU::cores[0].reg[CPU::R_PC] = static_cast<uint16_t>(ParseHex(packet, position));
+
+        std::string reply = packet[0] == 'c' ? Continue() : Step();
+        SendPacket(reply);
+
+        if (reply[0] == 'W')
+            return false;
+        break;
+    }
+    case 'Z':
+    case 'z':
+    {
+        // Software and hardware breakpoints are the same table; watchpoints are not supported
+        uint32_t type = ParseHex(packet, position);
+        uint32_t address = ParseHex(packet, ++position);
+
+        if (type > 1 || address >= MEM_MAX)
+        {
+            SendPacket("");
+            break;
+        }
+
+        bool set = packet[0] == 'Z';
+
+        if (breakpoints[address] != set)
+        {
+            breakpoints[address] = set;
+            set ? ++breakpointCount : --breakpointCount;
+        }
+
+        SendPacket("OK");
+        break;
+    }
+    case 'D':
+        SendPacket("OK");
+        return false;
+    case 'k':
+        CPU::cores[0].shouldBeRunning = false;
+        return false;
+    case 'H':
+        SendPacket("OK");
+        break;
+    case 'q':
+        if (packet.compare(0, 10, "qSupported") == 0)
+            SendPacket("PacketSize=" + HexWord(PACKET_SIZE) + ";QStartNoAckMode+");
+        else if (packet == "qAttached")
+            SendPacket("1");
+        else
+            SendPacket("");
+        break;
+    case 'Q':
+        if (packet == "QStartNoAckMode")
+        {
+            SendPacket("OK");
+            acknowledge = false;
+        }
+        else
+        {
+            SendPacket("");
+        }
+        break;
+    default:
+        SendPacket("");
+        break;
+    }
+
+    return true;
+}
+
+std::string GdbStub::Continue()
+{
+    if (!CPU::cores[0].shouldBeRunning)
+        return "W00";
+
+    stopSignal = 0;
+    inputArrived.store(false, std::memory_order_relaxed);
+
+    std::atomic<bool> running(true);
+    std::thread watcher([&running]
+    {
+        while (running.load(std::memory_order_relaxed))
+        {
+            if (WaitReadable(50))
+            {
+                inputArrived.store(true, std::memory_order_relaxed);
+                CPU::RaiseEvent();
+                return;
+            }
+        }
+    });
+
+    CPU& core = CPU::cores[0];
+
+    if (!breakpointCount)
+    {
+        core.Run();
+    }
+    else
+    {
+        // A breakpoint at the PC continued from does not stop the first instruction
+        while (core.shouldBeRunning)
+        {
+            core.ProcessWord();
+
+            if (breakpoints[core.reg[CPU::R_PC]])
+                RequestStop(SIG_TRAP);
+        }
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    watcher.join();
+    inputArrived.store(false, std::memory_order_relaxed);
+
+    if (!stopSignal)
+        return "W00";
+
+    // A breakpoint or Ctrl-C only paused the program
+    CPU::cores[0].shouldBeRunning = true;
+
+    // Ctrl-C is a bare byte; anything else is left for ReadPacket
+    char value;
+    if (stopSignal == SIG_INT && WaitReadable(0) && ReadByte(value) && value != '\x03')
+        --receivedOffset;
+
+    return StopReply();
+}
+
+std::string GdbStub::Step()
+{
+    if (!CPU::cores[0].shouldBeRunning)
+        return "W00";
+
+    CPU::cores[0].ProcessWord();
+
+    stopSignal = SIG_TRAP;
+    return StopReply();
+}
+
+std::string GdbStub::StopReply()
+{
+    if (!CPU::cores[0].shouldBeRunning)
+        return "W00";
+
+    return "S" + HexWord(static_cast<uint16_t>(stopSignal ? stopSignal : SIG_TRAP)).substr(2);
+}
+
+uint8_t GdbStub::GetMemoryByte(uint32_t address, uint32_t offset)
+{
+    uint16_t word = CPU::memory[address + offset / 2];
+    return static_cast<uint8_t>(offset % 2 ? word & 0xFF : word >> 8);
+}
+
+void GdbStub::SetMemoryByte(uint32_t address, uint32_t offset, uint8_t value)
+{
+    uint16_t& word = CPU::memory[address + offset / 2];
+    word = offset % 2 ? (word & 0xFF00) | value : (word & 0x00FF) | (value << 8);
+}
+
+uint16_t GdbStub::GetRegister(int index)
+{
+    return index == CPU::R_PC + 1 ? CPU::cores[0].GetPSR() : CPU::cores[0].reg[index];
+}
+
+void GdbStub::SetRegister(int index, uint16_t value)
+{
+    if (index == CPU::R_PC + 1)
+        CPU::cores[0].SetPSR(value);
+    else
+        CPU::cores[0].reg[index] = value;
+}
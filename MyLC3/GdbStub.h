@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include "CPU.h"
+
+// GDB remote serial protocol server on a localhost TCP port. Supports register and memory access,
+// software breakpoints, single-step, continue and Ctrl-C. Memory is word addressed: addresses in
+// m/M/Z packets count 16-bit words, lengths count bytes, and words and registers are sent big-endian.
+// Registers are R0-R7, PC and PSR in that order.
+//
+// Breakpoints are kept in a table of their own rather than written into guest memory, so the
+// program and m packets only ever see its own words. Without any, continue runs the normal fused
+// loop; with some, it steps and checks the PC after every instruction. While it runs, a watcher
+// thread only waits for the socket to become readable and raises a device event; the CPU notices
+// it at the next block boundary like any other interrupt.
+class GdbStub
+{
+public:
+    // Waits for one connection on port and serves it until the debugger detaches or kills the
+    // program, or the program halts. Returns false if the port could not be opened.
+    static bool Serve(uint16_t port);
+
+    // Called at block boundaries while a device event is pending
+    static void Poll()
+    {
+        if (inputArrived.load(std::memory_order_relaxed))
+            RequestStop(SIG_INT);
+    }
+
+private:
+    enum
+    {
+        SIG_INT = 2,  /* stopped by Ctrl-C from the debugger */
+        SIG_TRAP = 5, /* stopped by a breakpoint or a single step */
+        REGISTER_COUNT = 10,
+        PACKET_SIZE = 0x4000 /* largest packet either side sends, as announced in qSupported */
+    };
+
+    static void RequestStop(int signal);
+
+    static bool ReadPacket(std::string& packet);
+
+    static void SendPacket(const std::string& packet);
+
+    // Handles one packet. Returns false once the session is over.
+    static bool HandlePacket(const std::string& packet);
+
+    // Runs until a breakpoint, Ctrl-C or halt and returns the stop reply
+    static std::string Continue();
+
+    // Executes one instruction
+    static std::string Step();
+
+    static std::string StopReply();
+
+    // Byte offset of a memory packet counted from the high byte of the word at address
+    static uint8_t GetMemoryByte(uint32_t address, uint32_t offset);
+
+    static void SetMemoryByte(uint32_t address, uint32_t offset, uint8_t value);
+
+    static uint16_t GetRegister(int index);
+
+    static void SetRegister(int index, uint16_t value);
+
+    static std::atomic<bool> inputArrived;
+
+    static bool breakpoints[MEM_MAX];
+
+    static uint32_t breakpointCount;
+
+    static int stopSignal;
+};
@@ -0,0 +1,198 @@
+#include "GoldenOutput.h"
+#include "CPU.h"
+#include <iostream>
+
+GoldenOutput::CompareBuffer GoldenOutput::compareBuffer;
+std::streambuf* GoldenOutput::consoleBuffer = nullptr;
+std::ifstream GoldenOutput::expected;
+std::ofstream GoldenOutput::capture;
+char GoldenOutput::chunk[CHUNK_SIZE];
+size_t GoldenOutput::chunkLength = 0;
+size_t GoldenOutput::chunkPosition = 0;
+bool GoldenOutput::open = false;
+bool GoldenOutput::comparing = false;
+bool GoldenOutput::diverged = false;
+uint64_t GoldenOutput::offset = 0;
+std::string GoldenOutput::recent;
+std::string GoldenOutput::expectedAfter;
+std::string GoldenOutput::actualAfter;
+uint64_t GoldenOutput::divergenceOffset = 0;
+uint64_t GoldenOutput::divergenceInstruction = 0;
+uint16_t GoldenOutput::divergencePC = 0;
+
+int GoldenOutput::CompareBuffer::overflow(int c)
+{
+    if (c != traits_type::eof())
+    {
+        char letter = static_cast<char>(c);
+        Write(&letter, 1);
+    }
+    return c;
+}
+
+std::streamsize GoldenOutput::CompareBuffer::xsputn(const char* text, std::streamsize count)
+{
+    Write(text, static_cast<size_t>(count));
+    return count;
+}
+
+bool GoldenOutput::Open(const std::string& expectedPath, const std::string& capturePath)
+{
+    if (!expectedPath.empty())
+    {
+        expected.open(expectedPath, std::ios::binary);
+        if (!expected)
+        {
+            std::cout << "Cannot read expected output " << expectedPath << '\n';
+            return false;
+        }
+    }
+
+    if (!capturePath.empty())
+    {
+        capture.open(capturePath, std::ios::binary | std::ios::trunc);
+        if (!capture)
+        {
+            std::cout << "Cannot write captured output " << capturePath << '\n';
+            return false;
+        }
+    }
+
+    comparing = !expectedPath.empty();
+    diverged = false;
+    offset = 0;
+    chunkLength = chunkPosition = 0;
+    recent.clear();
+
+    std::cout.flush();
+    consoleBuffer = std::cout.rdbuf(&compareBuffer);
+    open = true;
+    return true;
+}
+
+void GoldenOutput::Close()
+{
+    if (!open)
+        return;
+
+    std::cout.rdbuf(consoleBuffer);
+    open = false;
+
+    // Output that stopped short of the golden file differs at its end
+    if (comparing && !diverged)
+    {
+        int expectedLetter = NextExpected();
+        if (expectedLetter >= 0)
+            Diverge(expectedLetter, -1);
+    }
+
+    expected.close();
+    capture.close();
+}
+
+void GoldenOutput::Write(const char* text, size_t length)
+{
+    if (capture.is_open())
+        capture.write(text, static_cast<std::streamsize>(length));
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (diverged)
+        {
+            if (actualAfter.size() < CONTEXT_SIZE)
+                actualAfter += text[i];
+            continue;
+        }
+
+        if (comparing)
+        {
+            int expectedLetter = NextExpected();
+            if (expectedLetter != static_cast<unsigned char>(text[i]))
+            {
+                Diverge(expectedLetter, static_cast<unsigned char>(text[i]));
+                continue;
+            }
+        }
+
+        ++offset;
+
+        recent += text[i];
+        if (recent.size() > 2 * CONTEXT_SIZE)
+            recent.erase(0, recent.size() - CONTEXT_SIZE);
+    }
+}
+
+int GoldenOutput::NextExpected()
+{
+    if (chunkPosition == chunkLength)
+    {
+        expected.read(chunk, CHUNK_SIZE);
+        chunkLength = static_cast<size_t>(expected.gcount());
+        chunkPosition = 0;
+
+        if (chunkLength == 0)
+            return -1;
+    }
+
+    return static_cast<unsigned char>(chunk[chunkPosition++]);
+}
+
+void GoldenOutput::Diverge(int expectedLetter, int actualLetter)
+{
+    diverged = true;
+    divergenceOffset = offset;
+    divergenceInstruction = CPU::cores[0].instructionCount;
+    divergencePC = CPU::cores[0].reg[CPU::R_PC] - 1; // the trap or store that wrote it has already advanced the PC
+
+    expectedAfter.clear();
+    for (int letter = expectedLetter; letter >= 0 && expectedAfter.size() < CONTEXT_SIZE; letter = NextExpected())
+        expectedAfter += static_cast<char>(letter);
+
+    actualAfter.clear();
+    if (actualLetter >= 0)
+        actualAfter += static_cast<char>(actualLetter);
+
+    // The rest of the run cannot pass any more
+    CPU::cores[0].shouldBeRunning = false;
+}
+
+void GoldenOutput::PrintReport(std::ostream& stream)
+{
+    if (!comparing)
+        return;
+
+    if (!diverged)
+    {
+        stream << "Output matched the expected " << offset << " bytes" << '\n';
+        return;
+    }
+
+    std::string before = recent.substr(recent.size() > CONTEXT_SIZE ? recent.size() - CONTEXT_SIZE : 0);
+
+    stream << "Output diverged at byte " << divergenceOffset << " after " << divergenceInstruction << " instructions, PC x"
+        << std::hex << std::uppercase << divergencePC << std::dec << std::nouppercase << '\n'
+        << "  expected: \"" << Escape(before) << "\" then " << (expectedAfter.empty() ? "the end" : '"' + Escape(expectedAfter) + '"') << '\n'
+        << "  actual:   \"" << Escape(before) << "\" then " << (actualAfter.empty() ? "the end" : '"' + Escape(actualAfter) + '"') << '\n';
+}
+
+std::string GoldenOutput::Escape(const std::string& text)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    std::string escaped;
+    for (char letter : text)
+    {
+        unsigned char code = static_cast<unsigned char>(letter);
+        if (letter == '\n')
+            escaped += "\\n";
+        else if (letter == '\x1b')
+            escaped += "\\e";
+        else if (letter == '"' || letter == '\\')
+            escaped += std::string("\\") + letter;
+        else if (code < 0x20 || code >= 0x7F)
+            escaped += std::string("\\x") + digits[code >> 4] + digits[code & 0xF];
+        else
+            escaped += letter;
+    }
+    return escaped;
+}
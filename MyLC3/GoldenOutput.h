@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// Headless console for batch runs. While it is open std::cout writes here instead of the host:
+// the guest's output can be captured into a file, and compared byte for byte against an expected
+// (golden) file while the program runs. The golden file is read along in small chunks, and the
+// first byte that differs stops the machine, so a failing run costs only the instructions up to
+// its first wrong character.
+class GoldenOutput
+{
+public:
+    // Either path may be empty. Returns false if a file cannot be opened.
+    static bool Open(const std::string& expectedPath, const std::string& capturePath);
+
+    static bool IsOpen()
+    {
+        return open;
+    }
+
+    // Gives std::cout its own buffer back and checks that nothing expected is missing
+    static void Close();
+
+    // Whether the output so far matches the golden file, or there is none
+    static bool HasPassed()
+    {
+        return !diverged;
+    }
+
+    // Bytes the guest wrote since Open
+    static uint64_t GetOutputByteCount()
+    {
+        return offset;
+    }
+
+    // Where the output first differed, with the text around it
+    static void PrintReport(std::ostream& stream);
+
+private:
+    enum
+    {
+        CHUNK_SIZE = 4096,
+        CONTEXT_SIZE = 32    /* bytes of matching output shown before a difference, and at most as many after it */
+    };
+
+    class CompareBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override;
+
+        std::streamsize xsputn(const char* text, std::streamsize count) override;
+    };
+
+    static void Write(const char* text, size_t length);
+
+    // The next expected byte, or -1 at the end of the golden file
+    static int NextExpected();
+
+    // Records the first difference, -1 standing for the end of either side, and stops the machine
+    static void Diverge(int expectedLetter, int actualLetter);
+
+    static std::string Escape(const std::string& text);
+
+    static CompareBuffer compareBuffer;
+
+    static std::streambuf* consoleBuffer;
+
+    static std::ifstream expected;
+
+    static std::ofstream capture;
+
+    static char chunk[CHUNK_SIZE];
+
+    static size_t chunkLength, chunkPosition;
+
+    static bool open, comparing, diverged;
+
+    static uint64_t offset;
+
+    static std::string recent;
+
+    static std::string expectedAfter, actualAfter;
+
+    static uint64_t divergenceOffset, divergenceInstruction;
+
+    static uint16_t divergencePC;
+};
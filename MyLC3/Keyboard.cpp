@@ -0,0 +1,93 @@
+#include "Keyboard.h"
+#include "CPU.h"
+#include <cstdio>
+#include <thread>
+
+std::mutex Keyboard::queueMutex;
+std::condition_variable Keyboard::keyArrived;
+std::deque<uint16_t> Keyboard::keys;
+std::atomic<bool> Keyboard::hasKey(false);
+bool Keyboard::closed = false;
+
+void Keyboard::Start()
+{
+    std::thread(ReadInput).detach();
+}
+
+void Keyboard::ReadInput()
+{
+    int letter;
+    while ((letter = std::getchar()) != EOF)
+    {
+        Push(static_cast<uint16_t>(letter & 0xFF));
+    }
+
+    Close();
+}
+
+void Keyboard::Push(uint16_t key)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        keys.push_back(key);
+        hasKey.store(true, std::memory_order_release);
+    }
+
+    keyArrived.notify_all();
+
+    // Let the CPU latch the key at its next block boundary
+    CPU::RaiseEvent();
+}
+
+void Keyboard::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        closed = true;
+    }
+
+    keyArrived.notify_all();
+}
+
+void Keyboard::Reset()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    keys.clear();
+    hasKey.store(false, std::memory_order_release);
+    closed = false;
+}
+
+uint16_t Keyboard::PopKey(const std::atomic<bool>* cancel)
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    auto ready = [] { return !keys.empty() || closed; };
+
+    if (!cancel)
+    {
+        keyArrived.wait(lock, ready);
+    }
+    else
+    {
+        while (!keyArrived.wait_for(lock, std::chrono::milliseconds(50), ready))
+        {
+            if (cancel->load(std::memory_order_relaxed))
+                return 0xFFFE;
+        }
+    }
+
+    if (keys.empty())
+        return 0xFFFF;
+
+    uint16_t key = keys.front();
+    keys.pop_front();
+    hasKey.store(!keys.empty(), std::memory_order_release);
+
+    return key;
+}
+
+bool Keyboard::IsExhausted()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return closed && keys.empty();
+}
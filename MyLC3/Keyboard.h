@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Host side of the keyboard device. Keys are queued here by the input thread (or by Push for
+// scripted input) and latched into KBSR/KBDR by the CPU.
+class Keyboard
+{
+public:
+    static void Start();
+
+    static void Push(uint16_t key);
+
+    static void Close();
+
+    // Drops queued keys and reopens input, for running several programs in one process
+    static void Reset();
+
+    static bool HasKey()
+    {
+        return hasKey.load(std::memory_order_acquire);
+    }
+
+    // Blocks until a key is available. Returns 0xFFFF once input is closed and drained, and 0xFFFE
+    // if cancel becomes true first. The flag is polled, so it may be set from a signal handler.
+    static uint16_t PopKey(const std::atomic<bool>* cancel = nullptr);
+
+    // True once input is closed and every queued key has been consumed
+    static bool IsExhausted();
+
+private:
+    static void ReadInput();
+
+    static std::mutex queueMutex;
+
+    static std::condition_variable keyArrived;
+
+    static std::deque<uint16_t> keys;
+
+    static std::atomic<bool> hasKey;
+
+    static bool closed;
+};
@@ -0,0 +1,72 @@
+#include "Multiprocessor.h"
+#include <thread>
+#include <vector>
+
+uint64_t Multiprocessor::totalInstructions = 0;
+
+void Multiprocessor::Run(uint16_t coreCount, uint16_t entry, uint32_t lockstepQuantum)
+{
+    CPU::coreCount = coreCount;
+    CPU::lockstep = lockstepQuantum != 0;
+    totalInstructions = 0;
+
+    for (uint16_t core = 0; core < coreCount; ++core)
+    {
+        CPU& cpu = CPU::cores[core];
+        cpu.coreId = core;
+        cpu.reg[CPU::R_PC] = entry;
+        cpu.savedSSP = 0x3000 - core * CPU::SSP_STRIDE;
+        cpu.SetConditionFlags(CPU::FL_ZRO);
+        cpu.shouldBeRunning = true;
+    }
+
+    if (lockstepQuantum)
+    {
+        RunLockstep(lockstepQuantum);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        for (uint16_t core = 1; core < coreCount; ++core)
+        {
+            threads.emplace_back([core] { CPU::cores[core].Run(); });
+        }
+
+        CPU::cores[0].Run();
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    CPU::lockstep = false;
+
+    for (uint16_t core = 0; core < coreCount; ++core)
+    {
+        totalInstructions += CPU::cores[core].instructionCount;
+    }
+}
+
+void Multiprocessor::RunLockstep(uint32_t quantum)
+{
+    bool anyRunning = true;
+
+    while (anyRunning)
+    {
+        anyRunning = false;
+
+        // One turn per running core, in core order
+        for (uint16_t core = 0; core < CPU::coreCount; ++core)
+        {
+            CPU& cpu = CPU::cores[core];
+
+            for (uint32_t i = 0; i < quantum && cpu.shouldBeRunning; ++i)
+            {
+                cpu.ProcessWord();
+            }
+
+            anyRunning |= cpu.shouldBeRunning;
+        }
+    }
+}
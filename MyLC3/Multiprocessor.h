@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include "CPU.h"
+
+// Runs several cores over the shared CPU::memory. Every core is an instance in CPU::cores with its
+// own registers, condition codes, PSR and stack pointers. All cores start at the entry point and
+// tell themselves apart by reading MR_CID; core n starts with its supervisor stack at
+// x3000 - n * CPU::SSP_STRIDE.
+//
+// Memory ordering: the cores access memory with relaxed atomic 16-bit loads and stores, so an
+// access never tears and never races, but accesses of different cores are not ordered with
+// respect to each other. A write to MR_CASX is a sequentially consistent compare-and-swap and
+// orders the core's accesses before and after it, so a lock taken and released with it protects
+// the data behind it. An inter-processor interrupt is taken at the target's next block boundary
+// and everything the sender stored before raising it is visible to the handler.
+//
+// Device ownership: the keyboard and the timer, KBSR, KBDR, TSR and TMR, belong to core 0, which
+// also takes all device interrupts. The other cores read those registers as 0 and their writes are
+// dropped; their GETC and IN traps take keys straight from the keyboard queue. The display and the
+// channels can be used by every core.
+//
+// In free mode every core runs on a host thread of its own. In lockstep mode all cores run on the
+// calling thread and take turns in core order, a fixed number of instructions per turn, unfused, so
+// the interleaving and the result of a run are repeatable. A core polling a device does not sleep
+// then, as it would hold up the others, but a GETC waiting for a key stops every core.
+class Multiprocessor
+{
+public:
+    // Runs coreCount cores from entry until every one of them has stopped. Core 0 runs on the
+    // calling thread. A lockstep quantum of 0 lets the cores run freely.
+    static void Run(uint16_t coreCount, uint16_t entry, uint32_t lockstepQuantum);
+
+    // Instructions executed by all cores of the last Run
+    static uint64_t GetInstructionCount()
+    {
+        return totalInstructions;
+    }
+
+private:
+    static void RunLockstep(uint32_t quantum);
+
+    static uint64_t totalInstructions;
+};
@@ -0,0 +1,343 @@
+#include "ObjectFormat.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+static void WriteString(std::vector<uint16_t>& out, const std::string& text)
+{
+    out.push_back(static_cast<uint16_t>(text.size()));
+
+    for (size_t i = 0; i < text.size(); i += 2)
+    {
+        uint16_t high = static_cast<uint8_t>(text[i]);
+        uint16_t low = i + 1 < text.size() ? static_cast<uint8_t>(text[i + 1]) : 0;
+        out.push_back(static_cast<uint16_t>(high << 8 | low));
+    }
+}
+
+static bool ReadString(const uint16_t*& in, const uint16_t* end, std::string& text)
+{
+    if (in == end)
+        return false;
+
+    size_t length = *in++;
+    if (static_cast<size_t>(end - in) < (length + 1) / 2)
+        return false;
+
+    text.clear();
+    for (size_t i = 0; i < length; ++i)
+        text += static_cast<char>(i % 2 ? in[i / 2] & 0xFF : in[i / 2] >> 8);
+
+    in += (length + 1) / 2;
+    return true;
+}
+
+// Starts a section and returns the index of its length, filled in by EndSection
+static size_t BeginSection(std::vector<uint16_t>& out, ObjectFormat::SECTION tag)
+{
+    out.push_back(static_cast<uint16_t>(tag));
+    out.push_back(0);
+    out.push_back(0);
+    return out.size();
+}
+
+static void EndSection(std::vector<uint16_t>& out, size_t start)
+{
+    uint32_t length = static_cast<uint32_t>(out.size() - start);
+    out[start - 2] = static_cast<uint16_t>(length >> 16);
+    out[start - 1] = static_cast<uint16_t>(length);
+}
+
+std::vector<uint16_t> ObjectFormat::Encode(const ObjectImage& image)
+{
+    std::vector<uint16_t> out(HEADER_WORDS);
+    uint16_t sectionCount = 0;
+
+    for (const ObjectSegment& segment : image.segments)
+    {
+        size_t start = BeginSection(out, OS_SEGMENT);
+        out.push_back(segment.origin);
+        out.insert(out.end(), segment.words.begin(), segment.words.end());
+        EndSection(out, start);
+        ++sectionCount;
+    }
+
+    if (!image.symbols.empty())
+    {
+        size_t start = BeginSection(out, OS_SYMBOLS);
+        for (const ObjectSymbol& symbol : image.symbols)
+        {
+            out.push_back(symbol.address);
+            WriteString(out, symbol.name);
+        }
+        EndSection(out, start);
+        ++sectionCount;
+    }
+
+    if (!image.lines.empty())
+    {
+        size_t start = BeginSection(out, OS_LINES);
+        out.push_back(static_cast<uint16_t>(image.files.size()));
+        for (const std::string& file : image.files)
+            WriteString(out, file);
+
+        for (const ObjectLine& line : image.lines)
+        {
+            out.push_back(line.file);
+            out.push_back(line.line);
+            out.push_back(line.address);
+        }
+        EndSection(out, start);
+        ++sectionCount;
+    }
+
+    uint32_t checksum = Checksum(out.data() + HEADER_WORDS, out.size() - HEADER_WORDS);
+    out[0] = MAGIC_HIGH;
+    out[1] = MAGIC_LOW;
+    out[2] = ORDER_MARK;
+    out[3] = VERSION;
+    out[4] = image.entry;
+    out[5] = sectionCount;
+    out[6] = static_cast<uint16_t>(checksum >> 16);
+    out[7] = static_cast<uint16_t>(checksum);
+
+    return out;
+}
+
+bool ObjectFormat::IsObject(const std::vector<uint16_t>& words)
+{
+    if (words.size() < HEADER_WORDS)
+        return false;
+
+    if (words[2] == ORDER_MARK)
+        return words[0] == MAGIC_HIGH && words[1] == MAGIC_LOW;
+
+    return words[2] == SwapWord(ORDER_MARK) && words[0] == SwapWord(MAGIC_HIGH) && words[1] == SwapWord(MAGIC_LOW);
+}
+
+bool ObjectFormat::Decode(std::vector<uint16_t>& words, ObjectImage& image, std::string& error)
+{
+    if (!IsObject(words))
+    {
+        error = "not an object file";
+        return false;
+    }
+
+    if (words[2] != ORDER_MARK)
+    {
+        for (uint16_t& word : words)
+            word = SwapWord(word);
+    }
+
+    if (words[3] != VERSION)
+    {
+        error = "unsupported version " + std::to_string(words[3]);
+        return false;
+    }
+
+    uint32_t checksum = static_cast<uint32_t>(words[6]) << 16 | words[7];
+    if (Checksum(words.data() + HEADER_WORDS, words.size() - HEADER_WORDS) != checksum)
+    {
+        error = "checksum mismatch";
+        return false;
+    }
+
+    image = ObjectImage();
+    image.entry = words[4];
+
+    const uint16_t* in = words.data() + HEADER_WORDS;
+    const uint16_t* end = words.data() + words.size();
+
+    for (uint16_t section = 0; section < words[5]; ++section)
+    {
+        if (end - in < 3)
+        {
+            error = "truncated section header";
+            return false;
+        }
+
+        uint16_t tag = in[0];
+        uint32_t length = static_cast<uint32_t>(in[1]) << 16 | in[2];
+        in += 3;
+
+        if (static_cast<uint32_t>(end - in) < length)
+        {
+            error = "truncated section";
+            return false;
+        }
+
+        const uint16_t* sectionEnd = in + length;
+
+        if (tag == OS_SEGMENT && length > 0)
+        {
+            ObjectSegment segment;
+            segment.origin = in[0];
+            segment.words.assign(in + 1, sectionEnd);
+            image.segments.push_back(std::move(segment));
+        }
+        else if (tag == OS_SYMBOLS)
+        {
+            while (in < sectionEnd)
+            {
+                ObjectSymbol symbol;
+                symbol.address = *in++;
+                if (!ReadString(in, sectionEnd, symbol.name))
+                {
+                    error = "bad symbol table";
+                    return false;
+                }
+                image.symbols.push_back(std::move(symbol));
+            }
+        }
+        else if (tag == OS_LINES && length > 0)
+        {
+            uint16_t fileCount = *in++;
+            image.files.resize(fileCount);
+
+            for (std::string& file : image.files)
+            {
+                if (!ReadString(in, sectionEnd, file))
+                {
+                    error = "bad line map";
+                    return false;
+                }
+            }
+
+            for (; sectionEnd - in >= 3; in += 3)
+                image.lines.push_back({ in[0], in[1], in[2] });
+        }
+
+        in = sectionEnd;
+    }
+
+    SortSymbols(image);
+    return true;
+}
+
+uint32_t ObjectFormat::Checksum(const uint16_t* words, size_t count)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        hash = (hash ^ (words[i] >> 8)) * 16777619u;
+        hash = (hash ^ (words[i] & 0xFF)) * 16777619u;
+    }
+
+    return hash;
+}
+
+bool ObjectFormat::WriteSymbolFile(const std::string& path, const ObjectImage& image)
+{
+    std::ofstream output(path, std::ios::trunc);
+    if (!output.is_open())
+        return false;
+
+    output << "// Symbol table\n// Scope level 0:\n//\tSymbol Name       Page Address\n//\t----------------  ------------\n";
+    output << std::hex << std::uppercase << std::setfill('0');
+
+    for (const ObjectSymbol& symbol : image.symbols)
+        output << "//\t" << std::left << std::setfill(' ') << std::setw(16) << symbol.name << "  " << std::right << std::setfill('0') << std::setw(4) << symbol.address << '\n';
+
+    output << "\n// Line map\n";
+    for (size_t i = 0; i < image.files.size(); ++i)
+        output << "//\tFile " << i << ": " << image.files[i] << '\n';
+
+    output << "//\tAddress  File  Line\n";
+    for (const ObjectLine& line : image.lines)
+        output << "//\t" << std::setw(4) << line.address << std::dec << "     " << line.file << "     " << line.line << std::hex << '\n';
+
+    return output.good();
+}
+
+bool ObjectFormat::ReadSymbolFile(const std::string& path, ObjectImage& image)
+{
+    std::ifstream input(path);
+    if (!input.is_open())
+        return false;
+
+    bool inLines = false;
+    std::string text;
+
+    while (std::getline(input, text))
+    {
+        if (text.compare(0, 3, "//\t") != 0)
+        {
+            inLines = inLines || text == "// Line map";
+            continue;
+        }
+
+        std::istringstream fields(text.substr(3));
+        std::string first;
+        fields >> first;
+
+        if (first == "Symbol" || first == "Address" || first.empty() || first[0] == '-')
+            continue;
+
+        if (!inLines)
+        {
+            unsigned int address;
+            if (fields >> std::hex >> address)
+                image.symbols.push_back({ first, static_cast<uint16_t>(address) });
+        }
+        else if (first == "File")
+        {
+            size_t separator = text.find(": ");
+            if (separator != std::string::npos)
+                image.files.push_back(text.substr(separator + 2));
+        }
+        else
+        {
+            unsigned int file, line;
+            if (fields >> std::dec >> file >> line)
+                image.lines.push_back({ static_cast<uint16_t>(file), static_cast<uint16_t>(line), static_cast<uint16_t>(std::stoul(first, nullptr, 16)) });
+        }
+    }
+
+    SortSymbols(image);
+    return true;
+}
+
+std::string ObjectFormat::Locate(const ObjectImage& image, uint16_t address)
+{
+    auto next = std::upper_bound(image.symbols.begin(), image.symbols.end(), address,
+        [](uint16_t value, const ObjectSymbol& symbol) { return value < symbol.address; });
+
+    if (next == image.symbols.begin())
+        return "";
+
+    const ObjectSymbol& symbol = *(next - 1);
+    return address == symbol.address ? symbol.name : symbol.name + "+" + std::to_string(address - symbol.address);
+}
+
+uint16_t ObjectFormat::FindLine(const ObjectImage& image, uint16_t address)
+{
+    for (const ObjectLine& line : image.lines)
+    {
+        if (line.address == address)
+            return line.line;
+    }
+
+    return 0;
+}
+
+bool ObjectFormat::FindSymbol(const ObjectImage& image, const std::string& name, uint16_t& address)
+{
+    for (const ObjectSymbol& symbol : image.symbols)
+    {
+        if (symbol.name == name)
+        {
+            address = symbol.address;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ObjectFormat::SortSymbols(ObjectImage& image)
+{
+    std::stable_sort(image.symbols.begin(), image.symbols.end(),
+        [](const ObjectSymbol& left, const ObjectSymbol& right) { return left.address < right.address; });
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Versioned object file, written by LC3_Assembly and loaded by the VM next to the raw format.
+//
+// The file is a sequence of 16-bit words. The byte-order mark tells the reader whether to swap
+// every word, so the file can be written in either byte order. Strings are a word with their length
+// in characters followed by the characters packed two to a word, high byte first.
+//
+// Header:  'LC' '3O' magic, byte-order mark xFEFF, version, entry address, section count,
+//          FNV-1a checksum of every word after the header (high word, low word).
+// Section: tag, length in words (high word, low word), then the payload:
+//   OS_SEGMENT  origin, then the words to place there
+//   OS_SYMBOLS  address and name, repeated
+//   OS_LINES    file count and file names, then file index, line and address, repeated
+// Unknown sections are skipped.
+//
+// The assembler also writes the symbols and the line map into a text sidecar next to the object,
+// starting with the classic LC-3 symbol table, so raw images can be debugged too. Symbols are kept
+// sorted by address.
+struct ObjectSegment
+{
+    uint16_t origin = 0;
+    std::vector<uint16_t> words;
+};
+
+struct ObjectSymbol
+{
+    std::string name;
+    uint16_t address = 0;
+};
+
+struct ObjectLine
+{
+    uint16_t file = 0;
+    uint16_t line = 0;
+    uint16_t address = 0;
+};
+
+struct ObjectImage
+{
+    uint16_t entry = 0;
+    std::vector<ObjectSegment> segments;
+    std::vector<ObjectSymbol> symbols;
+    std::vector<std::string> files;
+    std::vector<ObjectLine> lines;
+};
+
+class ObjectFormat
+{
+public:
+    enum
+    {
+        MAGIC_HIGH = 0x4C43,  /* "LC" */
+        MAGIC_LOW = 0x334F,   /* "3O" */
+        ORDER_MARK = 0xFEFF,
+        VERSION = 2,
+        HEADER_WORDS = 8
+    };
+
+    enum SECTION
+    {
+        OS_SEGMENT = 1,
+        OS_SYMBOLS = 2,
+        OS_LINES = 3
+    };
+
+    // Words in host byte order. Swap every word to write the file in the other order.
+    static std::vector<uint16_t> Encode(const ObjectImage& image);
+
+    // Returns false with a reason if the words are not a valid v2 object. Swaps them in place if
+    // the byte-order mark says so.
+    static bool Decode(std::vector<uint16_t>& words, ObjectImage& image, std::string& error);
+
+    // True if the words start with the v2 magic in either byte order
+    static bool IsObject(const std::vector<uint16_t>& words);
+
+    static uint16_t SwapWord(uint16_t value)
+    {
+        return static_cast<uint16_t>(value << 8 | value >> 8);
+    }
+
+    static uint32_t Checksum(const uint16_t* words, size_t count);
+
+    static bool WriteSymbolFile(const std::string& path, const ObjectImage& image);
+
+    // Reads symbols and lines from a sidecar written by WriteSymbolFile
+    static bool ReadSymbolFile(const std::string& path, ObjectImage& image);
+
+    // Closest symbol at or below address as "LABEL" or "LABEL+offset", empty if there is none
+    static std::string Locate(const ObjectImage& image, uint16_t address);
+
+    // Source line of the instruction at address, 0 if unknown
+    static uint16_t FindLine(const ObjectImage& image, uint16_t address);
+
+    static bool FindSymbol(const ObjectImage& image, const std::string& name, uint16_t& address);
+
+    static void SortSymbols(ObjectImage& image);
+};
@@ -0,0 +1,223 @@
+#include "ReverseDebugger.h"
+#include "CPU.h"
+#include <algorithm>
+
+bool ReverseDebugger::enabled = false;
+uint32_t ReverseDebugger::interval = 16384;
+uint32_t ReverseDebugger::checkpointCount = 16;
+std::deque<ReverseDebugger::Segment> ReverseDebugger::segments;
+uint64_t ReverseDebugger::position = 0;
+ReverseDebugger::State ReverseDebugger::endState;
+
+void ReverseDebugger::Enable(uint32_t interval, uint32_t checkpointCount)
+{
+    ReverseDebugger::interval = std::max<uint32_t>(interval, 1);
+    ReverseDebugger::checkpointCount = std::max<uint32_t>(checkpointCount, 1);
+    segments.clear();
+    enabled = true;
+}
+
+ReverseDebugger::State ReverseDebugger::Capture()
+{
+    State state;
+    std::copy(CPU::cores[0].reg, CPU::cores[0].reg + 9, state.reg);
+    state.lastResult = CPU::cores[0].lastResult;
+    state.psr = CPU::cores[0].psr;
+    state.savedSSP = CPU::cores[0].savedSSP;
+    state.savedUSP = CPU::cores[0].savedUSP;
+    state.device[0] = CPU::memory[CPU::MR_KBSR];
+    state.device[1] = CPU::memory[CPU::MR_KBDR];
+    state.device[2] = CPU::memory[CPU::MR_TSR];
+    state.running = CPU::cores[0].shouldBeRunning;
+    return state;
+}
+
+void ReverseDebugger::Restore(const State& state)
+{
+    std::copy(state.reg, state.reg + 9, CPU::cores[0].reg);
+    CPU::cores[0].lastResult = state.lastResult;
+    CPU::cores[0].psr = state.psr;
+    CPU::cores[0].savedSSP = state.savedSSP;
+    CPU::cores[0].savedUSP = state.savedUSP;
+    CPU::memory[CPU::MR_KBSR] = state.device[0];
+    CPU::memory[CPU::MR_KBDR] = state.device[1];
+    CPU::memory[CPU::MR_TSR] = state.device[2];
+    CPU::cores[0].shouldBeRunning = state.running;
+}
+
+void ReverseDebugger::StartSegment()
+{
+    if (segments.size() == checkpointCount)
+    {
+        // Reuse the oldest checkpoint's buffers rather than allocating new ones
+        segments.push_back(std::move(segments.front()));
+        segments.pop_front();
+    }
+    else
+    {
+        segments.emplace_back();
+        segments.back().records.reserve(interval);
+    }
+
+    Segment& segment = segments.back();
+    segment.firstStep = CPU::cores[0].instructionCount;
+    segment.state = Capture();
+    segment.memory.assign(CPU::memory, CPU::memory + MEM_MAX);
+    segment.records.clear();
+}
+
+void ReverseDebugger::BeginStep()
+{
+    if (segments.empty() || segments.back().records.size() >= interval)
+        StartSegment();
+
+    Record record;
+    record.state = Capture();
+    record.hasStore = CPU::cores[0].GetStoreAddress(record.storeAddress);
+    record.oldValue = record.hasStore ? CPU::memory[record.storeAddress] : 0;
+    record.newValue = 0;
+
+    // An STI through a device register stores to an address that is only known afterwards
+    record.opaque = (CPU::memory[CPU::cores[0].reg[CPU::R_PC]] >> 12) == CPU::OP_STI && !record.hasStore;
+
+    segments.back().records.push_back(record);
+    position = CPU::cores[0].instructionCount + 1;
+}
+
+void ReverseDebugger::EndStep()
+{
+    Record& record = segments.back().records.back();
+
+    if (record.hasStore)
+        record.newValue = CPU::memory[record.storeAddress];
+
+    // Interrupt entry and RTI move the stack and change the PSR; their stack writes are not recorded
+    if (CPU::cores[0].psr != record.state.psr || (CPU::memory[record.state.reg[CPU::R_PC]] >> 12) == CPU::OP_RTI)
+        record.opaque = true;
+
+    position = CPU::cores[0].instructionCount;
+
+    if (record.opaque)
+        StartSegment();
+}
+
+uint64_t ReverseDebugger::GetFirst()
+{
+    return segments.empty() ? position : segments.front().firstStep;
+}
+
+uint64_t ReverseDebugger::GetEnd()
+{
+    return segments.empty() ? position : segments.back().firstStep + segments.back().records.size();
+}
+
+const ReverseDebugger::State& ReverseDebugger::StateBefore(size_t segment, size_t index)
+{
+    if (index < segments[segment].records.size())
+        return segments[segment].records[index].state;
+    if (segment + 1 < segments.size())
+        return segments[segment + 1].state;
+    return endState;
+}
+
+size_t ReverseDebugger::FindSegment(uint64_t step)
+{
+    // The last segment whose first step is not after the given one
+    auto next = std::upper_bound(segments.begin(), segments.end(), step,
+        [](uint64_t value, const Segment& segment) { return value < segment.firstStep; });
+    return static_cast<size_t>(next - segments.begin()) - 1;
+}
+
+bool ReverseDebugger::GoTo(uint64_t step)
+{
+    uint64_t end = GetEnd();
+    if (segments.empty() || step < GetFirst() || step > end)
+        return false;
+
+    if (position == end)
+        endState = Capture();
+
+    size_t target = FindSegment(step);
+    size_t current = FindSegment(position);
+
+    Segment& segment = segments[target];
+    size_t targetIndex = static_cast<size_t>(step - segment.firstStep);
+    size_t currentIndex = static_cast<size_t>(position - segments[current].firstStep);
+
+    // Within one segment, undo or redo record by record as long as no opaque record is crossed
+    size_t low = std::min(targetIndex, currentIndex);
+    size_t high = std::max(targetIndex, currentIndex);
+    bool incremental = current == target;
+
+    for (size_t i = low; incremental && i < high; ++i)
+        incremental = !segment.records[i].opaque;
+
+    if (incremental && targetIndex <= currentIndex)
+    {
+        for (size_t i = currentIndex; i-- > targetIndex;)
+        {
+            const Record& record = segment.records[i];
+            if (record.hasStore)
+                CPU::memory[record.storeAddress] = record.oldValue;
+        }
+    }
+    else
+    {
+        size_t from = incremental ? currentIndex : 0;
+        if (!incremental)
+            std::copy(segment.memory.begin(), segment.memory.end(), CPU::memory);
+
+        for (size_t i = from; i < targetIndex; ++i)
+        {
+            const Record& record = segment.records[i];
+            if (record.hasStore)
+                CPU::memory[record.storeAddress] = record.newValue;
+        }
+    }
+
+    Restore(StateBefore(target, targetIndex));
+    position = step;
+    CPU::cores[0].instructionCount = step;
+    return true;
+}
+
+bool ReverseDebugger::GetStep(uint64_t step, const uint16_t*& registers, int& storeAddress)
+{
+    if (segments.empty() || step < GetFirst() || step >= GetEnd())
+        return false;
+
+    const Segment& segment = segments[FindSegment(step)];
+    const Record& record = segment.records[static_cast<size_t>(step - segment.firstStep)];
+
+    registers = record.state.reg;
+    storeAddress = record.hasStore ? record.storeAddress : -1;
+    return true;
+}
+
+bool ReverseDebugger::ReverseContinue(const std::function<bool(const uint16_t* registers, int storeAddress)>& stop)
+{
+    uint64_t first = GetFirst();
+    if (position <= first)
+        return false;
+
+    // Search the records first, then move the machine once
+    const uint16_t* registers;
+    int storeAddress;
+
+    for (uint64_t step = position; step-- > first;)
+    {
+        if (GetStep(step, registers, storeAddress) && stop(registers, storeAddress))
+            return GoTo(step);
+    }
+
+    GoTo(first);
+    return false;
+}
+
+size_t ReverseDebugger::GetMemoryUsage()
+{
+    size_t bytes = 0;
+    for (const Segment& segment : segments)
+        bytes += segment.memory.capacity() * sizeof(uint16_t) + segment.records.capacity() * sizeof(Record);
+    return bytes;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Execution history for stepping backwards. Every interval steps the whole machine is checkpointed,
+// and between checkpoints each step records the registers before it and the word it stores (old
+// and new value). Going back within the current interval undoes those records; going further
+// restores the nearest earlier checkpoint and replays the recorded effects forward from it, so
+// any jump costs at most one checkpoint restore plus one interval of work. Moving forward within
+// an interval replays records directly. Only the last
+// checkpointCount intervals are kept, which bounds the memory used.
+//
+// Replaying recorded effects instead of re-executing keeps the past exact even though key presses
+// and timer ticks cannot be reproduced.
+class ReverseDebugger
+{
+public:
+    static void Enable(uint32_t interval, uint32_t checkpointCount);
+
+    static bool IsEnabled()
+    {
+        return enabled;
+    }
+
+    // Records the state before the instruction at PC executes. Only called while not replaying.
+    static void BeginStep();
+
+    static void EndStep();
+
+    // Step numbers count executed instructions, the same as the instructionCount of the core
+    static uint64_t GetPosition()
+    {
+        return position;
+    }
+
+    static uint64_t GetFirst();
+
+    static uint64_t GetEnd();
+
+    // Whether the machine shows a past state. Execution has to catch up with the end before it can continue.
+    static bool IsReplaying()
+    {
+        return position < GetEnd();
+    }
+
+    // Moves the machine to the state before the given step, anywhere between GetFirst and GetEnd
+    static bool GoTo(uint64_t step);
+
+    static bool StepBack()
+    {
+        return position > GetFirst() && GoTo(position - 1);
+    }
+
+    static bool StepForward()
+    {
+        return IsReplaying() && GoTo(position + 1);
+    }
+
+    // Looks up a recorded step: the registers before it (R0-R7 and PC) and the address it stored
+    // to, or -1. Valid for steps from GetFirst up to but not including GetEnd.
+    static bool GetStep(uint64_t step, const uint16_t*& registers, int& storeAddress);
+
+    // Steps back until stop returns true for an earlier step and stops before that step. Ends at the
+    // start of the history when nothing matches and returns whether a match was found.
+    static bool ReverseContinue(const std::function<bool(const uint16_t* registers, int storeAddress)>& stop);
+
+    static size_t GetMemoryUsage();
+
+private:
+    // Everything but ordinary memory that one step can change
+    struct State
+    {
+        uint16_t reg[9]; /* R0-R7 and PC */
+        uint32_t lastResult;
+        uint16_t psr;
+        uint16_t savedSSP;
+        uint16_t savedUSP;
+        uint16_t device[3]; /* KBSR, KBDR and TSR */
+        bool running;
+    };
+
+    struct Record
+    {
+        State state;
+        uint16_t storeAddress;
+        uint16_t oldValue;
+        uint16_t newValue;
+        bool hasStore;
+
+        // Memory effects unknown, e.g. an interrupt pushed PSR and PC. Always the last record of a
+        // segment, so it is only ever crossed by restoring a checkpoint.
+        bool opaque;
+    };
+
+    struct Segment
+    {
+        uint64_t firstStep;
+        State state;
+        std::vector<uint16_t> memory;
+        std::vector<Record> records;
+    };
+
+    static State Capture();
+
+    static void Restore(const State& state);
+
+    static void StartSegment();
+
+    static const State& StateBefore(size_t segment, size_t index);
+
+    static size_t FindSegment(uint64_t step);
+
+    static bool enabled;
+
+    static uint32_t interval;
+
+    static uint32_t checkpointCount;
+
+    static std::deque<Segment> segments;
+
+    static uint64_t position;
+
+    // The state at the end of the history, kept while replaying
+    static State endState;
+};
@@ -0,0 +1,76 @@
+#include "Timer.h"
+#include "CPU.h"
+
+std::mutex Timer::timerMutex;
+std::condition_variable Timer::intervalChanged;
+std::chrono::steady_clock::time_point Timer::deadline;
+uint16_t Timer::interval = 0;
+std::atomic<bool> Timer::expired(false);
+std::thread Timer::worker;
+bool Timer::stopping = false;
+
+void Timer::SetInterval(uint16_t milliseconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        interval = milliseconds;
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+        expired.store(false, std::memory_order_release);
+
+        if (!worker.joinable() && milliseconds != 0)
+        {
+            worker = std::thread(Run);
+        }
+    }
+
+    intervalChanged.notify_all();
+}
+
+std::chrono::milliseconds Timer::TimeUntilExpiry()
+{
+    std::lock_guard<std::mutex> lock(timerMutex);
+
+    if (interval == 0)
+        return std::chrono::milliseconds::max();
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return remaining.count() > 0 ? remaining : std::chrono::milliseconds(0);
+}
+
+void Timer::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        stopping = true;
+    }
+
+    intervalChanged.notify_all();
+
+    if (worker.joinable())
+        worker.join();
+}
+
+void Timer::Run()
+{
+    std::unique_lock<std::mutex> lock(timerMutex);
+
+    while (!stopping)
+    {
+        if (interval == 0)
+        {
+            intervalChanged.wait(lock);
+            continue;
+        }
+
+        auto currentDeadline = deadline;
+        if (intervalChanged.wait_until(lock, currentDeadline) == std::cv_status::no_timeout || deadline != currentDeadline)
+            continue; // re-armed, stopped or shut down while sleeping
+
+        deadline += std::chrono::milliseconds(interval);
+        expired.store(true, std::memory_order_release);
+
+        lock.unlock();
+        CPU::RaiseEvent();
+        lock.lock();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+// Host side of the programmable interval timer. A single host thread sleeps until the next deadline
+// and raises a CPU event on expiry, so an armed timer costs nothing between ticks.
+class Timer
+{
+public:
+    // Starts a periodic timer with the given interval. Zero stops it.
+    static void SetInterval(uint16_t milliseconds);
+
+    static bool HasExpired()
+    {
+        return expired.load(std::memory_order_acquire);
+    }
+
+    // Returns whether the timer expired since the last call and acknowledges it.
+    static bool ConsumeExpiry()
+    {
+        return expired.exchange(false, std::memory_order_acq_rel);
+    }
+
+    static std::chrono::milliseconds TimeUntilExpiry();
+
+    // Stops the host thread. Must be called before exit while the timer may be running.
+    static void Shutdown();
+
+private:
+    static void Run();
+
+    static std::mutex timerMutex;
+
+    static std::condition_variable intervalChanged;
+
+    static std::chrono::steady_clock::time_point deadline;
+
+    static uint16_t interval;
+
+    static std::atomic<bool> expired;
+
+    static std::thread worker;
+
+    static bool stopping;
+};
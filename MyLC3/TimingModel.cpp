@@ -0,0 +1,228 @@
+#include "TimingModel.h"
+#include "CPU.h"
+#include "Utilities.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+namespace
+{
+    const char* opcodeNames[16] = { "BR", "ADD", "LD", "ST", "JSR", "AND", "LDR", "STR", "RTI", "NOT", "LDI", "STI", "JMP", "RES", "LEA", "TRAP" };
+
+    const char* costNames[TimingModel::CO_COUNT] = { "execute", "fetch", "memory", "device", "branch", "trap" };
+}
+
+// Defaults loosely follow the LC-3 state machine with a two-cycle memory
+uint16_t TimingModel::opcodeCycles[16] = 
+{
+    1, /* BR */
+    1, /* ADD */
+    1, /* LD */
+    1, /* ST */
+    2, /* JSR */
+    1, /* AND */
+    1, /* LDR */
+    1, /* STR */
+    3, /* RTI */
+    1, /* NOT */
+    1, /* LDI */
+    1, /* STI */
+    1, /* JMP */
+    1, /* RES */
+    1, /* LEA */
+    2  /* TRAP */
+};
+uint16_t TimingModel::fetchCycles = 2;
+uint16_t TimingModel::memoryCycles = 2;
+uint16_t TimingModel::deviceCycles = 5;
+uint16_t TimingModel::branchCycles = 1;
+uint16_t TimingModel::trapCycles = 20;
+double TimingModel::clockMHz = 0;
+bool TimingModel::enabled = false;
+uint64_t TimingModel::cycles[CO_COUNT] = {};
+uint64_t TimingModel::opcodeCount[16] = {};
+uint64_t TimingModel::opcodeTotal[16] = {};
+uint64_t TimingModel::stepStartCycles = 0;
+uint16_t TimingModel::stepOpcode = 0;
+uint16_t TimingModel::stepNextPC = 0;
+
+bool TimingModel::LoadConfig(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "Could not open timing config " << path << '\n';
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string name;
+        double value;
+        if (!(fields >> name))
+            continue;
+
+        if (!(fields >> value) || value < 0)
+        {
+            std::cout << path << ":" << lineNumber << ": expected a non-negative number after " << name << '\n';
+            return false;
+        }
+
+        name = Utilities::ToUpperCase(name);
+        uint16_t cost = static_cast<uint16_t>(value);
+
+        if (name == "FETCH")
+            fetchCycles = cost;
+        else if (name == "MEMORY")
+            memoryCycles = cost;
+        else if (name == "DEVICE")
+            deviceCycles = cost;
+        else if (name == "BRANCH")
+            branchCycles = cost;
+        else if (name == "TRAP_SERVICE")
+            trapCycles = cost;
+        else if (name == "CLOCK_MHZ")
+            clockMHz = value;
+        else
+        {
+            int opcode = 0;
+            while (opcode < 16 && name != opcodeNames[opcode])
+                ++opcode;
+
+            if (opcode == 16)
+            {
+                std::cout << path << ":" << lineNumber << ": unknown timing parameter " << name << '\n';
+                return false;
+            }
+
+            opcodeCycles[opcode] = cost;
+        }
+    }
+
+    return true;
+}
+
+void TimingModel::ChargeAccess(uint16_t address, COST cost)
+{
+    if (address >= CPU::MR_KBSR)
+        cycles[CO_DEVICE] += deviceCycles;
+    else
+        cycles[cost] += cost == CO_FETCH ? fetchCycles : memoryCycles;
+}
+
+void TimingModel::BeginStep()
+{
+    stepStartCycles = GetTotalCycles();
+
+    // Effective addresses are decoded from the state before the instruction runs
+    uint16_t pc = CPU::cores[0].reg[CPU::R_PC];
+    uint16_t instr = CPU::memory[pc];
+    uint16_t opcode = instr >> 12;
+    uint16_t nextPC = pc + 1;
+
+    ChargeAccess(pc, CO_FETCH);
+    cycles[CO_EXECUTE] += opcodeCycles[opcode];
+
+    switch (opcode)
+    {
+    case CPU::OP_LD:
+    case CPU::OP_ST:
+        ChargeAccess(nextPC + CPU::ExtendSign(instr & 0x1FF, 9), CO_MEMORY);
+        break;
+    case CPU::OP_LDR:
+    case CPU::OP_STR:
+        ChargeAccess(CPU::cores[0].reg[(instr >> 6) & 0x7] + CPU::ExtendSign(instr & 0x3F, 6), CO_MEMORY);
+        break;
+    case CPU::OP_LDI:
+    case CPU::OP_STI:
+    {
+        uint16_t pointer = nextPC + CPU::ExtendSign(instr & 0x1FF, 9);
+        ChargeAccess(pointer, CO_MEMORY);
+        ChargeAccess(CPU::memory[pointer], CO_MEMORY);
+        break;
+    }
+    case CPU::OP_RTI:
+        // PC and PSR are popped off the supervisor stack
+        cycles[CO_MEMORY] += 2 * memoryCycles;
+        break;
+    case CPU::OP_TRAP:
+        if (CPU::trapMode == CPU::TM_OS)
+            ChargeAccess(instr & 0xFF, CO_MEMORY);
+        else
+            cycles[CO_TRAP] += trapCycles;
+        break;
+    default:
+        break;
+    }
+
+    stepOpcode = opcode;
+    stepNextPC = nextPC;
+}
+
+void TimingModel::EndStep()
+{
+    if (CPU::cores[0].reg[CPU::R_PC] != stepNextPC)
+        cycles[CO_BRANCH] += branchCycles;
+
+    ++opcodeCount[stepOpcode];
+    opcodeTotal[stepOpcode] += GetTotalCycles() - stepStartCycles;
+}
+
+void TimingModel::Reset()
+{
+    std::fill(std::begin(cycles), std::end(cycles), 0);
+    std::fill(std::begin(opcodeCount), std::end(opcodeCount), 0);
+    std::fill(std::begin(opcodeTotal), std::end(opcodeTotal), 0);
+}
+
+uint64_t TimingModel::GetTotalCycles()
+{
+    return std::accumulate(std::begin(cycles), std::end(cycles), uint64_t(0));
+}
+
+void TimingModel::PrintReport(std::ostream& stream)
+{
+    uint64_t total = GetTotalCycles();
+    uint64_t instructions = std::accumulate(std::begin(opcodeCount), std::end(opcodeCount), uint64_t(0));
+
+    if (instructions == 0)
+        return;
+
+    std::ios::fmtflags savedFlags = stream.flags();
+    std::streamsize savedPrecision = stream.precision();
+
+    stream << std::fixed << std::setprecision(3);
+    stream << "Cycles: " << total << ", instructions: " << instructions << ", CPI: " << double(total) / instructions << '\n';
+
+    if (clockMHz > 0)
+        stream << "Estimated time at " << clockMHz << " MHz: " << total / clockMHz / 1e6 << " s" << '\n';
+
+    stream << std::setprecision(1) << '\n' << std::left << std::setw(10) << "cycles" << std::right << std::setw(16) << "total" << std::setw(10) << "%" << '\n';
+    for (int i = 0; i < CO_COUNT; ++i)
+    {
+        stream << std::left << std::setw(10) << costNames[i] << std::right << std::setw(16) << cycles[i]
+            << std::setw(10) << 100.0 * cycles[i] / total << '\n';
+    }
+
+    stream << std::setprecision(2) << '\n' << std::left << std::setw(10) << "opcode" << std::right << std::setw(16) << "count"
+        << std::setw(16) << "cycles" << std::setw(10) << "CPI" << '\n';
+    for (int i = 0; i < 16; ++i)
+    {
+        if (opcodeCount[i] == 0)
+            continue;
+
+        stream << std::left << std::setw(10) << opcodeNames[i] << std::right << std::setw(16) << opcodeCount[i]
+            << std::setw(16) << opcodeTotal[i] << std::setw(10) << double(opcodeTotal[i]) / opcodeCount[i] << '\n';
+    }
+
+    stream.flags(savedFlags);
+    stream.precision(savedPrecision);
+}
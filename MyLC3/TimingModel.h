@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Optional cycle estimate for a simple multi-cycle LC-3. Each instruction is charged a base cost
+// for its opcode plus the cost of every memory access it makes. When enabled, CPU::ProcessProgram
+// runs the separate instrumented loop, so the functional loops are untouched when it is off.
+class TimingModel
+{
+public:
+    enum COST
+    {
+        CO_EXECUTE = 0, /* base cost of the opcode */
+        CO_FETCH,       /* instruction fetch */
+        CO_MEMORY,      /* data loads and stores */
+        CO_DEVICE,      /* accesses to device registers */
+        CO_BRANCH,      /* redirected fetch after a taken branch, jump, call or trap */
+        CO_TRAP,        /* trap routines serviced natively by the VM */
+        CO_COUNT
+    };
+
+    static bool IsEnabled()
+    {
+        return enabled;
+    }
+
+    static void Enable()
+    {
+        enabled = true;
+    }
+
+    // Reads "name value" lines: an opcode name (ADD, LDR, ...) sets its base cost, and fetch, memory,
+    // device, branch, trap_service and clock_mhz set the remaining parameters. # starts a comment.
+    static bool LoadConfig(const std::string& path);
+
+    // Charges the instruction at PC before it executes
+    static void BeginStep();
+
+    // Charges the redirect penalty once the instruction has executed
+    static void EndStep();
+
+    static void Reset();
+
+    static uint64_t GetTotalCycles();
+
+    static void PrintReport(std::ostream& stream);
+
+    static uint16_t opcodeCycles[16];
+
+    static uint16_t fetchCycles;
+
+    static uint16_t memoryCycles;
+
+    static uint16_t deviceCycles;
+
+    static uint16_t branchCycles;
+
+    static uint16_t trapCycles;
+
+    static double clockMHz;
+
+private:
+    static void ChargeAccess(uint16_t address, COST cost);
+
+    static bool enabled;
+
+    static uint64_t cycles[CO_COUNT];
+
+    static uint64_t opcodeCount[16];
+
+    static uint64_t opcodeTotal[16];
+
+    static uint64_t stepStartCycles;
+
+    static uint16_t stepOpcode;
+
+    static uint16_t stepNextPC;
+};
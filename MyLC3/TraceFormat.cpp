@@ -0,0 +1,257 @@
+#include "TraceFormat.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    const char MAGIC[4] = { 'L', 'C', '3', 'T' };
+
+    const size_t MIN_MATCH = 4;
+
+    const int HASH_BITS = 14;
+
+    uint32_t Hash(const uint8_t* p)
+    {
+        uint32_t word;
+        std::memcpy(&word, p, 4);
+        return (word * 2654435761u) >> (32 - HASH_BITS);
+    }
+}
+
+bool TraceFormat::ReadVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 32 && in < end; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Greedy LZ77: a sequence is varint literal count, the literals, varint match length (0 ends the
+// block) and varint match distance. Traces of loops repeat almost byte for byte, so this does well.
+void TraceFormat::Compress(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out)
+{
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+    const uint8_t* base = raw.data();
+    size_t size = raw.size();
+    size_t literalStart = 0;
+    size_t i = 0;
+
+    while (i + MIN_MATCH <= size)
+    {
+        uint32_t hash = Hash(base + i);
+        uint32_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(i);
+
+        if (candidate == UINT32_MAX || std::memcmp(base + candidate, base + i, MIN_MATCH) != 0)
+        {
+            ++i;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (i + length < size && base[candidate + length] == base[i + length])
+            ++length;
+
+        WriteVarint(out, static_cast<uint32_t>(i - literalStart));
+        out.insert(out.end(), base + literalStart, base + i);
+        WriteVarint(out, static_cast<uint32_t>(length));
+        WriteVarint(out, static_cast<uint32_t>(i - candidate));
+
+        i += length;
+        literalStart = i;
+    }
+
+    WriteVarint(out, static_cast<uint32_t>(size - literalStart));
+    out.insert(out.end(), base + literalStart, base + size);
+    WriteVarint(out, 0);
+}
+
+bool TraceFormat::Decompress(const uint8_t* in, size_t size, size_t rawSize, std::vector<uint8_t>& out)
+{
+    const uint8_t* end = in + size;
+    out.clear();
+    out.reserve(rawSize);
+
+    while (true)
+    {
+        uint32_t literals, length, distance;
+        if (!ReadVarint(in, end, literals) || literals > static_cast<size_t>(end - in))
+            return false;
+
+        out.insert(out.end(), in, in + literals);
+        in += literals;
+
+        if (!ReadVarint(in, end, length))
+            return false;
+        if (length == 0)
+            return out.size() == rawSize;
+
+        if (!ReadVarint(in, end, distance) || distance == 0 || distance > out.size() || out.size() + length > rawSize)
+            return false;
+
+        // Byte by byte, matches may overlap their own output
+        size_t from = out.size() - distance;
+        for (uint32_t k = 0; k < length; ++k)
+            out.push_back(out[from + k]);
+    }
+}
+
+void TraceEncoder::Reset()
+{
+    nextPC = 0;
+    std::fill(std::begin(registers), std::end(registers), 0);
+    lastAddress = 0;
+}
+
+void TraceEncoder::Encode(const TraceRecord& record, std::vector<uint8_t>& out)
+{
+    uint8_t flags = record.flags;
+    if (record.pc != nextPC)
+        flags |= TraceFormat::TF_JUMP;
+
+    out.push_back(flags);
+    out.push_back(static_cast<uint8_t>(record.instruction));
+    out.push_back(static_cast<uint8_t>(record.instruction >> 8));
+
+    if (flags & TraceFormat::TF_JUMP)
+        TraceFormat::WriteVarint(out, TraceFormat::ZigZag(record.pc - nextPC));
+
+    if (flags & TraceFormat::TF_DEST)
+    {
+        uint16_t& previous = registers[flags & TraceFormat::TF_DEST_MASK];
+        TraceFormat::WriteVarint(out, TraceFormat::ZigZag(record.destValue - previous));
+        previous = record.destValue;
+    }
+
+    if (flags & (TraceFormat::TF_LOAD | TraceFormat::TF_STORE))
+    {
+        TraceFormat::WriteVarint(out, TraceFormat::ZigZag(record.address - lastAddress));
+        lastAddress = record.address;
+        out.push_back(static_cast<uint8_t>(record.value));
+        out.push_back(static_cast<uint8_t>(record.value >> 8));
+    }
+
+    nextPC = record.pc + 1;
+}
+
+bool TraceReader::Open(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        error = "could not open " + path;
+        return false;
+    }
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (data.size() < 6 || std::memcmp(data.data(), MAGIC, 4) != 0)
+    {
+        error = path + " is not an LC-3 trace";
+        return false;
+    }
+
+    uint16_t version = data[4] | (data[5] << 8);
+    if (version != TraceFormat::VERSION)
+    {
+        error = "unsupported trace version " + std::to_string(version);
+        return false;
+    }
+
+    position = 6;
+    return true;
+}
+
+bool TraceReader::ReadBlock(std::vector<TraceRecord>& records)
+{
+    records.clear();
+    if (position >= data.size())
+        return false;
+
+    const uint8_t* in = data.data() + position;
+    const uint8_t* end = data.data() + data.size();
+    uint32_t count, rawSize, storedSize;
+
+    if (!TraceFormat::ReadVarint(in, end, count) || !TraceFormat::ReadVarint(in, end, rawSize)
+        || !TraceFormat::ReadVarint(in, end, storedSize) || storedSize > static_cast<size_t>(end - in))
+    {
+        error = "truncated block header";
+        return false;
+    }
+
+    std::vector<uint8_t> raw;
+    if (!TraceFormat::Decompress(in, storedSize, rawSize, raw))
+    {
+        error = "damaged block";
+        return false;
+    }
+
+    position = (in + storedSize) - data.data();
+    storedBytes += storedSize;
+    rawBytes += rawSize;
+
+    const uint8_t* p = raw.data();
+    const uint8_t* rawEnd = p + raw.size();
+    uint16_t nextPC = 0;
+    uint16_t registers[8] = {};
+    uint16_t lastAddress = 0;
+
+    records.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        TraceRecord record;
+        uint32_t value;
+
+        if (rawEnd - p < 3)
+            break;
+
+        record.flags = p[0];
+        record.instruction = p[1] | (p[2] << 8);
+        p += 3;
+
+        record.pc = nextPC;
+        if (record.flags & TraceFormat::TF_JUMP)
+        {
+            if (!TraceFormat::ReadVarint(p, rawEnd, value))
+                break;
+            record.pc += TraceFormat::UnZigZag(value);
+        }
+
+        if (record.flags & TraceFormat::TF_DEST)
+        {
+            if (!TraceFormat::ReadVarint(p, rawEnd, value))
+                break;
+            uint16_t& previous = registers[record.flags & TraceFormat::TF_DEST_MASK];
+            previous += TraceFormat::UnZigZag(value);
+            record.destValue = previous;
+        }
+
+        if (record.flags & (TraceFormat::TF_LOAD | TraceFormat::TF_STORE))
+        {
+            if (!TraceFormat::ReadVarint(p, rawEnd, value) || rawEnd - p < 2)
+                break;
+            lastAddress += TraceFormat::UnZigZag(value);
+            record.address = lastAddress;
+            record.value = p[0] | (p[1] << 8);
+            p += 2;
+        }
+
+        nextPC = record.pc + 1;
+        records.push_back(record);
+    }
+
+    if (records.size() != count)
+    {
+        error = "damaged record";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary execution trace, shared by the VM's TraceWriter and the LC3_Trace reader.
+//
+// File:   "LC3T" magic, u16 version, then blocks until the end of the file.
+// Block:  varint record count, varint raw size, varint stored size, then the LZ compressed records.
+// Record: flags byte (TF_*, low three bits are the destination register), u16 instruction,
+//         then the optional fields in this order: zigzag PC delta from the sequential PC when TF_JUMP,
+//         zigzag delta from the register's previous value when TF_DEST, and zigzag address delta
+//         plus u16 value when TF_LOAD or TF_STORE.
+// Delta state starts from zero in every block, so blocks decode on their own.
+struct TraceRecord
+{
+    uint16_t pc = 0;
+    uint16_t instruction = 0;
+    uint8_t flags = 0;
+    uint16_t destValue = 0;
+    uint16_t address = 0;
+    uint16_t value = 0;
+};
+
+class TraceFormat
+{
+public:
+    enum
+    {
+        TF_DEST_MASK = 0x07,
+        TF_DEST = 1 << 3,  /* destination register written */
+        TF_LOAD = 1 << 4,  /* memory read, value is what was loaded */
+        TF_STORE = 1 << 5, /* memory write, value is what was stored */
+        TF_JUMP = 1 << 6   /* PC is not the previous PC + 1 */
+    };
+
+    static const uint16_t VERSION = 1;
+
+    static const size_t BLOCK_SIZE = 1 << 16;
+
+    static void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    static bool ReadVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value);
+
+    // Maps a 16-bit delta to small unsigned numbers for both directions
+    static uint32_t ZigZag(uint16_t delta)
+    {
+        int16_t signedDelta = static_cast<int16_t>(delta);
+        return static_cast<uint32_t>((signedDelta << 1) ^ (signedDelta >> 15)) & 0x1FFFF;
+    }
+
+    static uint16_t UnZigZag(uint32_t value)
+    {
+        return static_cast<uint16_t>((value >> 1) ^ (0u - (value & 1)));
+    }
+
+    static void Compress(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out);
+
+    static bool Decompress(const uint8_t* in, size_t size, size_t rawSize, std::vector<uint8_t>& out);
+};
+
+// Delta encoder state for one block
+class TraceEncoder
+{
+public:
+    void Reset();
+
+    void Encode(const TraceRecord& record, std::vector<uint8_t>& out);
+
+private:
+    uint16_t nextPC = 0;
+    uint16_t registers[8] = {};
+    uint16_t lastAddress = 0;
+};
+
+// Reads a trace file block by block
+class TraceReader
+{
+public:
+    bool Open(const std::string& path);
+
+    // Decodes the next block, returns false at the end of the file or on a damaged block
+    bool ReadBlock(std::vector<TraceRecord>& records);
+
+    const std::string& GetError() const
+    {
+        return error;
+    }
+
+    uint64_t GetStoredBytes() const
+    {
+        return storedBytes;
+    }
+
+    uint64_t GetRawBytes() const
+    {
+        return rawBytes;
+    }
+
+private:
+    std::vector<uint8_t> data;
+    size_t position = 0;
+    std::string error;
+    uint64_t storedBytes = 0;
+    uint64_t rawBytes = 0;
+};
@@ -0,0 +1,177 @@
+#include "TraceWriter.h"
+#include "CPU.h"
+#include <iostream>
+
+bool TraceWriter::enabled = false;
+std::ofstream TraceWriter::file;
+TraceEncoder TraceWriter::encoder;
+TraceRecord TraceWriter::current;
+std::vector<uint8_t> TraceWriter::filling;
+uint32_t TraceWriter::fillingCount = 0;
+std::vector<uint8_t> TraceWriter::pending;
+uint32_t TraceWriter::pendingCount = 0;
+bool TraceWriter::pendingFull = false;
+bool TraceWriter::stopping = false;
+std::mutex TraceWriter::queueMutex;
+std::condition_variable TraceWriter::queueChanged;
+std::thread TraceWriter::worker;
+uint64_t TraceWriter::recordCount = 0;
+
+bool TraceWriter::Open(const std::string& path)
+{
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "Could not open trace file " << path << '\n';
+        return false;
+    }
+
+    const char header[6] = { 'L', 'C', '3', 'T', static_cast<char>(TraceFormat::VERSION & 0xFF), static_cast<char>(TraceFormat::VERSION >> 8) };
+    file.write(header, sizeof(header));
+
+    // Leave room for the largest record so a block never reallocates while filling
+    filling.reserve(TraceFormat::BLOCK_SIZE + 16);
+    pending.reserve(TraceFormat::BLOCK_SIZE + 16);
+    encoder.Reset();
+
+    stopping = false;
+    worker = std::thread(Run);
+    enabled = true;
+    return true;
+}
+
+void TraceWriter::BeginStep()
+{
+    uint16_t pc = CPU::cores[0].reg[CPU::R_PC];
+
+    current.pc = pc;
+    current.instruction = CPU::memory[pc];
+    current.flags = 0;
+
+    switch (current.instruction >> 12)
+    {
+    case CPU::OP_ADD:
+    case CPU::OP_AND:
+    case CPU::OP_NOT:
+    case CPU::OP_LEA:
+        current.flags = TraceFormat::TF_DEST | ((current.instruction >> 9) & 0x7);
+        break;
+    case CPU::OP_LD:
+    case CPU::OP_LDI:
+    case CPU::OP_LDR:
+        current.flags = TraceFormat::TF_DEST | ((current.instruction >> 9) & 0x7);
+        if (CPU::cores[0].GetLoadAddress(current.address))
+            current.flags |= TraceFormat::TF_LOAD;
+        break;
+    case CPU::OP_ST:
+    case CPU::OP_STI:
+    case CPU::OP_STR:
+        if (CPU::cores[0].GetStoreAddress(current.address))
+            current.flags = TraceFormat::TF_STORE;
+        break;
+    case CPU::OP_JSR:
+        current.flags = TraceFormat::TF_DEST | static_cast<int>(CPU::R_R7);
+        break;
+    case CPU::OP_TRAP:
+        // Native trap routines hand their result back in R0, OS ones are traced instruction by instruction
+        current.flags = TraceFormat::TF_DEST | static_cast<int>(CPU::trapMode == CPU::TM_NATIVE ? CPU::R_R0 : CPU::R_R7);
+        break;
+    default:
+        break;
+    }
+}
+
+void TraceWriter::EndStep()
+{
+    if (current.flags & TraceFormat::TF_DEST)
+        current.destValue = CPU::cores[0].reg[current.flags & TraceFormat::TF_DEST_MASK];
+
+    if (current.flags & TraceFormat::TF_LOAD)
+        current.value = current.destValue;
+    else if (current.flags & TraceFormat::TF_STORE)
+        current.value = CPU::memory[current.address];
+
+    encoder.Encode(current, filling);
+    ++fillingCount;
+    ++recordCount;
+
+    if (filling.size() >= TraceFormat::BLOCK_SIZE)
+        SubmitBlock();
+}
+
+void TraceWriter::SubmitBlock()
+{
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueChanged.wait(lock, [] { return !pendingFull; });
+
+        filling.swap(pending);
+        pendingCount = fillingCount;
+        pendingFull = true;
+    }
+
+    queueChanged.notify_all();
+
+    filling.clear();
+    fillingCount = 0;
+    encoder.Reset();
+}
+
+void TraceWriter::Run()
+{
+    std::vector<uint8_t> block;
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> header;
+    block.reserve(TraceFormat::BLOCK_SIZE + 16);
+
+    while (true)
+    {
+        uint32_t count;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [] { return pendingFull || stopping; });
+
+            if (!pendingFull)
+                break;
+
+            block.swap(pending);
+            count = pendingCount;
+            pendingFull = false;
+        }
+
+        // The CPU can start filling the next block while this one is compressed
+        queueChanged.notify_all();
+
+        compressed.clear();
+        TraceFormat::Compress(block, compressed);
+
+        header.clear();
+        TraceFormat::WriteVarint(header, count);
+        TraceFormat::WriteVarint(header, static_cast<uint32_t>(block.size()));
+        TraceFormat::WriteVarint(header, static_cast<uint32_t>(compressed.size()));
+
+        file.write(reinterpret_cast<const char*>(header.data()), header.size());
+        file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+        block.clear();
+    }
+}
+
+void TraceWriter::Close()
+{
+    if (!enabled)
+        return;
+
+    if (fillingCount)
+        SubmitBlock();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+
+    queueChanged.notify_all();
+    worker.join();
+
+    file.close();
+    enabled = false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TraceFormat.h"
+
+// Records every executed instruction into a TraceFormat file. The CPU thread only delta-encodes
+// records into the block it is filling; full blocks are handed to a host thread that compresses
+// and writes them, so tracing does not wait on the disk unless the writer falls a whole block behind.
+class TraceWriter
+{
+public:
+    static bool Open(const std::string& path);
+
+    static bool IsEnabled()
+    {
+        return enabled;
+    }
+
+    // Captures PC, instruction and operand addresses before the instruction executes
+    static void BeginStep();
+
+    // Captures the results and appends the record
+    static void EndStep();
+
+    // Writes the last block and stops the host thread. Must be called before exit while tracing.
+    static void Close();
+
+    static uint64_t GetRecordCount()
+    {
+        return recordCount;
+    }
+
+private:
+    static void Run();
+
+    static void SubmitBlock();
+
+    static bool enabled;
+
+    static std::ofstream file;
+
+    static TraceEncoder encoder;
+
+    static TraceRecord current;
+
+    static std::vector<uint8_t> filling;
+
+    static uint32_t fillingCount;
+
+    static std::vector<uint8_t> pending;
+
+    static uint32_t pendingCount;
+
+    static bool pendingFull;
+
+    static bool stopping;
+
+    static std::mutex queueMutex;
+
+    static std::condition_variable queueChanged;
+
+    static std::thread worker;
+
+    static uint64_t recordCount;
+};
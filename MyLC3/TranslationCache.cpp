@@ -0,0 +1,254 @@
+#include "TranslationCache.h"
+#include "CPU.h"
+#include "ControlFlowGraph.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint8_t emptyPlan[MEM_MAX];
+
+uint8_t* TranslationCache::plan = emptyPlan;
+std::vector<uint8_t> TranslationCache::builtPlan;
+void* TranslationCache::mapping = nullptr;
+size_t TranslationCache::mappingSize = 0;
+bool TranslationCache::enabled = false;
+bool TranslationCache::hit = false;
+std::string TranslationCache::path;
+
+uint64_t TranslationCache::ComputeKey(uint16_t entry)
+{
+    // FNV-1a over the image bytes, wide enough that a different image never picks up this plan
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(CPU::memory);
+    uint64_t key = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(CPU::memory); ++i)
+        key = (key ^ bytes[i]) * 1099511628211ull;
+
+    key = (key ^ entry) * 1099511628211ull;
+    key = (key ^ CPU::trapMode) * 1099511628211ull;
+    return key;
+}
+
+TranslationCache::PLAN TranslationCache::Match(const uint16_t* memory, uint32_t address, uint32_t& length)
+{
+    if (address + 2 >= CPU::MR_KBSR)
+        return PL_NONE;
+
+    uint16_t instr = memory[address];
+    uint16_t next = memory[address + 1];
+    uint16_t third = memory[address + 2];
+    uint16_t destinationRegister = (instr >> 9) & 0x7;
+    uint16_t baseRegister = (instr >> 6) & 0x7;
+    length = 2;
+
+    // The same sequences CPU::ProcessFusedWord matches at run time
+    switch (instr >> 12)
+    {
+    case CPU::OP_ADD:
+        if (((instr >> 5) & 1) && (next >> 12) == CPU::OP_BR)
+            return PL_ADD_BR;
+        break;
+    case CPU::OP_AND:
+        if ((instr & 0x3F) == 0x20 && (next >> 12) == CPU::OP_ADD && ((next >> 5) & 1)
+            && ((next >> 9) & 0x7) == destinationRegister && ((next >> 6) & 0x7) == destinationRegister)
+            return PL_CLEAR_ADD;
+        break;
+    case CPU::OP_LDR:
+        if ((next >> 12) == CPU::OP_ADD && ((next >> 5) & 1) && destinationRegister != baseRegister
+            && ((next >> 9) & 0x7) == destinationRegister && ((next >> 6) & 0x7) == destinationRegister
+            && third == ((CPU::OP_STR << 12) | (instr & 0x0FFF)))
+        {
+            length = 3;
+            return PL_INCREMENT;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return PL_NONE;
+}
+
+void TranslationCache::Build(uint16_t entry, std::vector<uint8_t>& out)
+{
+    const uint16_t* memory = CPU::memory;
+    std::vector<uint16_t> roots = { entry };
+
+    // OS trap routines are only reached through the vector table
+    if (CPU::trapMode == CPU::TM_OS)
+    {
+        for (uint16_t vector = CPU::TRAP_GETC; vector <= CPU::TRAP_HALT; ++vector)
+        {
+            if (memory[vector])
+                roots.push_back(memory[vector]);
+        }
+    }
+
+    ControlFlowGraph graph;
+    graph.Analyze(memory, roots);
+
+    out.assign(MEM_MAX, PL_NONE);
+
+    for (uint32_t address = 0; address + 2 < CPU::MR_KBSR; ++address)
+    {
+        uint32_t length = 0;
+        PLAN kind = Match(memory, address, length);
+        if (kind == PL_NONE)
+            continue;
+
+        bool allCode = true;
+        for (uint32_t word = address; word < address + length; ++word)
+            allCode = allCode && graph.GetKind(static_cast<uint16_t>(word)) == ControlFlowGraph::WK_CODE;
+
+        if (!allCode)
+            continue;
+
+        out[address] |= kind;
+        for (uint32_t word = address; word < address + length; ++word)
+            out[word] |= PL_COVERED;
+    }
+}
+
+bool TranslationCache::Validate(const uint8_t* loaded)
+{
+    // CPU::ProcessPlannedWord trusts the plan, so a site that does not hold its sequence, or is not
+    // covered and so would not be dropped by a store, must never reach it
+    for (uint32_t address = 0; address < MEM_MAX; ++address)
+    {
+        uint8_t kind = loaded[address] & PL_KIND;
+        if (kind == PL_NONE)
+            continue;
+
+        uint32_t length = 0;
+        if (Match(CPU::memory, address, length) != kind)
+            return false;
+
+        for (uint32_t word = address; word < address + length; ++word)
+        {
+            if (!(loaded[word] & PL_COVERED))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool TranslationCache::Map(uint64_t key)
+{
+    size_t expectedSize = sizeof(Header) + MEM_MAX;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    HANDLE fileMapping = nullptr;
+    if (GetFileSizeEx(file, &size) && static_cast<size_t>(size.QuadPart) == expectedSize)
+        fileMapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+
+    // Copy-on-write, so invalidating a sequence never reaches the file
+    void* view = fileMapping ? MapViewOfFile(fileMapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+
+    if (fileMapping)
+        CloseHandle(fileMapping);
+    CloseHandle(file);
+
+    if (!view)
+        return false;
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    void* view = MAP_FAILED;
+    if (fstat(file, &status) == 0 && static_cast<size_t>(status.st_size) == expectedSize)
+        view = mmap(nullptr, expectedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+
+    close(file);
+
+    if (view == MAP_FAILED)
+        return false;
+#endif
+
+    mapping = view;
+    mappingSize = expectedSize;
+
+    const Header* header = static_cast<const Header*>(view);
+    const uint8_t* loaded = static_cast<const uint8_t*>(view) + sizeof(Header);
+    if (header->magic != MAGIC || header->engineVersion != ENGINE_VERSION || header->key != key || header->planSize != MEM_MAX
+        || !Validate(loaded))
+    {
+        Close();
+        return false;
+    }
+
+    plan = static_cast<uint8_t*>(view) + sizeof(Header);
+    return true;
+}
+
+bool TranslationCache::Store(uint64_t key, const std::vector<uint8_t>& built)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        Header header = { MAGIC, ENGINE_VERSION, key, MEM_MAX, 0 };
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(built.data()), built.size());
+
+        if (!output.good())
+            return false;
+    }
+
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
+
+bool TranslationCache::Open(const std::string& directory, uint16_t entry)
+{
+    Close();
+
+    uint64_t key = ComputeKey(entry);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llX.lc3plan", static_cast<unsigned long long>(key));
+    path = (std::filesystem::path(directory) / name).string();
+
+    hit = Map(key);
+    enabled = true;
+
+    if (hit)
+        return true;
+
+    Build(entry, builtPlan);
+    plan = builtPlan.data();
+
+    return Store(key, builtPlan);
+}
+
+void TranslationCache::Close()
+{
+    if (mapping)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, mappingSize);
+#endif
+        mapping = nullptr;
+    }
+
+    builtPlan.clear();
+    plan = emptyPlan;
+    enabled = false;
+    hit = false;
+}
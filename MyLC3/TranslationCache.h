@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Keeps the fusion plan of a loaded image on disk, so later runs of the same image start with it.
+//
+// The plan has one byte per address. A code word where a fusable sequence starts holds its kind,
+// and every word that belongs to a planned sequence has PL_COVERED set. The plan is built from
+// ControlFlowGraph, so data words that only look like such a sequence are left out. CPU::Run
+// executes planned sequences without matching them again, and stores into covered words drop the
+// sequences they belong to, so code written at run time is still executed correctly.
+//
+// Files are named after a 64-bit hash of the whole address space after loading, the entry point
+// and the trap mode, and start with a header holding the engine version and the same key. A warm
+// start hashes memory, checks the header and the file size, maps the file copy-on-write, and
+// checks that every planned site still holds the sequence its kind stands for. A missing, stale
+// or damaged file is rebuilt and written under a temporary name first, so a crashed writer never
+// leaves a file that passes the check.
+class TranslationCache
+{
+public:
+    enum PLAN
+    {
+        PL_NONE = 0,
+        PL_ADD_BR,        /* ADD R, R, #imm; BR */
+        PL_CLEAR_ADD,     /* AND R, R, #0; ADD R, R, #imm */
+        PL_INCREMENT,     /* LDR R, B, #off; ADD R, R, #imm; STR R, B, #off */
+        PL_KIND = 0x7F,
+        PL_COVERED = 0x80
+    };
+
+    enum
+    {
+        MAGIC = 0x504C334C, /* "L3LP" */
+        ENGINE_VERSION = 2
+    };
+
+    // Loads the plan for the image in CPU::memory from directory, or builds and stores it there.
+    // Returns false if the plan could not be stored. It is still used for this run.
+    static bool Open(const std::string& directory, uint16_t entry);
+
+    static void Close();
+
+    static bool IsEnabled()
+    {
+        return enabled;
+    }
+
+    // True if the plan came from disk
+    static bool WasHit()
+    {
+        return hit;
+    }
+
+    static const std::string& GetPath()
+    {
+        return path;
+    }
+
+    // Drops every planned sequence the word at address belongs to. Cheap enough to be called on
+    // every store to a covered word.
+    static void Invalidate(uint16_t address)
+    {
+        plan[address] &= PL_COVERED;
+        plan[static_cast<uint16_t>(address - 1)] &= PL_COVERED;
+        plan[static_cast<uint16_t>(address - 2)] &= PL_COVERED;
+    }
+
+    // All zero while disabled
+    static uint8_t* plan;
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t engineVersion;
+        uint64_t key;
+        uint32_t planSize;
+        uint32_t reserved;
+    };
+
+    static uint64_t ComputeKey(uint16_t entry);
+
+    // The sequence that starts at address in memory, judged by its words alone, and how many words it covers
+    static PLAN Match(const uint16_t* memory, uint32_t address, uint32_t& length);
+
+    static void Build(uint16_t entry, std::vector<uint8_t>& out);
+
+    // True if every planned site in a loaded plan matches memory and is fully covered
+    static bool Validate(const uint8_t* loaded);
+
+    static bool Map(uint64_t key);
+
+    static bool Store(uint64_t key, const std::vector<uint8_t>& built);
+
+    static std::vector<uint8_t> builtPlan;
+
+    static void* mapping;
+
+    static size_t mappingSize;
+
+    static bool enabled;
+
+    static bool hit;
+
+    static std::string path;
+};
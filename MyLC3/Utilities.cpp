@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include <iostream>
+#include "ObjectFormat.h"
 #include "Utilities.h"
 
 using std::vector;
@@ -16,14 +18,61 @@ uint16_t Utilities::LoadFileInto(string filename, uint16_t* memory, int memorySi
 	}
 
 	input.seekg(0, input.end);
-	uint16_t lengthOfFile = input.tellg() / 2;
+	size_t lengthOfFile = static_cast<size_t>(input.tellg()) / 2;
 	input.seekg(0, input.beg);
 
-	uint16_t startAddress;
-	input.read(reinterpret_cast<char*>(&startAddress), 2);
+	vector<uint16_t> words(lengthOfFile);
+	input.read(reinterpret_cast<char*>(words.data()), lengthOfFile * sizeof(uint16_t));
+
+	if (!input.good())
+	{
+		perror("LOAD NOT OK");
+	}
+
+	input.close();
+
+	// Object files carry their own byte order, so swapEndianness only applies to raw images
+	if (ObjectFormat::IsObject(words))
+	{
+		ObjectImage image;
+		string error;
+
+		if (!ObjectFormat::Decode(words, image, error))
+		{
+			std::cout << "Object file rejected: " << error << std::endl;
+			return 0;
+		}
+
+		for (const ObjectSegment& segment : image.segments)
+		{
+			if (segment.origin + segment.words.size() > static_cast<size_t>(memorySize))
+			{
+				std::cout << "Segment at " << segment.origin << " larger than available space. Aborting..." << std::endl;
+				return 0;
+			}
+
+			std::copy(segment.words.begin(), segment.words.end(), memory + segment.origin);
+			std::cout << "Segment of " << segment.words.size() << " words placed at " << segment.origin << std::endl;
+		}
+
+		std::cout << "Object file done being read, entry at " << image.entry << std::endl;
+
+		return image.entry;
+	}
+
+	if (lengthOfFile == 0)
+	{
+		std::cout << "File is empty. Aborting..." << std::endl;
+		return 0;
+	}
 
 	if (swapEndianness)
-		startAddress = startAddress << 8 | startAddress >> 8;
+	{
+		for (uint16_t& word : words)
+			word = ObjectFormat::SwapWord(word);
+	}
+
+	uint16_t startAddress = words[0];
 
 	std::cout << "Start address read as " << startAddress << std::endl;
 	
@@ -31,40 +80,45 @@ uint16_t Utilities::LoadFileInto(string filename, uint16_t* memory, int memorySi
 	
 	std::cout << "Length of file read as: " << std::to_string(lengthOfFile) << " words" << std::endl;
 
-	if (startAddress + lengthOfFile < memorySize) 
+	if (startAddress + lengthOfFile < static_cast<size_t>(memorySize)) 
 	{
 		std::cout << "File shorter than available space. Reading " << std::to_string(lengthOfFile) << " units instead." << std::endl;
 	} 
 	else 
 	{
 		std::cout << "File larger than available space. Aborting..." << std::endl;
-		input.close();
 		return 0;
 	}
 
-	uint16_t buffer;
+	std::copy(words.begin() + 1, words.end(), memory + startAddress);
 
-	for (uint16_t i = 0; i < lengthOfFile - 1; ++i)
-	{
-		input.read(reinterpret_cast<char*>(&buffer), sizeof(buffer));
-		if (swapEndianness)
-		{
-			buffer = buffer << 8 | buffer >> 8;
-		}
-		memory[startAddress + i] = buffer;
-	}
+	std::cout << "File done being read." << std::endl;
 
-	input.close();
 
-	if (!input.good())
+	return startAddress;
+}
+
+bool Utilities::LoadDebugInfo(string filename, ObjectImage& info)
+{
+	std::ifstream input(filename, std::ios::in | std::ios::binary);
+
+	if (input.is_open())
 	{
-		perror("LOAD NOT OK");
+		input.seekg(0, input.end);
+		vector<uint16_t> words(static_cast<size_t>(input.tellg()) / 2);
+		input.seekg(0, input.beg);
+		input.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint16_t));
+
+		string error;
+		if (ObjectFormat::IsObject(words) && ObjectFormat::Decode(words, info, error) && !(info.symbols.empty() && info.lines.empty()))
+			return true;
 	}
 
-	std::cout << "File done being read." << std::endl;
+	size_t extension = filename.find_last_of('.');
+	if (extension == string::npos || filename.find_first_of("/\\", extension) != string::npos)
+		extension = filename.size();
 
-
-	return startAddress;
+	return ObjectFormat::ReadSymbolFile(filename.substr(0, extension) + ".sym", info);
 }
 
 string Utilities::ToUpperCase(const string& inputString) 
@@ -3,11 +3,16 @@
 
 using std::string;
 
+struct ObjectImage;
+
 class Utilities 
 {
 public:
-	// Returns PC start
+	// Loads a v2 object file or a raw image whose first word is the origin. Returns PC start.
 	static uint16_t LoadFileInto(string filename, uint16_t* test, int numberToRead, bool swapEndianness);
 
+	// Symbols and line map of an image: the sections of a v2 object file, else the .sym file next to it
+	static bool LoadDebugInfo(string filename, ObjectImage& info);
+
 	static string ToUpperCase(const string& inputString);
 };
\ No newline at end of file
@@ -0,0 +1,514 @@
+#include "VirtualTerminal.h"
+#include <algorithm>
+#include <iostream>
+
+VirtualTerminal::ScreenBuffer VirtualTerminal::screenBuffer;
+std::streambuf* VirtualTerminal::consoleBuffer = nullptr;
+std::mutex VirtualTerminal::screenMutex;
+std::condition_variable VirtualTerminal::screenChanged;
+std::thread VirtualTerminal::presenter;
+std::chrono::microseconds VirtualTerminal::framePeriod(0);
+bool VirtualTerminal::enabled = false;
+bool VirtualTerminal::stopping = false;
+bool VirtualTerminal::dirty = false;
+VirtualTerminal::Cell VirtualTerminal::screen[ROWS][COLUMNS];
+VirtualTerminal::Cell VirtualTerminal::shown[ROWS][COLUMNS];
+uint16_t VirtualTerminal::cursorRow = 0;
+uint16_t VirtualTerminal::cursorColumn = 0;
+uint16_t VirtualTerminal::savedRow = 0;
+uint16_t VirtualTerminal::savedColumn = 0;
+uint16_t VirtualTerminal::attributes = 0;
+bool VirtualTerminal::cursorVisible = true;
+VirtualTerminal::PARSE_STATE VirtualTerminal::parseState = PS_TEXT;
+uint16_t VirtualTerminal::parameters[MAX_PARAMETERS];
+uint16_t VirtualTerminal::parameterCount = 0;
+bool VirtualTerminal::privateSequence = false;
+bool VirtualTerminal::presented = false;
+uint16_t VirtualTerminal::presentedRow = 0;
+uint16_t VirtualTerminal::presentedColumn = 0;
+uint16_t VirtualTerminal::presentedAttributes = 0;
+bool VirtualTerminal::presentedCursorVisible = true;
+uint64_t VirtualTerminal::guestBytes = 0;
+uint64_t VirtualTerminal::hostBytes = 0;
+uint64_t VirtualTerminal::frameCount = 0;
+
+int VirtualTerminal::ScreenBuffer::overflow(int c)
+{
+    if (c != traits_type::eof())
+    {
+        char letter = static_cast<char>(c);
+        Interpret(&letter, 1);
+    }
+    return c;
+}
+
+std::streamsize VirtualTerminal::ScreenBuffer::xsputn(const char* text, std::streamsize count)
+{
+    Interpret(text, static_cast<size_t>(count));
+    return count;
+}
+
+void VirtualTerminal::Enable(uint32_t framesPerSecond)
+{
+    framesPerSecond = std::clamp<uint32_t>(framesPerSecond, 1, 1000);
+    framePeriod = std::chrono::microseconds(1000000 / framesPerSecond);
+
+    std::fill(&screen[0][0], &screen[0][0] + ROWS * COLUMNS, Cell{ ' ', 0 });
+    cursorRow = cursorColumn = savedRow = savedColumn = 0;
+    attributes = 0;
+    cursorVisible = true;
+    parseState = PS_TEXT;
+    presented = false;
+    dirty = false;
+    stopping = false;
+    guestBytes = hostBytes = frameCount = 0;
+
+    std::cout.flush();
+    consoleBuffer = std::cout.rdbuf(&screenBuffer);
+    enabled = true;
+
+    presenter = std::thread(Present);
+}
+
+void VirtualTerminal::Disable()
+{
+    if (!enabled)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(screenMutex);
+        stopping = true;
+    }
+
+    screenChanged.notify_all();
+    presenter.join();
+
+    // Only this thread is left, hand the host a last frame in the default attributes with a visible cursor
+    std::string frame;
+    Render(frame);
+    if (presentedAttributes != 0)
+        frame += "\x1b[0m";
+    if (!presentedCursorVisible)
+        frame += "\x1b[?25h";
+    Emit(frame);
+
+    std::cout.rdbuf(consoleBuffer);
+    enabled = false;
+}
+
+void VirtualTerminal::Interpret(const char* text, size_t length)
+{
+    std::lock_guard<std::mutex> lock(screenMutex);
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        char letter = text[i];
+
+        switch (parseState)
+        {
+        case PS_TEXT:
+            Put(letter);
+            break;
+        case PS_ESCAPE:
+            parseState = PS_TEXT;
+            if (letter == '[')
+            {
+                parseState = PS_CONTROL;
+                parameterCount = 0;
+                parameters[0] = 0;
+                privateSequence = false;
+            }
+            else if (letter == '7')
+            {
+                savedRow = cursorRow;
+                savedColumn = cursorColumn;
+            }
+            else if (letter == '8')
+            {
+                cursorRow = savedRow;
+                cursorColumn = savedColumn;
+            }
+            else if (letter == 'c')
+            {
+                std::fill(&screen[0][0], &screen[0][0] + ROWS * COLUMNS, Cell{ ' ', 0 });
+                cursorRow = cursorColumn = 0;
+                attributes = 0;
+                cursorVisible = true;
+            }
+            break;
+        case PS_CONTROL:
+            if (letter >= '0' && letter <= '9')
+            {
+                if (parameterCount == 0)
+                    parameterCount = 1;
+                uint16_t& parameter = parameters[parameterCount - 1];
+                parameter = static_cast<uint16_t>(std::min(parameter * 10 + (letter - '0'), 9999));
+            }
+            else if (letter == ';')
+            {
+                if (parameterCount == 0)
+                    parameterCount = 1;
+                if (parameterCount < MAX_PARAMETERS)
+                    parameters[parameterCount++] = 0;
+            }
+            else if (letter == '?')
+            {
+                privateSequence = true;
+            }
+            else if (letter >= 0x40 && letter <= 0x7E)
+            {
+                Execute(letter);
+                parseState = PS_TEXT;
+            }
+            break;
+        }
+    }
+
+    guestBytes += length;
+
+    if (!dirty)
+    {
+        // Wake the presenter once per frame, not once per character
+        dirty = true;
+        screenChanged.notify_one();
+    }
+}
+
+void VirtualTerminal::Put(char letter)
+{
+    switch (letter)
+    {
+    case '\x1b':
+        parseState = PS_ESCAPE;
+        return;
+    case '\n':
+        cursorColumn = 0;
+        LineFeed();
+        return;
+    case '\r':
+        cursorColumn = 0;
+        return;
+    case '\b':
+        cursorColumn = std::min<uint16_t>(cursorColumn, COLUMNS - 1);
+        if (cursorColumn > 0)
+            --cursorColumn;
+        return;
+    case '\t':
+        cursorColumn = std::min<uint16_t>((cursorColumn / 8 + 1) * 8, COLUMNS - 1);
+        return;
+    default:
+        break;
+    }
+
+    if (static_cast<unsigned char>(letter) < 0x20 || letter == 0x7F)
+        return; // bells and other controls draw nothing
+
+    // Like a real terminal the cursor rests past the last column until the next letter wraps it
+    if (cursorColumn >= COLUMNS)
+    {
+        cursorColumn = 0;
+        LineFeed();
+    }
+
+    screen[cursorRow][cursorColumn++] = Cell{ letter, attributes };
+}
+
+void VirtualTerminal::LineFeed()
+{
+    if (cursorRow + 1 < ROWS)
+    {
+        ++cursorRow;
+        return;
+    }
+
+    std::copy(&screen[1][0], &screen[0][0] + ROWS * COLUMNS, &screen[0][0]);
+    Erase(ROWS - 1, 0, COLUMNS);
+}
+
+void VirtualTerminal::Erase(uint16_t row, uint16_t fromColumn, uint16_t toColumn)
+{
+    // Erased cells take the current background, as on xterm
+    std::fill(&screen[row][fromColumn], &screen[row][0] + toColumn, Cell{ ' ', static_cast<uint16_t>(attributes & A_BACKGROUND) });
+}
+
+uint16_t VirtualTerminal::GetParameter(uint16_t index, uint16_t fallback)
+{
+    return index < parameterCount && parameters[index] != 0 ? parameters[index] : fallback;
+}
+
+void VirtualTerminal::Execute(char command)
+{
+    if (privateSequence)
+    {
+        if ((command == 'h' || command == 'l') && GetParameter(0, 0) == 25)
+            cursorVisible = command == 'h';
+        return;
+    }
+
+    uint16_t count = GetParameter(0, 1);
+    uint16_t column = std::min<uint16_t>(cursorColumn, COLUMNS - 1);
+
+    switch (command)
+    {
+    case 'A':
+        cursorRow -= std::min(cursorRow, count);
+        cursorColumn = column;
+        break;
+    case 'B':
+        cursorRow = std::min<uint16_t>(cursorRow + count, ROWS - 1);
+        cursorColumn = column;
+        break;
+    case 'C':
+        cursorColumn = std::min<uint16_t>(column + count, COLUMNS - 1);
+        break;
+    case 'D':
+        cursorColumn = column - std::min(column, count);
+        break;
+    case 'E':
+        cursorRow = std::min<uint16_t>(cursorRow + count, ROWS - 1);
+        cursorColumn = 0;
+        break;
+    case 'F':
+        cursorRow -= std::min(cursorRow, count);
+        cursorColumn = 0;
+        break;
+    case 'G':
+        cursorColumn = std::min<uint16_t>(count, COLUMNS) - 1;
+        break;
+    case 'd':
+        cursorRow = std::min<uint16_t>(count, ROWS) - 1;
+        cursorColumn = column;
+        break;
+    case 'H':
+    case 'f':
+        cursorRow = std::min<uint16_t>(GetParameter(0, 1), ROWS) - 1;
+        cursorColumn = std::min<uint16_t>(GetParameter(1, 1), COLUMNS) - 1;
+        break;
+    case 'J':
+    {
+        uint16_t mode = GetParameter(0, 0);
+        if (mode == 0)
+        {
+            Erase(cursorRow, column, COLUMNS);
+            for (uint16_t row = cursorRow + 1; row < ROWS; ++row)
+                Erase(row, 0, COLUMNS);
+        }
+        else if (mode == 1)
+        {
+            for (uint16_t row = 0; row < cursorRow; ++row)
+                Erase(row, 0, COLUMNS);
+            Erase(cursorRow, 0, column + 1);
+        }
+        else if (mode == 2)
+        {
+            for (uint16_t row = 0; row < ROWS; ++row)
+                Erase(row, 0, COLUMNS);
+        }
+        // 3 only clears the scrollback, which the model does not have
+        break;
+    }
+    case 'K':
+    {
+        uint16_t mode = GetParameter(0, 0);
+        if (mode == 0)
+            Erase(cursorRow, column, COLUMNS);
+        else if (mode == 1)
+            Erase(cursorRow, 0, column + 1);
+        else if (mode == 2)
+            Erase(cursorRow, 0, COLUMNS);
+        break;
+    }
+    case 'm':
+        SetAttributes();
+        break;
+    case 's':
+        savedRow = cursorRow;
+        savedColumn = cursorColumn;
+        break;
+    case 'u':
+        cursorRow = savedRow;
+        cursorColumn = savedColumn;
+        break;
+    default:
+        break;
+    }
+}
+
+void VirtualTerminal::SetAttributes()
+{
+    if (parameterCount == 0)
+        parameters[parameterCount++] = 0;
+
+    for (uint16_t i = 0; i < parameterCount; ++i)
+    {
+        uint16_t code = parameters[i];
+
+        if (code == 0)
+            attributes = 0;
+        else if (code == 1)
+            attributes |= A_BOLD;
+        else if (code == 2)
+            attributes |= A_DIM;
+        else if (code == 3)
+            attributes |= A_ITALIC;
+        else if (code == 4)
+            attributes |= A_UNDERLINE;
+        else if (code == 5)
+            attributes |= A_BLINK;
+        else if (code == 7)
+            attributes |= A_REVERSE;
+        else if (code == 22)
+            attributes &= ~(A_BOLD | A_DIM);
+        else if (code == 23)
+            attributes &= ~A_ITALIC;
+        else if (code == 24)
+            attributes &= ~A_UNDERLINE;
+        else if (code == 25)
+            attributes &= ~A_BLINK;
+        else if (code == 27)
+            attributes &= ~A_REVERSE;
+        else if (code >= 30 && code <= 37)
+            attributes = (attributes & ~A_FOREGROUND) | (code - 30 + 1);
+        else if (code == 39)
+            attributes &= ~A_FOREGROUND;
+        else if (code >= 40 && code <= 47)
+            attributes = (attributes & ~A_BACKGROUND) | ((code - 40 + 1) << 5);
+        else if (code == 49)
+            attributes &= ~A_BACKGROUND;
+        else if (code >= 90 && code <= 97)
+            attributes = (attributes & ~A_FOREGROUND) | (code - 90 + 9);
+        else if (code >= 100 && code <= 107)
+            attributes = (attributes & ~A_BACKGROUND) | ((code - 100 + 9) << 5);
+        else if ((code == 38 || code == 48) && i + 1 < parameterCount)
+            i += parameters[i + 1] == 5 ? 2 : 4; // 256 and true colors are not modeled, skip their arguments
+    }
+}
+
+void VirtualTerminal::Render(std::string& frame)
+{
+    if (!presented)
+    {
+        // The model starts out blank, so does the host screen
+        frame += "\x1b[0m\x1b[H\x1b[2J";
+        std::fill(&shown[0][0], &shown[0][0] + ROWS * COLUMNS, Cell{ ' ', 0 });
+        presentedRow = presentedColumn = presentedAttributes = 0;
+        presentedCursorVisible = true;
+        presented = true;
+    }
+
+    for (uint16_t row = 0; row < ROWS; ++row)
+    {
+        for (uint16_t column = 0; column < COLUMNS; ++column)
+        {
+            const Cell& cell = screen[row][column];
+            if (cell == shown[row][column])
+                continue;
+
+            if (row != presentedRow || column != presentedColumn)
+            {
+                std::string move = "\x1b[" + std::to_string(row + 1) + ';' + std::to_string(column + 1) + 'H';
+
+                // A gap shorter than the move, e.g. the blank between two words, is cheaper to send
+                // again, as long as it needs no attribute change
+                bool resend = row == presentedRow && column > presentedColumn && static_cast<size_t>(column - presentedColumn) < move.size();
+                for (uint16_t skipped = presentedColumn; resend && skipped < column; ++skipped)
+                    resend = shown[row][skipped].attributes == presentedAttributes;
+
+                if (resend)
+                {
+                    for (uint16_t skipped = presentedColumn; skipped < column; ++skipped)
+                        frame += shown[row][skipped].letter;
+                }
+                else
+                {
+                    frame += move;
+                }
+            }
+
+            if (cell.attributes != presentedAttributes)
+                AppendAttributes(frame, cell.attributes);
+
+            frame += cell.letter;
+            shown[row][column] = cell;
+            presentedRow = row;
+            presentedColumn = column + 1; // past the last column forces a move before the next cell
+        }
+    }
+
+    uint16_t column = std::min<uint16_t>(cursorColumn, COLUMNS - 1);
+    if (cursorRow != presentedRow || column != presentedColumn)
+    {
+        frame += "\x1b[" + std::to_string(cursorRow + 1) + ';' + std::to_string(column + 1) + 'H';
+        presentedRow = cursorRow;
+        presentedColumn = column;
+    }
+
+    if (cursorVisible != presentedCursorVisible)
+    {
+        frame += cursorVisible ? "\x1b[?25h" : "\x1b[?25l";
+        presentedCursorVisible = cursorVisible;
+    }
+
+    dirty = false;
+}
+
+void VirtualTerminal::AppendAttributes(std::string& frame, uint16_t cellAttributes)
+{
+    frame += "\x1b[0";
+
+    static const std::pair<uint16_t, const char*> flags[] =
+    {
+        { A_BOLD, ";1" }, { A_DIM, ";2" }, { A_ITALIC, ";3" }, { A_UNDERLINE, ";4" }, { A_BLINK, ";5" }, { A_REVERSE, ";7" }
+    };
+    for (const auto& flag : flags)
+    {
+        if (cellAttributes & flag.first)
+            frame += flag.second;
+    }
+
+    uint16_t foreground = cellAttributes & A_FOREGROUND;
+    if (foreground)
+        frame += ';' + std::to_string(foreground <= 8 ? 30 + foreground - 1 : 90 + foreground - 9);
+
+    uint16_t background = (cellAttributes & A_BACKGROUND) >> 5;
+    if (background)
+        frame += ';' + std::to_string(background <= 8 ? 40 + background - 1 : 100 + background - 9);
+
+    frame += 'm';
+    presentedAttributes = cellAttributes;
+}
+
+void VirtualTerminal::Emit(const std::string& frame)
+{
+    if (frame.empty())
+        return;
+
+    consoleBuffer->sputn(frame.data(), static_cast<std::streamsize>(frame.size()));
+    consoleBuffer->pubsync();
+
+    hostBytes += frame.size();
+    ++frameCount;
+}
+
+void VirtualTerminal::Present()
+{
+    std::unique_lock<std::mutex> lock(screenMutex);
+
+    while (true)
+    {
+        screenChanged.wait(lock, [] { return dirty || stopping; });
+        if (stopping)
+            return;
+
+        std::string frame;
+        Render(frame);
+
+        lock.unlock();
+        Emit(frame);
+
+        // Whatever the guest writes meanwhile goes out together in the next frame
+        lock.lock();
+        if (screenChanged.wait_for(lock, framePeriod, [] { return stopping; }))
+            return;
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+// An in-process terminal between the guest and the host console. While it is enabled std::cout
+// writes into a screen model that interprets the usual ANSI sequences (cursor movement, erase,
+// SGR colors and attributes, cursor save/restore and visibility), and a presenter thread sends
+// the host only the cells that changed since the last frame, at most a given number of frames a
+// second. A program that redraws a whole board per move then costs the host a handful of bytes
+// in one write instead of a flush per character.
+//
+// The model is COLUMNS x ROWS and starts blank at the top left of a cleared host screen. A line
+// feed also returns the carriage, as the host console does for LC-3 output; unknown sequences
+// are dropped.
+class VirtualTerminal
+{
+public:
+    enum
+    {
+        COLUMNS = 80,
+        ROWS = 24,
+        DEFAULT_FRAME_RATE = 30
+    };
+
+    // Routes std::cout through the screen model and starts the presenter
+    static void Enable(uint32_t framesPerSecond);
+
+    static bool IsEnabled()
+    {
+        return enabled;
+    }
+
+    // Presents the last frame, stops the presenter and gives std::cout its own buffer back with the
+    // host cursor where the guest left it. Must be called before exit while enabled.
+    static void Disable();
+
+    // Bytes the guest wrote, and bytes and frames actually sent to the host
+    static uint64_t GetGuestByteCount()
+    {
+        return guestBytes;
+    }
+
+    static uint64_t GetHostByteCount()
+    {
+        return hostBytes;
+    }
+
+    static uint64_t GetFrameCount()
+    {
+        return frameCount;
+    }
+
+private:
+    enum PARSE_STATE
+    {
+        PS_TEXT,
+        PS_ESCAPE,    /* after ESC */
+        PS_CONTROL    /* inside ESC [ ... */
+    };
+
+    enum ATTRIBUTE
+    {
+        A_FOREGROUND = 0x001F,    /* 0 is the default color, 1 + n color n of the 16 */
+        A_BACKGROUND = 0x03E0,    /* the same, shifted by 5 */
+        A_BOLD = 1 << 10,
+        A_DIM = 1 << 11,
+        A_ITALIC = 1 << 12,
+        A_UNDERLINE = 1 << 13,
+        A_BLINK = 1 << 14,
+        A_REVERSE = 1 << 15
+    };
+
+    enum
+    {
+        MAX_PARAMETERS = 16
+    };
+
+    struct Cell
+    {
+        char letter;
+        uint16_t attributes;
+
+        bool operator==(const Cell&) const = default;
+    };
+
+    class ScreenBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override;
+
+        std::streamsize xsputn(const char* text, std::streamsize count) override;
+    };
+
+    // Feeds guest output into the model. Takes the screen lock.
+    static void Interpret(const char* text, size_t length);
+
+    static void Put(char letter);
+
+    static void Execute(char command);
+
+    static void SetAttributes();
+
+    static void LineFeed();
+
+    static void Erase(uint16_t row, uint16_t fromColumn, uint16_t toColumn);
+
+    static uint16_t GetParameter(uint16_t index, uint16_t fallback);
+
+    // Appends the escape sequences that bring the host screen up to date. Called with the screen lock held.
+    static void Render(std::string& frame);
+
+    static void AppendAttributes(std::string& frame, uint16_t cellAttributes);
+
+    static void Emit(const std::string& frame);
+
+    static void Present();
+
+    static ScreenBuffer screenBuffer;
+
+    static std::streambuf* consoleBuffer;
+
+    static std::mutex screenMutex;
+
+    static std::condition_variable screenChanged;
+
+    static std::thread presenter;
+
+    static std::chrono::microseconds framePeriod;
+
+    static bool enabled;
+
+    static bool stopping;
+
+    static bool dirty;
+
+    static Cell screen[ROWS][COLUMNS];
+
+    static Cell shown[ROWS][COLUMNS];
+
+    static uint16_t cursorRow, cursorColumn, savedRow, savedColumn;
+
+    static uint16_t attributes;
+
+    static bool cursorVisible;
+
+    static PARSE_STATE parseState;
+
+    static uint16_t parameters[MAX_PARAMETERS];
+
+    static uint16_t parameterCount;
+
+    static bool privateSequence;
+
+    static bool presented;
+
+    static uint16_t presentedRow, presentedColumn, presentedAttributes;
+
+    static bool presentedCursorVisible;
+
+    static uint64_t guestBytes, hostBytes, frameCount;
+};
@@ -1,64 +1,417 @@
+#include <algorithm>
+#include <cctype>
 #include <cstdint>
 #include <iostream>
 #include <bitset>
 #include <fstream>
+#include <string>
 #include <vector>
+#include <chrono>
+#include <csignal>
+#include "BankedMemory.h"
 #include "CPU.h"
+#include "DebugConsole.h"
+#include "Debugger.h"
 #include "ExternalUtilities.h"
+#include "GdbStub.h"
+#include "GoldenOutput.h"
+#include "Keyboard.h"
+#include "Multiprocessor.h"
+#include "ReverseDebugger.h"
+#include "Timer.h"
+#include "TimingModel.h"
+#include "TraceWriter.h"
+#include "TranslationCache.h"
 #include "Utilities.h"
+#include "VirtualTerminal.h"
 #include <stdio.h>
 #include <stdint.h>
 
 
+void PrintUsage(const char* executableName)
+{
+	std::cout << "Usage: "<< executableName << " path swap_endianness os_image options\n"
+		<< "  path:             relative or abolute path to assembly using forward slashes.\n" 
+		<< "  swap_endianness:  whether to swap byte order for VM. Acceptable values are TRUE or FALSE. Default is TRUE.\n"
+		<< "  os_image:         optional path to an LC-3 OS image. When given, traps run through its vector table instead of natively.\n"
+		<< "  options:\n"
+		<< "    -fusion         fuse common instruction sequences into single steps instead of executing every instruction on its own.\n"
+		<< "    -nofusion       execute every instruction on its own. This is the default.\n"
+		<< "    -timing         estimate cycles with the timing model and report CPI and stall breakdown.\n"
+		<< "    -timing=config  same, with per-opcode and memory costs read from a config file.\n"
+		<< "    -trace=file     record every executed instruction into a compressed trace, read it with LC3_Trace.\n"
+		<< "    -debug          run under the interactive debugger, which can also step backwards.\n"
+		<< "    -debug=n,count  same, checkpointing every n instructions and keeping count checkpoints of history.\n"
+		<< "    -gdb[=port]     wait for a GDB remote protocol connection on localhost, port 1234 by default.\n"
+		<< "    -cache=dir      keep the fusion plan of the image in dir, so later runs start with it. Needs -fusion.\n"
+		<< "    -extmem=frames  give the machine frames 4K-word frames of memory, switched into pages x1000-xEFFF through the bank registers at xFE10.\n"
+		<< "    -cores=n        run n cores (up to 8) over shared memory, each on its own host thread. All start at the entry point.\n"
+		<< "    -lockstep[=n]   with -cores, run the cores on one host thread in turns of n instructions (1 by default) so runs are repeatable.\n"
+		<< "    -vt[=fps]       draw the guest's output on an in-process terminal and send the console only what changed, at most fps (30) times a second.\n"
+		<< "    -input=file     type the contents of file instead of reading the keyboard.\n"
+		<< "    -expect=file    compare the guest's output with file while it runs, stop at the first difference and report it.\n"
+		<< "    -capture=file   write the guest's output to file instead of the console, e.g. to make a file for -expect."
+		<< '\n';
+}
+
+// Reads a whole decimal option value no larger than maximum. Signs, trailing text and numbers out
+// of range all fail instead of throwing out of main.
+bool ParseNumber(const std::string& text, unsigned long& value, unsigned long maximum = UINT32_MAX)
+{
+	if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0])))
+		return false;
+
+	try
+	{
+		size_t used = 0;
+		value = std::stoul(text, &used);
+		return used == text.size() && value <= maximum;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+int RejectArgument(const std::string& argument, const char* executableName)
+{
+	std::cout << "Invalid value in argument: " << argument << '\n' << '\n';
+	PrintUsage(executableName);
+	return 1;
+}
+
 int main(int argc, char* argv[])
 {
-	if (argc < 2)
+	std::vector<std::string> arguments;
+	std::string tracePath;
+	std::string cachePath;
+	bool debugging = false;
+	uint32_t historyInterval = 16384;
+	uint32_t historyCheckpoints = 16;
+	int gdbPort = 0;
+	uint32_t frameCount = 0;
+	uint16_t coreCount = 1;
+	uint32_t lockstepQuantum = 0;
+	uint32_t frameRate = 0;
+	std::string inputPath;
+	std::string expectedPath;
+	std::string capturePath;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+
+		if (argument[0] != '-')
+		{
+			arguments.push_back(argument);
+		}
+		else if (Utilities::ToUpperCase(argument) == "-FUSION")
+		{
+			CPU::fusionEnabled = true;
+		}
+		else if (Utilities::ToUpperCase(argument) == "-NOFUSION")
+		{
+			CPU::fusionEnabled = false;
+		}
+		else if (Utilities::ToUpperCase(argument) == "-TIMING")
+		{
+			TimingModel::Enable();
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 8)) == "-TIMING=")
+		{
+			if (!TimingModel::LoadConfig(argument.substr(8)))
+				return 1;
+
+			TimingModel::Enable();
+		}
+		else if (Utilities::ToUpperCase(argument) == "-DEBUG")
+		{
+			debugging = true;
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 7)) == "-DEBUG=" && argument.find(',') != std::string::npos)
+		{
+			size_t comma = argument.find(',');
+			unsigned long interval;
+			unsigned long checkpoints;
+
+			if (!ParseNumber(argument.substr(7, comma - 7), interval) || !ParseNumber(argument.substr(comma + 1), checkpoints))
+				return RejectArgument(argument, argv[0]);
+
+			debugging = true;
+			historyInterval = static_cast<uint32_t>(interval);
+			historyCheckpoints = static_cast<uint32_t>(checkpoints);
+		}
+		else if (Utilities::ToUpperCase(argument) == "-GDB")
+		{
+			gdbPort = 1234;
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 5)) == "-GDB=")
+		{
+			unsigned long port;
+			if (!ParseNumber(argument.substr(5), port, 0xFFFF) || port == 0)
+				return RejectArgument(argument, argv[0]);
+
+			gdbPort = static_cast<int>(port);
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 7)) == "-TRACE=")
+		{
+			tracePath = argument.substr(7);
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 7)) == "-CACHE=")
+		{
+			cachePath = argument.substr(7);
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 8)) == "-EXTMEM=")
+		{
+			unsigned long frames;
+			if (!ParseNumber(argument.substr(8), frames))
+				return RejectArgument(argument, argv[0]);
+
+			frameCount = static_cast<uint32_t>(frames);
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 7)) == "-CORES=")
+		{
+			unsigned long cores;
+			if (!ParseNumber(argument.substr(7), cores))
+				return RejectArgument(argument, argv[0]);
+
+			coreCount = static_cast<uint16_t>(std::clamp<unsigned long>(cores, 1, CPU::MAX_CORES));
+		}
+		else if (Utilities::ToUpperCase(argument) == "-LOCKSTEP")
+		{
+			lockstepQuantum = 1;
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 10)) == "-LOCKSTEP=")
+		{
+			unsigned long quantum;
+			if (!ParseNumber(argument.substr(10), quantum))
+				return RejectArgument(argument, argv[0]);
+
+			lockstepQuantum = static_cast<uint32_t>(std::max<unsigned long>(quantum, 1));
+		}
+		else if (Utilities::ToUpperCase(argument) == "-VT")
+		{
+			frameRate = VirtualTerminal::DEFAULT_FRAME_RATE;
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 4)) == "-VT=")
+		{
+			unsigned long rate;
+			if (!ParseNumber(argument.substr(4), rate))
+				return RejectArgument(argument, argv[0]);
+
+			frameRate = static_cast<uint32_t>(std::max<unsigned long>(rate, 1));
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 7)) == "-INPUT=")
+		{
+			inputPath = argument.substr(7);
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 8)) == "-EXPECT=")
+		{
+			expectedPath = argument.substr(8);
+		}
+		else if (Utilities::ToUpperCase(argument.substr(0, 9)) == "-CAPTURE=")
+		{
+			capturePath = argument.substr(9);
+		}
+		else
+		{
+			std::cout << "Unrecognized argument: " << argument << '\n' << '\n';
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (arguments.empty())
 	{
-		std::cout << "Usage: "<< argv[0] << " path swap_endianness\n"
-		          << "	path:             relative or abolute path to assembly using forward slashes.\n" 
-				  << "  swap_endianness:  whether to swap byte order for VM. Acceptable values are TRUE or FALSE. Default is TRUE."
-				  << '\n';
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	if (!cachePath.empty() && !CPU::fusionEnabled)
+	{
+		// The cache holds a fusion plan, which the unfused loop never looks at
+		std::cout << "-cache needs -fusion" << '\n';
+		return 1;
+	}
+
+	if (frameCount && (debugging || gdbPort))
+	{
+		// The history records single stores and the GDB stub reads and writes memory words in place, a bank switch replaces a whole page
+		std::cout << "-extmem cannot be combined with -debug or -gdb" << '\n';
+		return 1;
+	}
+
+	if (coreCount > 1 && (debugging || gdbPort || frameCount || !tracePath.empty() || TimingModel::IsEnabled()))
+	{
+		// The debuggers, the trace, the timing model and the banks all follow a single core
+		std::cout << "-cores cannot be combined with -debug, -gdb, -extmem, -trace or -timing" << '\n';
+		return 1;
+	}
+
+	if (frameRate && (debugging || gdbPort))
+	{
+		// The debugger prompts on the console, the terminal would only show it a frame later
+		std::cout << "-vt cannot be combined with -debug or -gdb" << '\n';
+		return 1;
+	}
+
+	bool headless = !expectedPath.empty() || !capturePath.empty();
+	if (headless && (debugging || gdbPort || frameRate || coreCount > 1))
+	{
+		// The output has to come from one core in program order, and nothing else may own the console
+		std::cout << "-expect and -capture cannot be combined with -debug, -gdb, -vt or -cores" << '\n';
 		return 1;
 	}
 
 	bool swapEndianness = true;
-	if (argc == 3)
+	if (arguments.size() >= 2)
 	{
-		if (Utilities::ToUpperCase(argv[2]) == "TRUE")
+		if (Utilities::ToUpperCase(arguments[1]) == "TRUE")
 			swapEndianness = true;
-		else if (Utilities::ToUpperCase(argv[2]) == "FALSE")
+		else if (Utilities::ToUpperCase(arguments[1]) == "FALSE")
 			swapEndianness = false;
 		else 
 		{
-			std::cout << "Unrecognized argument: " << argv[2] << '\n' << '\n';
+			std::cout << "Unrecognized argument: " << arguments[1] << '\n' << '\n';
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
 
-			std::cout << "Usage: "<< argv[0] << " path swap_endianness\n"
-				<< "  path:             relative or abolute path to assembly using forward slashes.\n" 
-				<< "  swap_endianness:  whether to swap byte order for VM. Acceptable values are TRUE or FALSE. Default is TRUE."
-				<< '\n';
+	if (arguments.size() >= 3)
+	{
+		Utilities::LoadFileInto(arguments[2], CPU::memory, MEM_MAX, swapEndianness);
+		CPU::trapMode = CPU::TM_OS;
+	}
 
+	uint16_t executableOrigin = Utilities::LoadFileInto(arguments[0], CPU::memory, MEM_MAX, swapEndianness);
+
+	if (!tracePath.empty() && !TraceWriter::Open(tracePath))
+		return 1;
+
+	if (frameCount)
+		BankedMemory::Enable(frameCount);
+
+	// The plan is only used by the normal fused loop, debuggers and bank switches change memory behind its back
+	if (!cachePath.empty() && CPU::fusionEnabled && !TimingModel::IsEnabled() && !TraceWriter::IsEnabled() && !debugging && !gdbPort
+		&& !BankedMemory::IsEnabled() && coreCount == 1)
+	{
+		bool stored = TranslationCache::Open(cachePath, executableOrigin);
+		std::cout << "Fusion plan " << (TranslationCache::WasHit() ? "loaded from " : stored ? "built and stored in " : "built, could not store ")
+			<< TranslationCache::GetPath() << '\n';
+	}
+
+	if (!inputPath.empty())
+	{
+		std::ifstream input(inputPath, std::ios::binary);
+		if (!input)
+		{
+			std::cout << "Cannot read input " << inputPath << '\n';
 			return 1;
 		}
-	}
 
-	uint16_t executableOrigin = Utilities::LoadFileInto(argv[1], CPU::memory, MEM_MAX, swapEndianness);
+		char letter;
+		while (input.get(letter))
+			Keyboard::Push(static_cast<uint16_t>(letter & 0xFF));
+		Keyboard::Close();
+	}
 
 	ExternalUtilities EUtils;
 
 	EUtils.Init();
 
-	CPU::SetValueInRegister(CPU::R_PC, executableOrigin);
+	if (inputPath.empty())
+		Keyboard::Start();
+
+	CPU::cores[0].SetValueInRegister(CPU::R_PC, executableOrigin);
+
+	CPU::cores[0].shouldBeRunning = true;
+
+	if (frameRate)
+		VirtualTerminal::Enable(frameRate);
+
+	std::cout << "Executing Image at " << executableOrigin << " with " << (CPU::trapMode == CPU::TM_OS ? "OS" : "native") << " traps"
+		<< (coreCount > 1 ? ", " + std::to_string(coreCount) + " cores" + (lockstepQuantum ? " in lockstep" : "") : "")
+		<< (TimingModel::IsEnabled() ? ", timing model on" : "") << (TraceWriter::IsEnabled() ? ", tracing" : "")
+		<< (TimingModel::IsEnabled() || TraceWriter::IsEnabled() || !CPU::fusionEnabled ? "" : ", fused") << "\n-----------------------------" << '\n';
+
+	if (headless && !GoldenOutput::Open(expectedPath, capturePath))
+	{
+		EUtils.CleanUp();
+		return 1;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	if (debugging)
+	{
+		ReverseDebugger::Enable(historyInterval, historyCheckpoints);
+		std::signal(SIGINT, Debugger::HandleInterrupt);
 
-	CPU::shouldBeRunning = true;
+		ObjectImage debugInfo;
+		if (Utilities::LoadDebugInfo(arguments[0], debugInfo))
+			DebugConsole::SetDebugInfo(debugInfo);
 
-	std::cout << "Executing Image at " << executableOrigin << "\n-----------------------------" << '\n';
+		DebugConsole::Run();
+	}
+	else if (gdbPort)
+	{
+		CPU::cores[0].SetConditionFlags(CPU::FL_ZRO);
 
-	CPU::ProcessProgram();
+		if (!GdbStub::Serve(static_cast<uint16_t>(gdbPort)))
+			CPU::cores[0].shouldBeRunning = false;
+
+		// After a detach the program carries on without the debugger
+		CPU::cores[0].Run();
+	}
+	else if (coreCount > 1)
+	{
+		Multiprocessor::Run(coreCount, executableOrigin, lockstepQuantum);
+	}
+	else
+	{
+		CPU::cores[0].ProcessProgram();
+	}
+
+	VirtualTerminal::Disable();
+
+	GoldenOutput::Close();
+
+	Timer::Shutdown();
+
+	TraceWriter::Close();
+
+	TranslationCache::Close();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
 	
 	std::cout << "\n-----------------------------\n" << "Execution terminated at " 
-		<< CPU::GetValueInReg(CPU::R_PC)<< '\n';
+		<< CPU::cores[0].GetValueInReg(CPU::R_PC)<< '\n';
+
+	uint64_t executed = coreCount > 1 ? Multiprocessor::GetInstructionCount() : CPU::cores[0].instructionCount;
+
+	std::cout << "Executed " << executed << " instructions in " << elapsed.count() << " s ("
+		<< (elapsed.count() > 0 ? executed / elapsed.count() / 1e6 : 0) << " MIPS)" << '\n';
+
+	if (TraceWriter::GetRecordCount())
+		std::cout << "Traced " << TraceWriter::GetRecordCount() << " instructions" << '\n';
+
+	if (frameRate)
+		std::cout << "Terminal drew " << VirtualTerminal::GetGuestByteCount() << " bytes of output with " << VirtualTerminal::GetHostByteCount()
+			<< " bytes in " << VirtualTerminal::GetFrameCount() << " frames" << '\n';
+
+	if (BankedMemory::IsEnabled())
+		std::cout << "Switched banks " << BankedMemory::GetSwitchCount() << " times in " << BankedMemory::GetFrameCount() << " frames" << '\n';
+
+	if (TimingModel::IsEnabled())
+	{
+		std::cout << '\n';
+		TimingModel::PrintReport(std::cout);
+	}
 	
+	GoldenOutput::PrintReport(std::cout);
+
 	EUtils.CleanUp();
 	
-	return 0;
+	return GoldenOutput::HasPassed() ? 0 : 1;
 }
@@ -0,0 +1,93 @@
+;--------------------------------------------------------------------------
+; Interrupt driven keyboard input.
+; Keys are queued by the keyboard interrupt service routine instead of
+; busy-polling KBSR. While the queue is empty the main loop waits for the
+; next 10 ms timer tick on TSR, which the VM sleeps through, and the
+; keyboard interrupt still arrives during the wait. Press q to quit.
+;--------------------------------------------------------------------------
+
+.ORIG x3000
+
+MAIN
+      LEA   R0, ISR                 ; install the keyboard vector
+      STI   R0, KBD_VECTOR
+      LD    R0, KBSR_IE             ; enable keyboard interrupts
+      STI   R0, KBSR
+      LD    R0, TICK                ; start the idle timer
+      STI   R0, TMR
+
+LOOP  ADD   R1, R1, #1              ; stand-in for useful work
+      LD    R2, HEAD
+      LD    R3, TAIL
+      NOT   R3, R3
+      ADD   R3, R3, #1
+      ADD   R3, R2, R3
+      BRnp  POP
+
+IDLE  LDI   R4, TSR                 ; queue is empty, wait for the next tick
+      BRzp  IDLE
+      BRnzp LOOP
+
+POP   LEA   R3, QUEUE               ; pop the next key
+      ADD   R3, R3, R2
+      LDR   R0, R3, #0
+      ADD   R2, R2, #1
+      AND   R2, R2, #15
+      ST    R2, HEAD
+
+      OUT
+      LD    R2, QUIT_NEG
+      ADD   R2, R0, R2
+      BRnp  LOOP
+
+      AND   R0, R0, #0              ; disable keyboard interrupts and stop the timer
+      STI   R0, KBSR
+      STI   R0, TMR
+      HALT
+
+ISR
+      ST    R0, ISR_SAVE0
+      ST    R1, ISR_SAVE1
+      LD    R1, TAIL
+      LEA   R0, QUEUE
+      ADD   R1, R1, R0
+      LDI   R0, KBDR                ; reading KBDR clears the ready bit
+      STR   R0, R1, #0
+      LD    R1, TAIL
+      ADD   R1, R1, #1
+      AND   R1, R1, #15
+      ST    R1, TAIL
+      LD    R0, ISR_SAVE0
+      LD    R1, ISR_SAVE1
+      RTI
+
+HEAD        .FILL x0000
+TAIL        .FILL x0000
+ISR_SAVE0   .FILL x0000
+ISR_SAVE1   .FILL x0000
+QUIT_NEG    .FILL xFF8F
+KBSR_IE     .FILL x4000
+KBSR        .FILL xFE00
+KBDR        .FILL xFE02
+KBD_VECTOR  .FILL x0180
+TICK        .FILL #10
+TSR         .FILL xFE08
+TMR         .FILL xFE0A
+QUEUE       .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+            .FILL x0000
+
+.END
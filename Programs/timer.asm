@@ -0,0 +1,32 @@
+;--------------------------------------------------------------------------
+; Programmable timer.
+; Prints a dot every quarter second by waiting on the timer status
+; register. The VM sleeps while the program waits.
+;--------------------------------------------------------------------------
+
+.ORIG x3000
+
+MAIN
+      LD    R0, INTERVAL            ; start a periodic 250 ms timer
+      STI   R0, TMR
+      LD    R2, TICKS
+
+WAIT  LDI   R0, TSR                 ; bit 15 is set once per expiry
+      BRzp  WAIT
+
+      LD    R0, DOT
+      OUT
+      ADD   R2, R2, #-1
+      BRp   WAIT
+
+      AND   R0, R0, #0              ; stop the timer
+      STI   R0, TMR
+      HALT
+
+INTERVAL    .FILL #250
+TICKS       .FILL #8
+DOT         .FILL x2E
+TSR         .FILL xFE08
+TMR         .FILL xFE0A
+
+.END
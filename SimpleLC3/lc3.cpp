@@ -0,0 +1,378 @@
+#include "lc3.h"
+#include <bitset>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+uint16_t memory[MEMORY_MAX];  /* 65536 locations */
+uint16_t regs[ERegister::R_NUM];
+
+static uint16_t no_key()
+{
+	return 0;
+}
+
+static void put_stdout( char c )
+{
+	putc( c, stdout );
+}
+
+static void flush_stdout()
+{
+	fflush( stdout );
+}
+
+lc3_io io = { no_key, getchar, put_stdout, flush_stdout, nullptr };
+
+static void put_string( const char *s )
+{
+	while ( *s )
+	{
+		io.put_char( *s++ );
+	}
+}
+
+uint16_t sign_extend( uint16_t x, int bit_count )
+{
+	if ( ( x >> ( bit_count - 1 ) ) & 1 ) // check if desired number is negative
+	{
+		x |= ( 0xFFFF << bit_count );     // fill leftmost bits with 1s
+	}
+	return x;
+}
+
+uint16_t swap16( uint16_t x )
+{
+	return ( x << 8 ) | ( x >> 8 );
+}
+
+void update_flags( uint16_t r )
+{
+	if ( regs[r] == 0 )
+	{
+		regs[R_PSR] = FL_Z;
+	}
+	else if ( regs[r] >> 15 ) /* a 1 in the left-most bit indicates negative */
+	{
+		regs[R_PSR] = FL_N;
+	}
+	else
+	{
+		regs[R_PSR] = FL_P;
+	}
+}
+
+
+constexpr std::size_t BITS_PER_BYTE = std::numeric_limits<uint16_t>::digits;
+
+using bits_in_byte = std::bitset<BITS_PER_BYTE>;
+
+int read_image( const char *path_to_file )
+{
+	std::ifstream file( path_to_file, std::ios::binary ); // open in binary mode
+	if ( !file )
+	{
+		return 0;
+	};
+
+	/* the origin tells us where in memory to place the image */
+	uint16_t origin;
+	file.read( reinterpret_cast<char *>( &origin ), 2 );
+	origin = swap16( origin );
+
+	/* we know the maximum file size so we only need one fread */
+	//uint16_t max_read = MEMORY_MAX - origin;
+	uint16_t *word = memory + origin;
+
+
+	while ( file.read( reinterpret_cast<char *>( word ), 2 ) ) // read byte by byte
+	{
+		*word = swap16( *word );
+		++word;
+	}
+
+	return origin;
+}
+
+void mem_write( uint16_t address, uint16_t val )
+{
+	memory[address] = val;
+	if ( io.on_write )
+	{
+		io.on_write( address );
+	}
+}
+
+uint16_t mem_read( uint16_t address )
+{
+	if ( address == MR_KBSR )
+	{
+		if ( io.check_key() )
+		{
+			memory[MR_KBSR] = ( 1 << 15 );
+			memory[MR_KBDR] = io.get_char();
+		}
+		else
+		{
+			memory[MR_KBSR] = 0;
+		}
+	}
+	return memory[address];
+}
+
+void reset( uint16_t origin )
+{
+	memset( memory, 0, sizeof( memory ) );
+	memset( regs, 0, sizeof( regs ) );
+
+	/* since exactly one condition flag should be set at any given time, set the Z flag */
+	regs[ERegister::R_PSR] = ECondition::FL_Z;
+	regs[ERegister::R_PC] = origin;
+}
+
+int step()
+{
+	int running = 1;
+
+	/* FETCH */
+	uint16_t instr = mem_read( regs[ERegister::R_PC]++ );
+	uint16_t op = instr >> 12;
+
+	switch ( op )
+	{
+		case OP_BR:
+		{
+			uint16_t pc_offset = sign_extend( instr & 0x1FF, 9 );
+			uint16_t cond_flag = ( instr >> 9 ) & 0x7;
+			if ( cond_flag & regs[ERegister::R_PSR] || cond_flag == 0 )
+			{
+				regs[ERegister::R_PC] += pc_offset;
+			}
+		}
+		break;
+		case OP_ADD:
+		{
+			uint16_t dr = ( instr >> 9 ) & 0x7;
+			uint16_t sr1 = ( instr >> 6 ) & 0x7;
+			uint16_t imm_mode = ( instr >> 5 ) & 0x1;
+
+			if ( imm_mode )
+			{
+				uint16_t imm5 = sign_extend( instr & 0x1F, 5 );
+				regs[dr] = regs[sr1] + imm5;
+			}
+			else
+			{
+				uint16_t sr2 = instr & 0x7;
+				regs[dr] = regs[sr1] + regs[sr2];
+			}
+
+			update_flags( dr );
+		}
+		break;
+		case OP_LD:
+		{
+			uint16_t dr = ( instr >> 9 ) & 0x7;
+			uint16_t pc_offset9 = sign_extend( instr & 0x1FF, 9 );
+
+			regs[dr] = mem_read( regs[ERegister::R_PC] + pc_offset9 );
+
+			update_flags( dr );
+		}
+		break;
+		case OP_ST:
+		{
+			uint16_t sr = ( instr >> 9 ) & 0x7;
+			uint16_t pc_offset9 = sign_extend( instr & 0x1FF, 9 );
+			
+			mem_write( regs[ERegister::R_PC] + pc_offset9, regs[sr] );
+		}
+		break;
+		case OP_JSR:
+		{
+			uint16_t flag = ( instr >> 11 ) & 0x1;
+			regs[ERegister::R_R7] = regs[ERegister::R_PC];
+			if ( flag ) // JSR Label
+			{
+				uint16_t pc_offset = sign_extend( instr & 0x7FF, 11 );
+				regs[ERegister::R_PC] = regs[ERegister::R_PC] + pc_offset;
+			}
+			else // JSRR BaseR
+			{
+				uint16_t r = ( instr >> 6 ) & 0x7;
+				regs[ERegister::R_PC] = regs[r];
+			}
+		}
+		break;
+		case OP_AND:
+		{
+			uint16_t dr = ( instr >> 9 ) & 0x7;
+			uint16_t sr1 = ( instr >> 6 ) & 0x7;
+			uint16_t imm_mode = ( instr >> 5 ) & 0x1;
+
+			if ( imm_mode )
+			{
+				uint16_t imm5 = sign_extend( instr & 0x1F, 5 );
+				regs[dr] = regs[sr1] & imm5;
+			}
+			else
+			{
+				uint16_t sr2 = instr & 0x7;
+				regs[dr] = regs[sr1] & regs[sr2];
+			}
+
+			update_flags( dr );
+		}
+		break;
+		case OP_LDR:
+		{
+			uint16_t dr = ( instr >> 9 ) & 0x7;
+			uint16_t base_r = ( instr >> 6 ) & 0x7;
+			uint16_t offset6 = sign_extend( instr & 0x3F, 6 );
+
+			regs[dr] = mem_read( regs[base_r] + offset6 );
+
+			update_flags( dr );
+		}
+		break;
+		case OP_STR:
+		{
+			uint16_t sr = ( instr >> 9 ) & 0x7;
+			uint16_t base_r = ( instr >> 6 ) & 0x7;
+			uint16_t offset6 = sign_extend( instr & 0x3F, 6 );
+
+			mem_write( regs[base_r] + offset6, regs[sr] );
+		}
+		break;
+		case OP_RTI:
+		{
+			// return from interrupt, currently unused
+		}
+		case OP_NOT:
+		{
+			uint16_t dr = ( instr >> 9 ) & 0x7;
+			uint16_t sr = ( instr >> 6 ) & 0x7;
+
+			regs[dr] = ~regs[sr];
+
+			update_flags( dr );
+		}
+		break;
+		case OP_LDI:
+		{
+			uint16_t dr = ( instr >> 9 ) & 0x7;
+			uint16_t pc_offset9 = sign_extend( instr & 0x1FF, 9 );
+
+			regs[dr] = mem_read( mem_read( regs[ERegister::R_PC] + pc_offset9 ) );
+
+			update_flags( dr );
+		}
+		break;
+		case OP_STI:
+		{
+			uint16_t sr = ( instr >> 9 ) & 0x7;
+			uint16_t pc_offset9 = sign_extend( instr & 0x1FF, 9 );
+
+			mem_write( mem_read( regs[ERegister::R_PC] + pc_offset9 ), regs[sr] );
+		}
+		break;
+		case OP_JMP:
+		{
+			uint16_t r = ( instr >> 6 ) & 0x7;
+			regs[ERegister::R_PC] = regs[r]; // for RET register is 0b111 already R7
+		}
+		break;
+		case OP_RES:
+		{
+			// reserved
+		}
+		break;
+		case OP_LEA:
+		{
+			uint16_t dr = ( instr >> 9 ) & 0x7;
+			uint16_t pc_offset9 = sign_extend( instr & 0x1FF, 9 );
+
+			regs[dr] = regs[ERegister::R_PC] + pc_offset9;
+
+			update_flags( dr );
+		}
+		break;
+		case OP_TRAP:
+		{
+			regs[ERegister::R_R7] = regs[ERegister::R_PC];
+			uint16_t trapvect8 = instr & 0xFF;
+
+			switch ( trapvect8 )
+			{
+				case TRAP_GETC:
+				{
+					/* read a single ASCII char */
+					regs[ERegister::R_R0] = (uint16_t)io.get_char();
+					update_flags( ERegister::R_R0 );
+				}
+				break;
+				case TRAP_OUT:
+				{
+					io.put_char( (char)regs[ERegister::R_R0] );
+					io.flush();
+				}
+				break;
+				case TRAP_PUTS:
+				{
+					/* one char per word */
+					uint16_t *c = memory + regs[ERegister::R_R0];
+					while ( *c )
+					{
+						io.put_char( (char)*c );
+						++c;
+					}
+					io.flush();
+				}
+				break;
+				case TRAP_IN:
+				{
+					put_string( "Enter a character: " );
+					char c = (char)io.get_char();
+					io.put_char( c );
+					io.flush();
+					regs[ERegister::R_R0] = (uint16_t)c;
+					update_flags( ERegister::R_R0 );
+				}
+				break;
+				case TRAP_PUTSP:
+				{
+					/* one char per byte (two bytes per word)
+					   here we need to swap back to
+					   big endian format */
+					uint16_t *c = memory + regs[ERegister::R_R0];
+					while ( *c )
+					{
+						char char1 = ( *c ) & 0xFF;
+						io.put_char( char1 );
+						char char2 = ( *c ) >> 8;
+						if ( char2 ) io.put_char( char2 );
+						++c;
+					}
+					io.flush();
+				}
+				break;
+				case TRAP_HALT:
+				{
+					put_string( "HALT\n" );
+					io.flush();
+					running = 0;
+				}
+				break;
+				default:
+					break;
+			}
+		}
+		break;
+		default:
+			abort();
+			break;
+	}
+
+	return running;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+
+enum ERegister 
+{
+	R_R0 = 0b000, // in/out data
+	R_R1 = 0b001,
+	R_R2 = 0b010,
+	R_R3 = 0b011,
+	R_R4 = 0b100,
+	R_R5 = 0b101,
+	R_R6 = 0b110, // stack pointer
+	R_R7 = 0b111, // store return address 
+	R_PC,         // program counter
+	R_PSR,
+	R_NUM
+};
+
+enum ECondition
+{
+	FL_P = 1 << 0,
+	FL_Z = 1 << 1,
+	FL_N = 1 << 2
+};
+
+enum EOpcodes
+{
+	OP_BR  = 0, /* branch */
+	OP_ADD = 0b0001,    /* add  */
+	OP_LD  = 0b0010,    /* load */
+	OP_ST  = 0b0011,    /* store */
+	OP_JSR = 0b0100,    /* jump register */
+	OP_AND = 0b0101,    /* bitwise and */
+	OP_LDR = 0b0110,    /* load register */
+	OP_STR = 0b0111,    /* store register */
+	OP_RTI = 0b1000,    /* unused */
+	OP_NOT = 0b1001,    /* bitwise not */
+	OP_LDI = 0b1010,    /* load indirect */
+	OP_STI = 0b1011,    /* store indirect */
+	OP_JMP = 0b1100,    /* jump */
+	OP_RES = 0b1101,    /* reserved (unused) */
+	OP_LEA = 0b1110,    /* load effective address */
+	OP_TRAP= 0b1111     /* execute trap */
+};
+
+enum EKeyboard
+{
+	MR_KBSR = 0xFE00, /* keyboard status */
+	MR_KBDR = 0xFE02  /* keyboard data */
+};
+enum ETrap
+{
+	TRAP_GETC = 0x20,  /* get character from keyboard, not echoed onto the terminal */
+	TRAP_OUT = 0x21,   /* output a character */
+	TRAP_PUTS = 0x22,  /* output a word string */
+	TRAP_IN = 0x23,    /* get character from keyboard, echoed onto the terminal */
+	TRAP_PUTSP = 0x24, /* output a byte string */
+	TRAP_HALT = 0x25   /* halt the program */
+};
+
+#define MEMORY_MAX (1 << 16)
+extern uint16_t memory[MEMORY_MAX];  /* 65536 locations */
+extern uint16_t regs[ERegister::R_NUM];
+
+/* host side of the machine, the front end fills these in */
+struct lc3_io
+{
+	uint16_t ( *check_key )();              /* nonzero when a key is waiting */
+	int ( *get_char )();                    /* read one key, waits for it */
+	void ( *put_char )( char c );
+	void ( *flush )();
+	void ( *on_write )( uint16_t address ); /* optional, sees every store */
+};
+
+extern lc3_io io;
+
+uint16_t sign_extend( uint16_t x, int bit_count );
+
+uint16_t swap16( uint16_t x );
+
+void update_flags( uint16_t r );
+
+int read_image( const char *path_to_file );
+
+void mem_write( uint16_t address, uint16_t val );
+
+uint16_t mem_read( uint16_t address );
+
+/* clears memory and registers, sets the Z flag and the PC */
+void reset( uint16_t origin );
+
+/* executes one instruction, returns 0 once the program halted */
+int step();